@@ -0,0 +1,128 @@
+#include "Codecs.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "canvas/OperationLog.h"
+#include "networking/Compression.h"
+#include "utils/settings.h"
+
+using namespace Core::Canvas;
+using namespace Core::Networking;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::size_t POINTS = 60; // Of a stroke drawn in one go
+    constexpr int RUNS = 5; // The best of them counts
+
+    struct Payloads {
+        const char* name;
+        std::vector<std::string> packages;
+    };
+
+    std::vector<Payloads> MakePayloads(std::size_t strokes) {
+        std::mt19937 generator(1499);
+        std::uniform_real_distribution<float> position(0.f, 100000.f), step(-8.f, 8.f);
+
+        OperationLog board;
+        board.SetLocalID(1);
+        Payloads adds{ "Add", {} }, updates{ "Remove/Transform", {} }, batches{ "Relay batch", {} };
+        nlohmann::json frames = nlohmann::json::array();
+        for (std::size_t i = 0; i < strokes; i++) {
+            std::vector<Point> line(POINTS);
+            line[0] = { position(generator), position(generator) };
+            for (std::size_t p = 1; p < POINTS; p++)
+                line[p] = { line[p - 1].x + step(generator), line[p - 1].y + step(generator) };
+
+            const Operation add = board.AddLocal(std::move(line), Color{ 0.f, 1.f, 0.f, 1.f }, 2.f);
+            for (const auto& package : OperationLog::Encode(add)) {
+                adds.packages.push_back(Package::CompressToJSON(package).dump());
+
+                frames.push_back({ 1, Package::CompressToJSON(package) });
+                if (frames.size() == Settings::RELAY_BATCH_MAX) {
+                    nlohmann::json data;
+                    data["frames"] = std::move(frames);
+                    frames = nlohmann::json::array();
+                    batches.packages.push_back(Package::CompressToJSON(Package {
+                        Package::Header{ data.dump().size(), Package::Type::Relay, Settings::SERVER_ID },
+                        Package::Body{ data }
+                    }).dump());
+                }
+            }
+
+            const auto update = i % 2 ? board.TransformLocal(add.stroke, { step(generator), step(generator) }) : board.EraseLocal(add.stroke);
+            for (const auto& package : OperationLog::Encode(*update))
+                updates.packages.push_back(Package::CompressToJSON(package).dump());
+        }
+
+        return { adds, updates, batches };
+    }
+
+    template <typename Step>
+    double Best(Step step) {
+        double best = 0.0;
+        for (int run = 0; run < RUNS; run++) {
+            const auto start = Clock::now();
+            step();
+            const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            best = run == 0 ? ns : std::min(best, ns);
+        }
+        return best;
+    }
+
+    void Measure(const Payloads& payloads, const char* codecName, Codec codec) {
+        Compressor compressor;
+        compressor.Negotiate({ codecName });
+
+        std::size_t raw = 0, bound = 0;
+        for (const auto& package : payloads.packages) {
+            raw += package.size();
+            bound = std::max(bound, Compressor::PackBound(package.size()));
+        }
+
+        std::vector<std::vector<char>> frames(payloads.packages.size(), std::vector<char>(bound));
+        std::size_t stored = 0;
+        const double pack = Best([&] {
+            stored = 0;
+            for (std::size_t i = 0; i < frames.size(); i++)
+                stored += compressor.Pack(payloads.packages[i], frames[i].data(), codec) - FRAME_HEADER_SIZE;
+        });
+
+        bool same = true;
+        std::string package;
+        const double unpack = Best([&] {
+            for (std::size_t i = 0; i < frames.size(); i++) {
+                same &= compressor.Unpack(Compressor::ParseHeader(frames[i].data()), frames[i].data() + FRAME_HEADER_SIZE, package);
+                same &= package == payloads.packages[i];
+            }
+        });
+
+        std::cout << "    " << codecName << ": pack " << pack / static_cast<double>(raw) << " ns/byte, unpack "
+                  << unpack / static_cast<double>(raw) << " ns/byte, " << stored << " bytes, ratio "
+                  << static_cast<double>(raw) / static_cast<double>(stored) << (same ? "" : ", ROUND TRIP FAILED") << std::endl;
+    }
+}
+
+void RunCodecs(std::size_t strokes) {
+    if (Compressor::SupportedCodecs().empty()) {
+        std::cout << "Built without compression" << std::endl;
+        return;
+    }
+
+    std::cout << strokes << " strokes of " << POINTS << " points" << std::endl;
+    for (const auto& payloads : MakePayloads(strokes)) {
+        if (payloads.packages.empty())
+            continue;
+
+        std::size_t raw = 0;
+        for (const auto& package : payloads.packages)
+            raw += package.size();
+        std::cout << "  " << payloads.name << ": " << payloads.packages.size() << " packages, "
+                  << raw / payloads.packages.size() << " bytes each on average" << std::endl;
+
+        Measure(payloads, "lz4", Codec::LZ4);
+        Measure(payloads, "zstd", Codec::Zstd);
+    }
+}
@@ -0,0 +1,211 @@
+#include "Loopback.h"
+
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "networking/LatencyHistogram.h"
+#include "networking/TCPServer.h"
+
+using namespace Core::Networking;
+
+namespace {
+    constexpr std::size_t CLIENTS_PER_ROOM = 16; // Join messages go to the whole room, keeps them few
+    constexpr auto TICK = std::chrono::milliseconds(10);
+    constexpr std::size_t CLIENT_THREADS_MAX = 4;
+
+    // Just enough of a client to ping: uncompressed packages, ';' terminated
+    struct Client {
+        explicit Client(io_context& context) : socket(context) { }
+
+        tcp::socket socket;
+        std::string received;
+        IDType id = -1;
+        bool writing = false;
+    };
+
+    std::string Frame(const Package& package) { return Package::CompressToJSON(package).dump() + ";"; }
+
+    double ThreadSeconds(clockid_t clock) {
+        timespec time{};
+        clock_gettime(clock, &time);
+        return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec) / 1e9;
+    }
+
+    bool Connect(Client& client, int port, std::size_t index) {
+        boost::system::error_code ec;
+        client.socket.connect(tcp::endpoint(ip::address_v4::loopback(), static_cast<unsigned short>(port)), ec);
+        if (ec)
+            return false;
+
+        nlohmann::json data;
+        data["username"] = "loopback";
+        data["room"] = "loopback-" + std::to_string(index / CLIENTS_PER_ROOM);
+        data["compression"] = std::vector<std::string>{};
+        write(client.socket, buffer(Frame(Package { Package::Header{ data.dump().size(), Package::Type::Handshake, -1 }, Package::Body{ data } })), ec);
+        if (ec)
+            return false;
+
+        // Whatever came after the response stays for the first async read
+        const std::size_t size = read_until(client.socket, dynamic_buffer(client.received), ';', ec);
+        if (ec)
+            return false;
+        client.id = Package::Parse(client.received.substr(0, size - 1)).getBody().data.at("id");
+        client.received.erase(0, size);
+        return true;
+    }
+
+    void Read(Client& client, LatencyHistogram& roundTrip) {
+        async_read_until(client.socket, dynamic_buffer(client.received), ';',
+            [&client, &roundTrip](const boost::system::error_code& ec, std::size_t size) {
+                if (ec)
+                    return;
+
+                const Package package = Package::Parse(client.received.substr(0, size - 1));
+                client.received.erase(0, size);
+                // The server pings us too, those go unanswered
+                if (package.getHeader().type == Package::Type::Pong)
+                    roundTrip.Record(MonotonicMicroseconds() - package.getBody().data.at("sent").get<std::uint64_t>());
+
+                Read(client, roundTrip);
+            }
+        );
+    }
+
+    // One ping in flight per client at most, a client still writing skips its turn
+    bool Ping(Client& client) {
+        if (client.writing)
+            return false;
+
+        nlohmann::json data;
+        data["sent"] = MonotonicMicroseconds();
+        auto frame = std::make_shared<std::string>(Frame(Package { Package::Header{ data.dump().size(), Package::Type::Ping, client.id }, Package::Body{ data } }));
+
+        client.writing = true;
+        async_write(client.socket, buffer(*frame), [&client, frame](const boost::system::error_code&, std::size_t) {
+            client.writing = false;
+        });
+        return true;
+    }
+
+    // Clients sharing a thread. Pings are spread evenly over its clients and its ticks.
+    struct Group {
+        Group() : tick(context) { }
+
+        void Tick(double perTick) {
+            tick.expires_at(tick.expiry() + TICK);
+            tick.async_wait([this, perTick](const boost::system::error_code& ec) {
+                if (ec)
+                    return;
+                for (due += perTick; due >= 1.0; due -= 1.0) {
+                    if (Ping(*clients[next]))
+                        sent++;
+                    else
+                        skipped++;
+                    next = (next + 1) % clients.size();
+                }
+                this->Tick(perTick);
+            });
+        }
+
+        io_context context;
+        steady_timer tick;
+        std::vector<std::unique_ptr<Client>> clients;
+        double due = 0.0;
+        std::size_t next = 0, sent = 0, skipped = 0;
+    };
+
+    void Run(std::size_t count, double rate, double seconds, int port) {
+        std::cout << count << " connections" << std::endl;
+
+        // Both ends of every connection are in this process
+        rlimit files{};
+        getrlimit(RLIMIT_NOFILE, &files);
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+        if (files.rlim_cur < 2 * count + 64) {
+            std::cout << "  skipped, only " << files.rlim_cur << " open files allowed" << std::endl;
+            return;
+        }
+
+        // Parsing pongs costs about as much as answering them, so clients get the other cores
+        const std::size_t threads = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 2, CLIENT_THREADS_MAX + 1) - 1;
+        std::vector<std::unique_ptr<Group>> groups;
+        for (std::size_t i = 0; i < std::min(threads, count); i++)
+            groups.push_back(std::make_unique<Group>());
+
+        std::size_t connected = 0;
+        LatencyHistogram roundTrip;
+        double serverSeconds = 0.0;
+        {
+            TCPServer server(port);
+            std::thread serverThread([&server] { server.Run(); });
+            clockid_t serverClock{};
+            pthread_getcpuclockid(serverThread.native_handle(), &serverClock);
+
+            for (std::size_t i = 0; i < count; i++) {
+                auto& group = *groups[i % groups.size()];
+                group.clients.push_back(std::make_unique<Client>(group.context));
+                if (!Connect(*group.clients.back(), port, i))
+                    break;
+                connected++;
+            }
+
+            if (connected == count) {
+                const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::duration<double>(seconds));
+                const double serverStart = ThreadSeconds(serverClock);
+
+                std::vector<std::thread> clientThreads;
+                for (auto& group : groups) {
+                    clientThreads.emplace_back([&group = *group, &roundTrip, rate, duration] {
+                        for (auto& client : group.clients)
+                            Read(*client, roundTrip);
+
+                        group.tick.expires_after(std::chrono::seconds(0));
+                        group.Tick(rate * static_cast<double>(group.clients.size()) * std::chrono::duration<double>(TICK).count());
+                        group.context.run_for(duration);
+                        // Pongs still on their way
+                        group.tick.cancel();
+                        group.context.run_for(std::chrono::milliseconds(200));
+                    });
+                }
+                for (auto& thread : clientThreads)
+                    thread.join();
+                serverSeconds = ThreadSeconds(serverClock) - serverStart;
+            }
+
+            boost::system::error_code ec;
+            for (auto& group : groups) {
+                for (auto& client : group->clients)
+                    client->socket.close(ec);
+            }
+            server.Stop();
+            serverThread.join();
+        }
+
+        if (connected < count) {
+            std::cout << "  only " << connected << " connected" << std::endl;
+            return;
+        }
+
+        std::size_t sent = 0, skipped = 0;
+        for (const auto& group : groups) {
+            sent += group->sent;
+            skipped += group->skipped;
+        }
+        std::cout << "  pongs: " << roundTrip.Count() << " of " << sent << " pings, " << skipped << " skipped" << std::endl;
+        std::cout << "  round trip: " << roundTrip.Summary() << std::endl;
+        std::cout << "  server thread: " << 100.0 * serverSeconds / seconds << "% of a core" << std::endl;
+    }
+}
+
+void RunLoopback(const std::vector<std::size_t>& connections, double rate, double seconds, int port) {
+    std::cout << "Loopback, " << TCPServer::GetBackend() << " backend, " << rate << " pings/s per connection for " << seconds << " s" << std::endl;
+    for (std::size_t count : connections)
+        Run(count, rate, seconds, port);
+}
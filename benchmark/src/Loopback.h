@@ -0,0 +1,13 @@
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#include <cstddef>
+#include <vector>
+
+// Starts the server in this process and, for each count, that many clients over loopback
+// pinging it 'rate' times a second for 'seconds'. Prints the pongs that came back, their
+// round trips and how much of a core the server's thread took. Build once with and once
+// without DRAWING_ROOM_IO_URING to compare the backends.
+void RunLoopback(const std::vector<std::size_t>& connections, double rate, double seconds, int port);
+
+#endif //LOOPBACK_H
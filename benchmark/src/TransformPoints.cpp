@@ -0,0 +1,84 @@
+#include "TransformPoints.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "canvas/Transform.h"
+
+using namespace Core::Rendering;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::size_t POINTS_PER_RUN = 1 << 22; // Of a large board, well beyond the caches
+    constexpr int RUNS = 10; // The best of them counts
+
+    // The loop the client drew with before, one point at a time
+    void TransformLoop(const Point* in, std::size_t count, Point origin, float zoom, Point* out) {
+        for (std::size_t i = 0; i < count; i++)
+            out[i] = { origin.x + in[i].x * zoom, origin.y + in[i].y * zoom };
+    }
+
+    // Random walks like the ones the board benchmark draws
+    std::vector<std::vector<Point>> MakeStrokes(std::size_t points) {
+        std::mt19937 generator(1499);
+        std::uniform_real_distribution<float> position(0.f, 100000.f), step(-8.f, 8.f);
+
+        std::vector<std::vector<Point>> strokes(std::max<std::size_t>(POINTS_PER_RUN / points, 1));
+        for (auto& stroke : strokes) {
+            stroke.resize(points);
+            stroke[0] = { position(generator), position(generator) };
+            for (std::size_t p = 1; p < points; p++)
+                stroke[p] = { stroke[p - 1].x + step(generator), stroke[p - 1].y + step(generator) };
+        }
+        return strokes;
+    }
+
+    template <typename Transform>
+    double NanosecondsPerPoint(const std::vector<std::vector<Point>>& strokes, std::vector<Point>& screen, Transform transform) {
+        const Point origin{ -50000.f, -50000.f };
+        const float zoom = 1.25f;
+
+        double best = 0.0;
+        for (int run = 0; run < RUNS; run++) {
+            const auto start = Clock::now();
+            for (const auto& stroke : strokes) {
+                screen.resize(stroke.size());
+                transform(stroke.data(), stroke.size(), origin, zoom, screen.data());
+            }
+            const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            best = run == 0 ? ns : std::min(best, ns);
+        }
+        return best / static_cast<double>(strokes.size() * strokes.front().size());
+    }
+}
+
+void RunTransform(const std::vector<std::size_t>& sizes) {
+#if (defined(__x86_64__) || defined(_M_X64)) && defined(__GNUC__)
+    std::cout << "TransformPoints, " << (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? "AVX2" : "SSE2") << std::endl;
+#else
+    std::cout << "TransformPoints, plain loop" << std::endl;
+#endif
+
+    for (std::size_t points : sizes) {
+        if (points == 0)
+            continue;
+
+        const auto strokes = MakeStrokes(points);
+        std::vector<Point> screen, expected;
+        const double loop = NanosecondsPerPoint(strokes, expected, TransformLoop);
+        const double kernel = NanosecondsPerPoint(strokes, screen, TransformPoints);
+
+        // The kernels may fuse the multiply and add, so the last bits may differ
+        bool same = true;
+        for (std::size_t p = 0; p < points; p++)
+            same &= std::abs(screen[p].x - expected[p].x) <= 0.01f && std::abs(screen[p].y - expected[p].y) <= 0.01f;
+
+        std::cout << "  " << strokes.size() << " strokes of " << points << " points: loop " << loop << " ns/point, "
+                  << "TransformPoints " << kernel << " ns/point, " << loop / kernel << "x"
+                  << (same ? "" : ", RESULTS DIFFER") << std::endl;
+    }
+}
@@ -0,0 +1,169 @@
+#include "canvas/CanvasFile.h"
+#include "Codecs.h"
+#include "Loopback.h"
+#include "TransformPoints.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// Compares canvas files with the JSON packages a board is sent as:
+// saving, opening, reading one screen of a large board and loading all of it.
+//   DrawingRoomBenchmark [--strokes <count>] [--points <per stroke>] [--dir <directory>]
+// Or measures the server's transport with many clients over loopback, see Loopback.h:
+//   DrawingRoomBenchmark --connections <count,...> [--rate <pings/s>] [--seconds <seconds>] [--port <port>]
+// Or the board to screen transform of strokes with each count of points, see TransformPoints.h:
+//   DrawingRoomBenchmark --transform <points,...>
+// Or LZ4 and zstd on board packages, see Codecs.h:
+//   DrawingRoomBenchmark --codecs <strokes>
+
+using namespace Core::Canvas;
+using Clock = std::chrono::steady_clock;
+
+static double MillisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void Report(const char* what, double ms) {
+    std::cout << "  " << what << ": " << ms << " ms" << std::endl;
+}
+
+// Random walks spread over a board much larger than a screen
+static OperationLog MakeBoard(std::size_t strokes, std::size_t points) {
+    std::mt19937 generator(1499);
+    std::uniform_real_distribution<float> position(0.f, 100000.f), step(-8.f, 8.f);
+
+    OperationLog board;
+    board.SetLocalID(1);
+    for (std::size_t i = 0; i < strokes; i++) {
+        std::vector<Point> line(points);
+        line[0] = { position(generator), position(generator) };
+        for (std::size_t p = 1; p < points; p++)
+            line[p] = { line[p - 1].x + step(generator), line[p - 1].y + step(generator) };
+
+        board.AddLocal(std::move(line), Color{ 0.f, 1.f, 0.f, 1.f }, 2.f);
+    }
+
+    return board;
+}
+
+int main(int argc, char** argv) {
+    std::size_t strokes = 100000, points = 64;
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::vector<std::size_t> connections, transform;
+    double rate = 10.0, seconds = 5.0;
+    std::size_t codecs = 0;
+    int port = 1599;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::strcmp(argv[i], "--strokes") == 0)
+            strokes = std::stoul(argv[i + 1]);
+        if (std::strcmp(argv[i], "--points") == 0)
+            points = std::stoul(argv[i + 1]);
+        if (std::strcmp(argv[i], "--dir") == 0)
+            directory = argv[i + 1];
+        if (std::strcmp(argv[i], "--connections") == 0) {
+            std::stringstream counts(argv[i + 1]);
+            for (std::string count; std::getline(counts, count, ',');)
+                connections.push_back(std::stoul(count));
+        }
+        if (std::strcmp(argv[i], "--transform") == 0) {
+            std::stringstream counts(argv[i + 1]);
+            for (std::string count; std::getline(counts, count, ',');)
+                transform.push_back(std::stoul(count));
+        }
+        if (std::strcmp(argv[i], "--codecs") == 0)
+            codecs = std::stoul(argv[i + 1]);
+        if (std::strcmp(argv[i], "--rate") == 0)
+            rate = std::stod(argv[i + 1]);
+        if (std::strcmp(argv[i], "--seconds") == 0)
+            seconds = std::stod(argv[i + 1]);
+        if (std::strcmp(argv[i], "--port") == 0)
+            port = std::stoi(argv[i + 1]);
+    }
+
+    if (!connections.empty()) {
+        RunLoopback(connections, rate, seconds, port);
+        return 0;
+    }
+    if (!transform.empty()) {
+        RunTransform(transform);
+        return 0;
+    }
+    if (codecs > 0) {
+        RunCodecs(codecs);
+        return 0;
+    }
+
+    std::cout << strokes << " strokes of " << points << " points" << std::endl;
+    const OperationLog board = MakeBoard(strokes, points);
+    const Point screenMin{ 50000.f, 50000.f }, screenMax{ 51920.f, 51080.f };
+
+    // Canvas file
+    const std::string canvasPath = (directory / "benchmark.canvas").string();
+    std::cout << "Canvas file" << std::endl;
+
+    auto start = Clock::now();
+    if (!SaveCanvas(canvasPath, board))
+        return 1;
+    Report("save", MillisecondsSince(start));
+
+    start = Clock::now();
+    MappedCanvas canvas;
+    if (!canvas.Open(canvasPath))
+        return 1;
+    Report("open", MillisecondsSince(start));
+
+    start = Clock::now();
+    std::size_t visiblePoints = 0;
+    const auto visible = canvas.Query(screenMin, screenMax);
+    for (auto i : visible)
+        visiblePoints += canvas.GetPoints(canvas.GetStrokes()[i]).size();
+    Report("one screen", MillisecondsSince(start));
+    std::cout << "  " << visible.size() << " strokes, " << visiblePoints << " points on screen" << std::endl;
+
+    start = Clock::now();
+    OperationLog loaded;
+    loaded.ApplyBatch(canvas.ToOperations());
+    Report("load everything", MillisecondsSince(start));
+    std::cout << "  " << std::filesystem::file_size(canvasPath) << " bytes" << std::endl;
+
+    // JSON, the way the server sends a board to a newcomer
+    const std::string jsonPath = (directory / "benchmark.json").string();
+    std::cout << "JSON" << std::endl;
+
+    start = Clock::now();
+    {
+        std::ofstream file(jsonPath, std::ios::trunc);
+        for (const auto& op : board.Snapshot()) {
+            for (const auto& package : OperationLog::Encode(op))
+                file << Core::Networking::Package::CompressToJSON(package).dump() << ';';
+        }
+    }
+    Report("save", MillisecondsSince(start));
+
+    // Nothing is known about the board before all of it is parsed,
+    // so opening it and showing one screen cost as much as loading everything
+    start = Clock::now();
+    {
+        std::ifstream file(jsonPath);
+        std::stringstream contents;
+        contents << file.rdbuf();
+
+        std::vector<Operation> ops;
+        std::string package;
+        while (std::getline(contents, package, ';'))
+            ops.push_back(OperationLog::Decode(Core::Networking::Package::Parse(package)));
+
+        OperationLog parsed;
+        parsed.ApplyBatch(std::move(ops));
+    }
+    Report("load everything", MillisecondsSince(start));
+    std::cout << "  " << std::filesystem::file_size(jsonPath) << " bytes" << std::endl;
+
+    std::filesystem::remove(canvasPath);
+    std::filesystem::remove(jsonPath);
+}
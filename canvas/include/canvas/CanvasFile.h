@@ -0,0 +1,104 @@
+#ifndef CANVASFILE_H
+#define CANVASFILE_H
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "OperationLog.h"
+
+namespace Core::Canvas {
+    // Saved board, laid out so that a mapped file is used in place without parsing:
+    //   CanvasHeader
+    //   StrokeRecord[strokeCount]   in drawing order
+    //   Point[pointCount]           points of all strokes back to back
+    //   u32[cellCount + 1]          spatial index: a uniform grid over the bounds of the board,
+    //   u32[cellStrokeCount]        first array says where each cell's list of strokes starts in the second
+    // Everything is little endian, sections start 8 byte aligned.
+    // Opening a file touches only the header, pages of strokes nobody looks at are never read.
+    // Version 2 added StrokeRecord::flags, version 1 files read the same with no flags set.
+    constexpr std::uint32_t CANVAS_VERSION = 2;
+    constexpr std::uint16_t STROKE_SMOOTH = 1; // Points are control points of a curve
+
+    struct CanvasHeader {
+        char magic[4]; // "DRCV"
+        std::uint32_t version;
+        std::uint64_t clock; // Lamport clock of the board when it was saved
+
+        std::uint64_t strokeCount;
+        std::uint64_t pointCount;
+        std::uint64_t cellStrokeCount;
+
+        std::uint64_t strokesOffset;
+        std::uint64_t pointsOffset;
+        std::uint64_t cellsOffset;
+        std::uint64_t cellStrokesOffset;
+
+        Rendering::Point min, max; // Bounds of the visible strokes
+        float cellSize;
+        std::uint32_t columns, rows;
+        std::uint32_t reserved;
+    };
+
+    struct StrokeRecord {
+        StrokeID id;
+        std::uint32_t pointCount;
+        std::uint16_t visible; // 32 bits in version 1, flags were its upper half and always 0
+        std::uint16_t flags;
+        std::uint64_t firstPoint; // Index into the point block
+
+        Color color;
+        float thickness;
+        Point translation;
+        Point min, max; // Bounds on the board, translation and thickness included
+
+        // OperationLog::Stamps, ordered to leave no padding
+        Networking::IDType addedAuthor;
+        std::uint64_t addedClock;
+        std::uint64_t visibilityClock;
+        std::uint64_t transformClock;
+        Networking::IDType visibilityAuthor;
+        Networking::IDType transformAuthor;
+    };
+
+    static_assert(sizeof(CanvasHeader) == 104 && sizeof(StrokeRecord) == 104, "Canvas file layout changed, bump CANVAS_VERSION");
+
+    // Writes the board to a file. Goes through a temporary file,
+    // so a crash halfway leaves the previous save intact.
+    bool SaveCanvas(const std::string& path, const OperationLog& board);
+
+    // Read only view of a canvas file mapped into memory
+    class MappedCanvas {
+    public:
+        MappedCanvas() = default;
+        ~MappedCanvas();
+
+        MappedCanvas(const MappedCanvas&) = delete;
+        MappedCanvas& operator=(const MappedCanvas&) = delete;
+
+        // Checks the header and section bounds only, records are validated when accessed
+        bool Open(const std::string& path);
+        void Close();
+        bool IsOpen() const;
+
+        const CanvasHeader& GetHeader() const;
+        std::span<const StrokeRecord> GetStrokes() const;
+        std::span<const Point> GetPoints(const StrokeRecord& stroke) const;
+
+        // Visible strokes whose bounds touch the rectangle, as indices into GetStrokes() in drawing order.
+        // Reads only the grid cells the rectangle covers.
+        std::vector<std::uint32_t> Query(Point min, Point max) const;
+
+        // Operations that rebuild the saved board, see OperationLog::Snapshot
+        std::vector<Operation> ToOperations() const;
+
+    private:
+        const char* data = nullptr;
+        std::size_t size = 0;
+        std::unique_ptr<char[]> copy; // Platforms without mmap read the whole file instead
+    };
+}
+
+#endif //CANVASFILE_H
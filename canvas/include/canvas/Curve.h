@@ -0,0 +1,39 @@
+#ifndef CURVE_H
+#define CURVE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Line.h"
+
+namespace Core::Rendering {
+    // Smooth strokes keep only control points of a Catmull-Rom spline running through them.
+    // Each span between two control points is the cubic Bézier
+    //   p1, p1 + (p2 - p0) / 6, p2 - (p3 - p1) / 6, p2
+    // with the end points doubled at both ends of the stroke.
+
+    // Picks control points out of the raw cursor path while a stroke is drawn. A point is kept
+    // only once the path strays from the straight chord since the last one by more than the
+    // tolerance, so straight runs cost two points and tight curves get as many as they need.
+    class StrokeSampler {
+    public:
+        // Starts a stroke: points becomes the first control point and the live end of the stroke
+        void Begin(Point position, std::vector<Point>& points);
+        // Moves the live end, the last point of points. Returns true if a control point was added.
+        bool Add(Point position, float tolerance, std::vector<Point>& points);
+
+    private:
+        std::vector<Point> path; // Raw positions since the last control point
+    };
+
+    // Flattens the spline into a polyline no further than tolerance from the curve.
+    // Replaces what was in out.
+    void ExpandCurve(const Point* points, std::size_t count, float tolerance, std::vector<Point>& out);
+
+    // Bounds of the spline: the curve never leaves the hull of its Bézier control points
+    void CurveBounds(const Point* points, std::size_t count, Point& min, Point& max);
+    // Grows min and max by the spans from 'first' on, for bounds known up to there
+    void ExtendCurveBounds(const Point* points, std::size_t count, std::size_t first, Point& min, Point& max);
+}
+
+#endif //CURVE_H
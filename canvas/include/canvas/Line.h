@@ -0,0 +1,60 @@
+#ifndef LINE_H
+#define LINE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "networking/TCPPackage.h"
+
+namespace Core::Rendering {
+    struct Color {
+        float r, g ,b, a;
+
+        void LoadFromArray(const float color[4]) {
+            r = color[0];
+            g = color[1];
+            b = color[2];
+            a = color[3];
+        }
+    };
+
+    // Board space point. Kept layout compatible with ImVec2 so the client
+    // can hand point arrays to ImGui without conversion.
+    struct Point {
+        float x, y;
+    };
+
+    // Globally unique stroke identifier: author's connection ID plus
+    // the author's local stroke counter.
+    struct StrokeID {
+        Networking::IDType client;
+        std::uint32_t sequence;
+
+        bool operator==(const StrokeID&) const = default;
+        auto operator<=>(const StrokeID&) const = default;
+    };
+
+    struct Line {
+        std::vector<Point> points{};
+        Color color;
+        float thickness;
+
+        StrokeID id{};
+        Point translation{}; // Applied on top of the points, set by Transform operations
+        bool visible = true; // False for erased (tombstoned) strokes
+        bool smooth = false; // Points are control points of a curve, see Curve.h
+        Point min{}, max{}; // Bounds of the stroke without translation, kept up to date by OperationLog
+    };
+}
+
+template<>
+struct std::hash<Core::Rendering::StrokeID> {
+    std::size_t operator()(const Core::Rendering::StrokeID& id) const noexcept {
+        return std::hash<std::uint64_t>{}(
+            (static_cast<std::uint64_t>(static_cast<std::uint32_t>(id.client)) << 32) | id.sequence
+        );
+    }
+};
+
+#endif //LINE_H
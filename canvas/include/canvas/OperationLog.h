@@ -0,0 +1,178 @@
+#ifndef OPERATIONLOG_H
+#define OPERATIONLOG_H
+
+#include <deque>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "Line.h"
+#include "networking/TCPPackage.h"
+#include "utils/settings.h"
+
+namespace Core::Canvas {
+    using Rendering::Color;
+    using Rendering::Line;
+    using Rendering::Point;
+    using Rendering::StrokeID;
+
+    struct Operation {
+        enum class Type {
+            Add = 0,
+            Remove,
+            Restore,
+            Transform
+        };
+
+        Type type;
+        StrokeID stroke;
+        std::uint64_t clock; // Lamport timestamp
+        Networking::IDType author;
+
+        // Add only. Large strokes arrive as several Add operations with the same ID,
+        // every one of them appends its points to the stroke.
+        std::vector<Point> points{};
+        std::size_t firstPoint = 0; // Where in the stroke these points go, a chunk that arrives again adds nothing
+        Color color{};
+        float thickness = 0.f;
+        bool smooth = false;
+        std::size_t totalPoints = 0; // Size of the whole stroke, known from its first chunk
+
+        // Transform only
+        Point translation{};
+    };
+
+    // Replicated board state. Every peer applies the same set of operations
+    // and ends up with the same board regardless of the order they arrived in:
+    // visibility and translation of a stroke are last-writer-wins registers
+    // ordered by (clock, author), strokes are drawn in order of their Add stamp.
+    class OperationLog {
+    public:
+        struct Stamp {
+            std::uint64_t clock;
+            Networking::IDType author;
+
+            auto operator<=>(const Stamp&) const = default;
+        };
+
+        // Last writes of a stroke's registers. Saved with the board
+        // so that a loaded board still merges with live operations.
+        struct Stamps {
+            Stamp added;
+            Stamp visibility;
+            Stamp transform;
+        };
+
+        OperationLog() = default;
+
+        // Sequence numbers below firstSequence are taken by strokes of an earlier session with the same ID
+        void SetLocalID(Networking::IDType id, std::uint32_t firstSequence = 0);
+
+        // Local edits. Each one stamps a new operation, applies it
+        // and returns it so the caller can broadcast it.
+        Operation AddLocal(std::vector<Point>&& points, Color color, float thickness, bool smooth = false);
+        std::optional<Operation> EraseLocal(StrokeID id);
+        std::optional<Operation> TransformLocal(StrokeID id, Point translation);
+
+        // Undo and redo only flip the visibility of a stroke,
+        // so they are a single small operation on the wire.
+        std::optional<Operation> Undo();
+        std::optional<Operation> Redo();
+
+        // Applies an operation coming from any peer. Returns true if the board changed.
+        bool Apply(const Operation& op);
+        bool Apply(Operation&& op);
+
+        // Applies many operations at once, e.g. when loading a board.
+        // Storage is reserved up front, points are moved in without copies,
+        // and restoring the drawing order is done once at the end of the batch.
+        void ApplyBatch(std::vector<Operation>&& ops);
+
+        // Frees erased strokes once their removal is old enough, and registers of strokes that never arrived.
+        // Cheap to call after every operation, a pass runs only once enough tombstones piled up or aged since the last one.
+        void CompactTombstones();
+
+        // Forgets strokes 'keep' says no to, as if they never arrived: their next Add brings them back.
+        // For a client that holds only part of the board, see TilePager. Strokes in the undo history stay.
+        // Returns how many went.
+        std::size_t Evict(const std::function<bool(const Line&)>& keep);
+
+        std::optional<StrokeID> HitTest(Point point, float radius) const;
+
+        const std::vector<Line>& GetLines() const;
+        const Line* Find(StrokeID id) const;
+        // Erased and compacted, and not forgotten yet
+        bool IsCompacted(StrokeID id) const;
+        std::size_t GetTombstoneCount() const;
+        std::size_t GetCompactedCount() const;
+        std::size_t GetPendingCount() const;
+        Stamps GetStamps(StrokeID id) const;
+        std::uint64_t GetClock() const;
+
+        // Operations that rebuild the board as it is now, e.g. for a newcomer:
+        // an Add per stroke, followed by the Remove and Transform it ended up with.
+        std::vector<Operation> Snapshot() const;
+        // Appends the operations that recreate one stroke
+        static void RebuildStroke(Line&& line, const Stamps& stamps, std::vector<Operation>& ops);
+
+        static std::vector<Networking::Package> Encode(const Operation& op);
+        static Operation Decode(const Networking::Package& package);
+
+    private:
+        struct Entry {
+            std::size_t index; // Position in lines
+            Stamp added;
+            Stamp visibility;
+            Stamp transform;
+        };
+
+        // Registers written before the stroke itself arrived
+        struct PendingEntry {
+            Stamp visibility{};
+            bool visible = true;
+            Stamp transform{};
+            Point translation{};
+        };
+
+        struct HistoryEntry {
+            StrokeID stroke;
+            bool erased; // The step erased the stroke rather than drew it
+        };
+
+        Operation Stamped(Operation::Type type, StrokeID stroke);
+        void PushHistory(HistoryEntry entry);
+        bool IsInHistory(StrokeID id) const;
+        void InsertLine(Line&& line, Stamp added);
+        void RestoreOrder();
+        void SetVisible(Entry& entry, bool visible, Stamp stamp);
+        PendingEntry& Pending(StrokeID id);
+
+        std::vector<Line> lines;
+        std::unordered_map<StrokeID, Entry> entries;
+        std::unordered_map<StrokeID, PendingEntry> pending;
+        // Order pending strokes were first written in, with the clock at the time. A stroke that doesn't
+        // arrive within the horizon never will, its registers are dropped like compacted strokes are.
+        std::deque<std::pair<std::uint64_t, StrokeID>> pendingOrder;
+        // Compacted strokes, late operations on them are ignored. Each is kept as long as a tombstone was,
+        // in the order they were compacted with the clock at the time.
+        std::unordered_set<StrokeID> compacted;
+        std::deque<std::pair<std::uint64_t, StrokeID>> compactedOrder;
+        std::size_t nextCompaction = Networking::Settings::TOMBSTONE_COMPACT_THRESHOLD; // Tombstones that start a pass
+        std::uint64_t lastCompaction = 0; // Clock of the last pass
+
+        std::deque<HistoryEntry> undoHistory;
+        std::vector<HistoryEntry> redoHistory;
+
+        std::uint64_t clock = 0;
+        std::uint32_t nextSequence = 0;
+        Networking::IDType localID{};
+        std::size_t tombstones = 0;
+
+        bool batching = false;
+        bool outOfOrder = false; // Lines were appended unsorted during a batch
+    };
+}
+
+#endif //OPERATIONLOG_H
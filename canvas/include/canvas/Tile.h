@@ -0,0 +1,79 @@
+#ifndef TILE_H
+#define TILE_H
+
+#include <cstdint>
+#include <functional>
+
+#include "Line.h"
+#include "nlohmann/json.hpp"
+
+namespace Core::Canvas {
+    using Rendering::Line;
+    using Rendering::Point;
+
+    // The board has no edges, it's split into square world tiles of TILE_SIZE board units.
+    // Tile (0, 0) spans [0, TILE_SIZE) on both axes. Clients hold only the tiles around
+    // their view and page the rest in from the server when they get there, see TilePager.
+    struct Tile {
+        std::int32_t x, y;
+
+        bool operator==(const Tile&) const = default;
+    };
+
+    // Tiles a rectangle of the board touches, both corners included
+    struct TileRange {
+        Tile min, max;
+
+        bool Contains(Tile tile) const;
+        bool Intersects(const TileRange& other) const;
+        std::size_t Count() const;
+
+        bool operator==(const TileRange&) const = default;
+    };
+
+    Tile TileOf(Point point);
+    TileRange TilesOf(Point min, Point max);
+    // Tiles a stroke touches where it is now: its bounds, moved by its translation and grown by its thickness
+    TileRange TilesOf(const Line& line);
+    // Tiles a client holds for a view of the board: those on screen and TILE_MARGIN around them
+    TileRange ViewTiles(Point min, Point max);
+
+    // [x, y] on the wire. Throws nlohmann::json exceptions on anything else.
+    nlohmann::json ToJSON(Tile tile);
+    Tile TileFromJSON(const nlohmann::json& json);
+
+    // True if the range has any of 'tiles', walks whichever of the two is smaller
+    template<typename Set>
+    bool Touches(const TileRange& range, const Set& tiles) {
+        if (range.Count() <= tiles.size()) {
+            for (std::int32_t y = range.min.y; y <= range.max.y; y++) {
+                for (std::int32_t x = range.min.x; x <= range.max.x; x++) {
+                    if (tiles.contains(Tile{ x, y }))
+                        return true;
+                }
+            }
+            return false;
+        }
+
+        for (const auto& entry : tiles) {
+            if constexpr (requires { entry.first; }) {
+                if (range.Contains(entry.first))
+                    return true;
+            }
+            else if (range.Contains(entry))
+                return true;
+        }
+        return false;
+    }
+}
+
+template<>
+struct std::hash<Core::Canvas::Tile> {
+    std::size_t operator()(const Core::Canvas::Tile& tile) const noexcept {
+        return std::hash<std::uint64_t>{}(
+            (static_cast<std::uint64_t>(static_cast<std::uint32_t>(tile.x)) << 32) | static_cast<std::uint32_t>(tile.y)
+        );
+    }
+};
+
+#endif //TILE_H
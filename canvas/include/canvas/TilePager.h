@@ -0,0 +1,78 @@
+#ifndef TILEPAGER_H
+#define TILEPAGER_H
+
+#include <array>
+#include <chrono>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "OperationLog.h"
+#include "Tile.h"
+#include "utils/settings.h"
+
+namespace Core::Canvas {
+    // Client side of a board too big to hold: only the world tiles around the view are resident.
+    // Missing ones are asked from the server, one TileRequest at a time, and the least recently
+    // seen ones are dropped once there are more than the limit. The board holds the strokes that
+    // touch a resident tile and no others, so a request lists the resident tiles and the server
+    // leaves out every stroke we have already.
+    // Render thread only.
+    class TilePager {
+    public:
+        // Board package as it came in, in order
+        struct Received {
+            std::optional<Operation> op;
+            bool paged = false; // Sent because we asked for its tile, not a live change
+            std::vector<Tile> loaded; // No operation: everything of these tiles came before it
+            std::vector<Tile> dirty; // No operation: these tiles changed where we didn't look
+        };
+
+        explicit TilePager(std::size_t maxResident = Networking::Settings::RESIDENT_TILES_MAX);
+
+        // Board, TileLoaded and TileDirty packages. Throws nlohmann::json exceptions on malformed ones.
+        static Received Receive(const Networking::Package& package);
+
+        // Board rectangle on screen this frame. Returns the body of a TileRequest
+        // if tiles around it are missing and the last request was answered.
+        std::optional<nlohmann::json> View(Point min, Point max);
+        // Body of a Viewport package for the server once the view moved over other tiles,
+        // at most every VIEWPORT_INTERVAL_MS. Live changes elsewhere reach us as TileDirty.
+        std::optional<nlohmann::json> Report(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+        // Operations of 'received' for the board to apply, in order. Live changes to tiles we don't hold
+        // are left out, as are paged strokes we have already.
+        std::vector<Operation> Filter(std::vector<Received>&& received, const OperationLog& board);
+
+        // Drops tiles over the limit, least recently seen first, and the strokes left without a resident tile
+        void Evict(OperationLog& board);
+
+        // Nothing is resident anymore, e.g. the board was cleared for a new session
+        void Reset();
+        // The server may not know what we hold or where we look, e.g. after another process of it
+        // took over our session. The next Report and View tell it again, even if nothing is missing.
+        void Resync();
+
+        std::size_t GetResidentCount() const;
+
+    private:
+        void Touch(Tile tile);
+        void Loaded(const std::vector<Tile>& tiles);
+        // Resident tiles in the range are missing something, they are asked for again
+        void MarkDirty(const TileRange& range);
+
+        std::size_t maxResident;
+        std::list<Tile> order; // Most recently seen first
+        std::unordered_map<Tile, std::list<Tile>::iterator> resident;
+        TileRange view{};
+        std::array<float, 4> viewRect{}; // Board rectangle of the last View
+        std::optional<TileRange> reported; // View the server knows of
+        std::chrono::steady_clock::time_point lastReport{};
+        bool pending = false; // A request is on its way, the next one waits for its TileLoaded
+        bool resync = false;
+        std::unordered_set<Rendering::StrokeID> duplicates; // Paged strokes we had already, until the TileLoaded
+    };
+}
+
+#endif //TILEPAGER_H
@@ -0,0 +1,16 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <cstddef>
+
+#include "Line.h"
+
+namespace Core::Rendering {
+    // Board to screen transform of a whole point array in one pass:
+    // out[i] = origin + in[i] * zoom.
+    // Uses AVX2 when the CPU has it, SSE2 on other x86-64 machines and plain loop elsewhere.
+    // in and out may be the same array.
+    void TransformPoints(const Point* in, std::size_t count, Point origin, float zoom, Point* out);
+}
+
+#endif //TRANSFORM_H
@@ -0,0 +1,349 @@
+#include "canvas/CanvasFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/log.h"
+#include "utils/settings.h"
+
+namespace Core::Canvas {
+    static constexpr char CANVAS_MAGIC[4] = { 'D', 'R', 'C', 'V' };
+
+    // Files are written and mapped in the host layout, which is the file layout only on little endian machines
+    static constexpr bool NATIVE_LAYOUT = std::endian::native == std::endian::little;
+
+    static std::uint64_t AlignUp(std::uint64_t offset) { return (offset + 7) & ~std::uint64_t{ 7 }; }
+
+    // Section of 'count' elements at 'offset' lies within the file
+    static bool Fits(std::uint64_t offset, std::uint64_t count, std::size_t element, std::size_t size) {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / element;
+    }
+
+    // Cell a coordinate falls into along one axis, clamped to the grid
+    static std::uint32_t Cell(float v, float origin, float cellSize, std::uint32_t cells) {
+        const float cell = (v - origin) / cellSize;
+        return cell > 0.f ? static_cast<std::uint32_t>(std::min(cell, cells - 1.f)) : 0;
+    }
+
+    // Cells needed to cover an extent, also sane for infinite or NaN extents
+    static std::uint32_t CellsAlong(float extent, float cellSize) {
+        const float cells = std::ceil(extent / cellSize);
+        return cells >= 1.f ? static_cast<std::uint32_t>(std::min<float>(cells, Networking::Settings::CANVAS_MAX_CELLS)) : 1;
+    }
+
+    static bool Intersects(Point aMin, Point aMax, Point bMin, Point bMax) {
+        return aMin.x <= bMax.x && bMin.x <= aMax.x && aMin.y <= bMax.y && bMin.y <= aMax.y;
+    }
+
+    static StrokeRecord MakeRecord(const Line& line, const OperationLog::Stamps& stamps, std::uint64_t firstPoint) {
+        StrokeRecord record{};
+        record.id = line.id;
+        record.pointCount = static_cast<std::uint32_t>(line.points.size());
+        record.visible = line.visible;
+        record.flags = line.smooth ? STROKE_SMOOTH : 0;
+        record.firstPoint = firstPoint;
+        record.color = line.color;
+        record.thickness = line.thickness;
+        record.translation = line.translation;
+
+        // Bounds the board keeps for the stroke, curves included
+        const float margin = line.thickness * 0.5f;
+        const Point min = line.points.empty() ? Point{} : line.min, max = line.points.empty() ? Point{} : line.max;
+        record.min = { min.x + line.translation.x - margin, min.y + line.translation.y - margin };
+        record.max = { max.x + line.translation.x + margin, max.y + line.translation.y + margin };
+
+        record.addedAuthor = stamps.added.author;
+        record.addedClock = stamps.added.clock;
+        record.visibilityClock = stamps.visibility.clock;
+        record.transformClock = stamps.transform.clock;
+        record.visibilityAuthor = stamps.visibility.author;
+        record.transformAuthor = stamps.transform.author;
+
+        return record;
+    }
+
+    bool SaveCanvas(const std::string &path, const OperationLog &board) {
+        if constexpr (!NATIVE_LAYOUT) {
+            LOG_LINE("Canvas files are supported on little endian machines only");
+            return false;
+        }
+
+        const auto& lines = board.GetLines();
+
+        CanvasHeader header{};
+        std::memcpy(header.magic, CANVAS_MAGIC, sizeof(CANVAS_MAGIC));
+        header.version = CANVAS_VERSION;
+        header.clock = board.GetClock();
+        header.strokeCount = lines.size();
+
+        std::vector<StrokeRecord> strokes;
+        strokes.reserve(lines.size());
+        std::size_t visibleStrokes = 0;
+        header.min = { INFINITY, INFINITY };
+        header.max = { -INFINITY, -INFINITY };
+
+        for (const auto& line : lines) {
+            strokes.push_back(MakeRecord(line, board.GetStamps(line.id), header.pointCount));
+            header.pointCount += line.points.size();
+
+            if (line.visible) {
+                const auto& s = strokes.back();
+                header.min = { std::min(header.min.x, s.min.x), std::min(header.min.y, s.min.y) };
+                header.max = { std::max(header.max.x, s.max.x), std::max(header.max.y, s.max.y) };
+                visibleStrokes++;
+            }
+        }
+        if (visibleStrokes == 0)
+            header.min = header.max = Point{};
+
+        // Grid with about a cell per visible stroke, so a cell lists a handful of them
+        const float width = header.max.x - header.min.x, height = header.max.y - header.min.y;
+        const float cells = std::clamp<float>(visibleStrokes, 1.f, Networking::Settings::CANVAS_MAX_CELLS);
+        header.cellSize = std::max(std::sqrt(width * height / cells), Networking::Settings::CANVAS_MIN_CELL_SIZE);
+        while (static_cast<std::uint64_t>(CellsAlong(width, header.cellSize)) * CellsAlong(height, header.cellSize) > Networking::Settings::CANVAS_MAX_CELLS)
+            header.cellSize *= 2.f;
+        header.columns = CellsAlong(width, header.cellSize);
+        header.rows = CellsAlong(height, header.cellSize);
+
+        auto cellRange = [&header](const StrokeRecord& s, std::uint32_t& c0, std::uint32_t& c1, std::uint32_t& r0, std::uint32_t& r1) {
+            c0 = Cell(s.min.x, header.min.x, header.cellSize, header.columns);
+            c1 = Cell(s.max.x, header.min.x, header.cellSize, header.columns);
+            r0 = Cell(s.min.y, header.min.y, header.cellSize, header.rows);
+            r1 = Cell(s.max.y, header.min.y, header.cellSize, header.rows);
+        };
+
+        // Counting sort of strokes into cells: count, turn counts into starts, fill.
+        // Strokes are visited in drawing order, so every cell lists them in that order as well.
+        const std::size_t cellCount = static_cast<std::size_t>(header.columns) * header.rows;
+        std::vector<std::uint32_t> cellStart(cellCount + 1, 0);
+        for (const auto& s : strokes) {
+            if (!s.visible) continue;
+            std::uint32_t c0, c1, r0, r1;
+            cellRange(s, c0, c1, r0, r1);
+            for (std::uint32_t r = r0; r <= r1; r++)
+                for (std::uint32_t c = c0; c <= c1; c++)
+                    cellStart[r * header.columns + c + 1]++;
+        }
+
+        std::uint64_t total = 0;
+        for (auto& start : cellStart) {
+            total += start;
+            if (total > UINT32_MAX) {
+                LOG_LINE("Board is too large to be saved");
+                return false;
+            }
+            start = static_cast<std::uint32_t>(total);
+        }
+
+        std::vector<std::uint32_t> cellStrokes(total);
+        std::vector<std::uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+        for (std::uint32_t i = 0; i < strokes.size(); i++) {
+            if (!strokes[i].visible) continue;
+            std::uint32_t c0, c1, r0, r1;
+            cellRange(strokes[i], c0, c1, r0, r1);
+            for (std::uint32_t r = r0; r <= r1; r++)
+                for (std::uint32_t c = c0; c <= c1; c++)
+                    cellStrokes[next[r * header.columns + c]++] = i;
+        }
+
+        header.cellStrokeCount = cellStrokes.size();
+        header.strokesOffset = AlignUp(sizeof(CanvasHeader));
+        header.pointsOffset = AlignUp(header.strokesOffset + strokes.size() * sizeof(StrokeRecord));
+        header.cellsOffset = AlignUp(header.pointsOffset + header.pointCount * sizeof(Point));
+        header.cellStrokesOffset = AlignUp(header.cellsOffset + cellStart.size() * sizeof(std::uint32_t));
+
+        const std::string temporary = path + ".tmp";
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            LOG_LINE("Can't open canvas file " << temporary);
+            return false;
+        }
+
+        auto writeAt = [&file](std::uint64_t offset, const void* data, std::size_t size) {
+            static constexpr char padding[8]{};
+            file.write(padding, static_cast<std::streamsize>(offset - static_cast<std::uint64_t>(file.tellp())));
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        };
+
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.strokesOffset, strokes.data(), strokes.size() * sizeof(StrokeRecord));
+        writeAt(header.pointsOffset, nullptr, 0);
+        for (const auto& line : lines)
+            file.write(reinterpret_cast<const char*>(line.points.data()), static_cast<std::streamsize>(line.points.size() * sizeof(Point)));
+        writeAt(header.cellsOffset, cellStart.data(), cellStart.size() * sizeof(std::uint32_t));
+        writeAt(header.cellStrokesOffset, cellStrokes.data(), cellStrokes.size() * sizeof(std::uint32_t));
+        file.close();
+
+        std::error_code ec;
+        if (!file || (std::filesystem::rename(temporary, path, ec), ec)) {
+            LOG_LINE("Writing canvas file " << path << " failed");
+            std::filesystem::remove(temporary, ec);
+            return false;
+        }
+        return true;
+    }
+
+    MappedCanvas::~MappedCanvas() { this->Close(); }
+
+    bool MappedCanvas::Open(const std::string &path) {
+        this->Close();
+
+        if constexpr (!NATIVE_LAYOUT)
+            return false;
+
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return false;
+
+        size = static_cast<std::size_t>(file.tellg());
+        copy = std::make_unique<char[]>(size);
+        file.seekg(0);
+        if (!file.read(copy.get(), static_cast<std::streamsize>(size))) {
+            this->Close();
+            return false;
+        }
+        data = copy.get();
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info{};
+        if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(CanvasHeader))) {
+            ::close(fd);
+            return false;
+        }
+
+        void* mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // Mapping stays valid without the descriptor
+        if (mapping == MAP_FAILED)
+            return false;
+
+        data = static_cast<const char*>(mapping);
+        size = info.st_size;
+#endif
+
+        const CanvasHeader& header = this->GetHeader();
+        const std::uint64_t cellCount = static_cast<std::uint64_t>(header.columns) * header.rows;
+        const bool valid =
+            size >= sizeof(CanvasHeader) &&
+            std::memcmp(header.magic, CANVAS_MAGIC, sizeof(CANVAS_MAGIC)) == 0 &&
+            header.version >= 1 && header.version <= CANVAS_VERSION &&
+            header.columns > 0 && header.rows > 0 && header.cellSize > 0.f &&
+            Fits(header.strokesOffset, header.strokeCount, sizeof(StrokeRecord), size) &&
+            Fits(header.pointsOffset, header.pointCount, sizeof(Point), size) &&
+            Fits(header.cellsOffset, cellCount + 1, sizeof(std::uint32_t), size) &&
+            Fits(header.cellStrokesOffset, header.cellStrokeCount, sizeof(std::uint32_t), size);
+
+        if (!valid) {
+            LOG_LINE("Not a valid canvas file: " << path);
+            this->Close();
+            return false;
+        }
+        return true;
+    }
+
+    void MappedCanvas::Close() {
+#ifndef _WIN32
+        if (data != nullptr)
+            ::munmap(const_cast<char*>(data), size);
+#endif
+        copy.reset();
+        data = nullptr;
+        size = 0;
+    }
+
+    bool MappedCanvas::IsOpen() const { return data != nullptr; }
+
+    const CanvasHeader &MappedCanvas::GetHeader() const { return *reinterpret_cast<const CanvasHeader*>(data); }
+
+    std::span<const StrokeRecord> MappedCanvas::GetStrokes() const {
+        if (!this->IsOpen())
+            return {};
+        const CanvasHeader& header = this->GetHeader();
+        return { reinterpret_cast<const StrokeRecord*>(data + header.strokesOffset), header.strokeCount };
+    }
+
+    std::span<const Point> MappedCanvas::GetPoints(const StrokeRecord &stroke) const {
+        const CanvasHeader& header = this->GetHeader();
+        if (stroke.firstPoint > header.pointCount || header.pointCount - stroke.firstPoint < stroke.pointCount)
+            return {};
+        return { reinterpret_cast<const Point*>(data + header.pointsOffset) + stroke.firstPoint, stroke.pointCount };
+    }
+
+    std::vector<std::uint32_t> MappedCanvas::Query(Point min, Point max) const {
+        std::vector<std::uint32_t> found;
+        if (!this->IsOpen())
+            return found;
+
+        const CanvasHeader& header = this->GetHeader();
+        if (header.strokeCount == 0 || !Intersects(min, max, header.min, header.max))
+            return found;
+
+        const std::uint32_t c0 = Cell(min.x, header.min.x, header.cellSize, header.columns);
+        const std::uint32_t c1 = Cell(max.x, header.min.x, header.cellSize, header.columns);
+        const std::uint32_t r0 = Cell(min.y, header.min.y, header.cellSize, header.rows);
+        const std::uint32_t r1 = Cell(max.y, header.min.y, header.cellSize, header.rows);
+
+        const auto* cellStart = reinterpret_cast<const std::uint32_t*>(data + header.cellsOffset);
+        const auto* cellStrokes = reinterpret_cast<const std::uint32_t*>(data + header.cellStrokesOffset);
+
+        for (std::uint32_t r = r0; r <= r1; r++) {
+            for (std::uint32_t c = c0; c <= c1; c++) {
+                const std::size_t cell = static_cast<std::size_t>(r) * header.columns + c;
+                const std::uint32_t last = std::min<std::uint64_t>(cellStart[cell + 1], header.cellStrokeCount);
+                for (std::uint32_t i = cellStart[cell]; i < last; i++)
+                    found.push_back(cellStrokes[i]);
+            }
+        }
+
+        // Strokes spanning several cells are listed in each of them. Sorted indices are the drawing order.
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+
+        const auto strokes = this->GetStrokes();
+        std::erase_if(found, [&](std::uint32_t i) {
+            return i >= strokes.size() || !strokes[i].visible || !Intersects(min, max, strokes[i].min, strokes[i].max);
+        });
+        return found;
+    }
+
+    std::vector<Operation> MappedCanvas::ToOperations() const {
+        std::vector<Operation> ops;
+        ops.reserve(this->GetStrokes().size());
+
+        for (const auto& record : this->GetStrokes()) {
+            const auto points = this->GetPoints(record);
+
+            Line line;
+            line.points.assign(points.begin(), points.end());
+            line.color = record.color;
+            line.thickness = record.thickness;
+            line.id = record.id;
+            line.translation = record.translation;
+            line.visible = record.visible != 0;
+            line.smooth = (record.flags & STROKE_SMOOTH) != 0;
+
+            const OperationLog::Stamps stamps {
+                { record.addedClock, record.addedAuthor },
+                { record.visibilityClock, record.visibilityAuthor },
+                { record.transformClock, record.transformAuthor }
+            };
+            OperationLog::RebuildStroke(std::move(line), stamps, ops);
+        }
+
+        return ops;
+    }
+}
@@ -0,0 +1,107 @@
+#include "canvas/Curve.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils/settings.h"
+
+namespace Core::Rendering {
+    static float DistanceToSegment(Point p, Point a, Point b) {
+        const float dx = b.x - a.x, dy = b.y - a.y;
+        const float lengthSq = dx * dx + dy * dy;
+        const float t = lengthSq > 0.f ? std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / lengthSq, 0.f, 1.f) : 0.f;
+        return std::hypot(a.x + t * dx - p.x, a.y + t * dy - p.y);
+    }
+
+    // Bézier control points of the span between points[i] and points[i + 1]
+    static void Span(const Point* points, std::size_t count, std::size_t i, Point (&b)[4]) {
+        const Point p0 = points[i > 0 ? i - 1 : i];
+        const Point p1 = points[i], p2 = points[i + 1];
+        const Point p3 = points[i + 2 < count ? i + 2 : i + 1];
+
+        b[0] = p1;
+        b[1] = { p1.x + (p2.x - p0.x) / 6.f, p1.y + (p2.y - p0.y) / 6.f };
+        b[2] = { p2.x - (p3.x - p1.x) / 6.f, p2.y - (p3.y - p1.y) / 6.f };
+        b[3] = p2;
+    }
+
+    void StrokeSampler::Begin(Point position, std::vector<Point> &points) {
+        points.assign({ position, position });
+        path.assign({ position });
+    }
+
+    bool StrokeSampler::Add(Point position, float tolerance, std::vector<Point> &points) {
+        if (points.size() < 2)
+            this->Begin(position, points);
+
+        points.back() = position;
+
+        // Jitter of a hand holding still is not a curve
+        const Point last = path.back();
+        if (std::hypot(position.x - last.x, position.y - last.y) < tolerance)
+            return false;
+        path.push_back(position);
+
+        const Point anchor = points[points.size() - 2];
+        bool strays = path.size() > Networking::Settings::STROKE_MAX_PATH;
+        for (std::size_t i = 1; i + 1 < path.size() && !strays; i++)
+            strays = DistanceToSegment(path[i], anchor, position) > tolerance;
+        if (!strays)
+            return false;
+
+        // Chord up to the sample before still fitted, that one is the new control point
+        const Point corner = path[path.size() - 2];
+        points.back() = corner;
+        points.push_back(position);
+        path.assign({ corner, position });
+        return true;
+    }
+
+    void ExpandCurve(const Point *points, std::size_t count, float tolerance, std::vector<Point> &out) {
+        out.clear();
+        if (count == 0)
+            return;
+
+        out.push_back(points[0]);
+        for (std::size_t i = 0; i + 1 < count; i++) {
+            Point b[4];
+            Span(points, count, i, b);
+
+            // Wang's formula: pieces a cubic needs to stay within tolerance of its chords
+            const float ddx = std::max(std::abs(b[0].x - 2.f * b[1].x + b[2].x), std::abs(b[1].x - 2.f * b[2].x + b[3].x));
+            const float ddy = std::max(std::abs(b[0].y - 2.f * b[1].y + b[2].y), std::abs(b[1].y - 2.f * b[2].y + b[3].y));
+            const float pieces = std::sqrt(0.75f * std::hypot(ddx, ddy) / tolerance);
+            // Also catches NaN
+            const int n = pieces > 1.f ? static_cast<int>(std::ceil(std::min<float>(pieces, Networking::Settings::CURVE_MAX_PIECES))) : 1;
+
+            for (int k = 1; k < n; k++) {
+                const float t = static_cast<float>(k) / n, u = 1.f - t;
+                const float w0 = u * u * u, w1 = 3.f * u * u * t, w2 = 3.f * u * t * t, w3 = t * t * t;
+                out.push_back({
+                    w0 * b[0].x + w1 * b[1].x + w2 * b[2].x + w3 * b[3].x,
+                    w0 * b[0].y + w1 * b[1].y + w2 * b[2].y + w3 * b[3].y
+                });
+            }
+            out.push_back(b[3]);
+        }
+    }
+
+    void CurveBounds(const Point *points, std::size_t count, Point &min, Point &max) {
+        if (count == 0)
+            return;
+
+        min = max = points[0];
+        ExtendCurveBounds(points, count, 0, min, max);
+    }
+
+    void ExtendCurveBounds(const Point *points, std::size_t count, std::size_t first, Point &min, Point &max) {
+        for (std::size_t i = first; i + 1 < count; i++) {
+            Point b[4];
+            Span(points, count, i, b);
+            for (const Point& p : b) {
+                min = { std::min(min.x, p.x), std::min(min.y, p.y) };
+                max = { std::max(max.x, p.x), std::max(max.y, p.y) };
+            }
+        }
+    }
+}
@@ -0,0 +1,578 @@
+#include "canvas/OperationLog.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "canvas/Curve.h"
+#include "utils/settings.h"
+
+namespace Core::Canvas {
+    // Grows the bounds of a line by its points from 'first' on
+    static void ExtendBounds(Line& line, std::size_t first) {
+        // New control points bend the two spans before them as well. Those only ever grow:
+        // the end point that stood in for the new ones is on the chord, inside the bounds already.
+        if (line.smooth) {
+            if (first == 0)
+                Rendering::CurveBounds(line.points.data(), line.points.size(), line.min, line.max);
+            else
+                Rendering::ExtendCurveBounds(line.points.data(), line.points.size(), first < 2 ? 0 : first - 2, line.min, line.max);
+            return;
+        }
+
+        if (first == 0 && !line.points.empty())
+            line.min = line.max = line.points[0];
+
+        for (std::size_t i = first; i < line.points.size(); i++) {
+            const Point& p = line.points[i];
+            line.min = { std::min(line.min.x, p.x), std::min(line.min.y, p.y) };
+            line.max = { std::max(line.max.x, p.x), std::max(line.max.y, p.y) };
+        }
+    }
+
+    void OperationLog::SetLocalID(Networking::IDType id, std::uint32_t firstSequence) {
+        this->localID = id;
+        this->nextSequence = std::max(this->nextSequence, firstSequence);
+    }
+
+    Operation OperationLog::AddLocal(std::vector<Point> &&points, Color color, float thickness, bool smooth) {
+        Operation op = this->Stamped(Operation::Type::Add, StrokeID{ localID, nextSequence++ });
+        op.points = std::move(points);
+        op.color = color;
+        op.thickness = thickness;
+        op.smooth = smooth;
+
+        this->Apply(op);
+        this->PushHistory({ op.stroke, false });
+
+        return op;
+    }
+
+    std::optional<Operation> OperationLog::EraseLocal(StrokeID id) {
+        const Line* line = this->Find(id);
+        if (line == nullptr || !line->visible)
+            return std::nullopt;
+
+        Operation op = this->Stamped(Operation::Type::Remove, id);
+        this->Apply(op);
+        this->PushHistory({ id, true });
+
+        return op;
+    }
+
+    std::optional<Operation> OperationLog::TransformLocal(StrokeID id, Point translation) {
+        if (this->Find(id) == nullptr)
+            return std::nullopt;
+
+        Operation op = this->Stamped(Operation::Type::Transform, id);
+        op.translation = translation;
+        this->Apply(op);
+
+        return op;
+    }
+
+    std::optional<Operation> OperationLog::Undo() {
+        while (!undoHistory.empty()) {
+            HistoryEntry step = undoHistory.back();
+            undoHistory.pop_back();
+
+            // Stroke might be compacted already, nothing to undo then
+            if (!entries.contains(step.stroke))
+                continue;
+
+            Operation op = this->Stamped(step.erased ? Operation::Type::Restore : Operation::Type::Remove, step.stroke);
+            this->Apply(op);
+            redoHistory.push_back(step);
+
+            return op;
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<Operation> OperationLog::Redo() {
+        while (!redoHistory.empty()) {
+            HistoryEntry step = redoHistory.back();
+            redoHistory.pop_back();
+
+            if (!entries.contains(step.stroke))
+                continue;
+
+            Operation op = this->Stamped(step.erased ? Operation::Type::Remove : Operation::Type::Restore, step.stroke);
+            this->Apply(op);
+            undoHistory.push_back(step);
+
+            return op;
+        }
+
+        return std::nullopt;
+    }
+
+    bool OperationLog::Apply(const Operation &op) {
+        Operation copy = op;
+        return this->Apply(std::move(copy));
+    }
+
+    bool OperationLog::Apply(Operation &&op) {
+        // Lamport clock: always stay ahead of everything we've seen
+        clock = std::max(clock, op.clock);
+
+        // Strokes under our ID from before, e.g. from a saved board: don't reuse their IDs
+        if (op.stroke.client == localID && op.stroke.sequence >= nextSequence)
+            nextSequence = op.stroke.sequence + 1;
+
+        if (compacted.contains(op.stroke))
+            return false;
+
+        const Stamp stamp{ op.clock, op.author };
+        auto it = entries.find(op.stroke);
+
+        switch (op.type) {
+            case Operation::Type::Add: {
+                if (it != entries.end()) {
+                    // Continuation of a stroke that was split into several packages.
+                    // A package sent again or a board loaded twice brings chunks the stroke has already.
+                    Line& line = lines[it->second.index];
+                    const std::size_t first = line.points.size();
+                    if (stamp != it->second.added || op.firstPoint != first)
+                        return false;
+
+                    line.points.insert(line.points.end(), op.points.begin(), op.points.end());
+                    ExtendBounds(line, first);
+                    return line.visible;
+                }
+
+                // A chunk without the start of its stroke, e.g. of one evicted meanwhile, would leave it cut short
+                if (op.firstPoint != 0)
+                    return false;
+
+                Line line;
+                line.points = std::move(op.points);
+                line.points.reserve(op.totalPoints);
+                line.color = op.color;
+                line.thickness = op.thickness;
+                line.smooth = op.smooth;
+                line.id = op.stroke;
+                ExtendBounds(line, 0);
+                this->InsertLine(std::move(line), stamp);
+
+                // Merge registers that arrived ahead of the stroke
+                Entry& entry = entries.at(op.stroke);
+                if (auto p = pending.find(op.stroke); p != pending.end()) {
+                    if (p->second.visibility > entry.visibility)
+                        this->SetVisible(entry, p->second.visible, p->second.visibility);
+                    if (p->second.transform > entry.transform) {
+                        entry.transform = p->second.transform;
+                        lines[entry.index].translation = p->second.translation;
+                    }
+                    pending.erase(p);
+                }
+                return true;
+            }
+            case Operation::Type::Remove:
+            case Operation::Type::Restore: {
+                const bool visible = op.type == Operation::Type::Restore;
+
+                if (it == entries.end()) {
+                    PendingEntry& p = this->Pending(op.stroke);
+                    if (stamp > p.visibility) {
+                        p.visibility = stamp;
+                        p.visible = visible;
+                    }
+                    return false;
+                }
+
+                if (stamp <= it->second.visibility)
+                    return false;
+
+                const bool changed = lines[it->second.index].visible != visible;
+                this->SetVisible(it->second, visible, stamp);
+                return changed;
+            }
+            case Operation::Type::Transform: {
+                if (it == entries.end()) {
+                    PendingEntry& p = this->Pending(op.stroke);
+                    if (stamp > p.transform) {
+                        p.transform = stamp;
+                        p.translation = op.translation;
+                    }
+                    return false;
+                }
+
+                if (stamp <= it->second.transform)
+                    return false;
+
+                it->second.transform = stamp;
+                lines[it->second.index].translation = op.translation;
+                return lines[it->second.index].visible;
+            }
+        }
+
+        return false;
+    }
+
+    void OperationLog::ApplyBatch(std::vector<Operation> &&ops) {
+        std::size_t newLines = 0;
+        for (const auto& op : ops) {
+            if (op.type == Operation::Type::Add && op.totalPoints != 0)
+                newLines++;
+        }
+        lines.reserve(lines.size() + newLines);
+        entries.reserve(entries.size() + newLines);
+
+        batching = true;
+        for (auto& op : ops)
+            this->Apply(std::move(op));
+        batching = false;
+
+        if (outOfOrder)
+            this->RestoreOrder();
+    }
+
+    void OperationLog::CompactTombstones() {
+        using Networking::Settings::TOMBSTONE_MIN_AGE;
+
+        // Past the horizon late operations aren't expected anymore, same as for tombstones
+        while (!compactedOrder.empty() && compactedOrder.front().first + TOMBSTONE_MIN_AGE <= clock) {
+            compacted.erase(compactedOrder.front().second);
+            compactedOrder.pop_front();
+        }
+        while (!pendingOrder.empty() && pendingOrder.front().first + TOMBSTONE_MIN_AGE <= clock) {
+            const StrokeID id = pendingOrder.front().second;
+            pendingOrder.pop_front();
+
+            // Arrived meanwhile, or written again since and waited for a while longer
+            auto p = pending.find(id);
+            if (p == pending.end())
+                continue;
+            const std::uint64_t written = std::max(p->second.visibility.clock, p->second.transform.clock);
+            if (written + TOMBSTONE_MIN_AGE <= clock)
+                pending.erase(p);
+            else
+                pendingOrder.emplace_back(written, id);
+        }
+
+        // Tombstones left by the last pass are young or still in the history, scanning for them
+        // again pays off once more of them piled up or they had the time to age
+        if (tombstones < Networking::Settings::TOMBSTONE_COMPACT_THRESHOLD)
+            return;
+        if (tombstones < nextCompaction && clock < lastCompaction + TOMBSTONE_MIN_AGE)
+            return;
+
+        // Removal has to be old enough for every peer to have seen it,
+        // otherwise a late Restore would resurrect the stroke only on some peers.
+        auto isStale = [this](const Line& line) {
+            if (line.visible || this->IsInHistory(line.id))
+                return false;
+            return entries.at(line.id).visibility.clock + TOMBSTONE_MIN_AGE <= clock;
+        };
+
+        std::unordered_set<StrokeID> stale;
+        for (const auto& line : lines) {
+            if (isStale(line)) {
+                stale.insert(line.id);
+                compacted.insert(line.id);
+                compactedOrder.emplace_back(clock, line.id);
+                entries.erase(line.id);
+            }
+        }
+
+        tombstones -= stale.size();
+        nextCompaction = tombstones + Networking::Settings::TOMBSTONE_COMPACT_THRESHOLD;
+        lastCompaction = clock;
+        if (stale.empty())
+            return;
+
+        std::erase_if(lines, [&stale](const Line& line) { return stale.contains(line.id); });
+        for (std::size_t i = 0; i < lines.size(); i++)
+            entries.at(lines[i].id).index = i;
+    }
+
+    std::size_t OperationLog::Evict(const std::function<bool(const Line&)>& keep) {
+        std::unordered_set<StrokeID> history;
+        for (const auto& step : undoHistory)
+            history.insert(step.stroke);
+        for (const auto& step : redoHistory)
+            history.insert(step.stroke);
+
+        std::size_t removed = 0;
+        for (const auto& line : lines) {
+            if (history.contains(line.id) || keep(line))
+                continue;
+
+            if (!line.visible)
+                tombstones--;
+            entries.erase(line.id);
+            removed++;
+        }
+
+        if (removed == 0)
+            return 0;
+
+        std::erase_if(lines, [this](const Line& line) { return !entries.contains(line.id); });
+        for (std::size_t i = 0; i < lines.size(); i++)
+            entries.at(lines[i].id).index = i;
+
+        return removed;
+    }
+
+    std::optional<StrokeID> OperationLog::HitTest(Point point, float radius) const {
+        std::vector<Point> curve;
+
+        // Topmost stroke first
+        for (auto line = lines.rbegin(); line != lines.rend(); ++line) {
+            if (!line->visible)
+                continue;
+
+            const float r = radius + line->thickness * 0.5f;
+            const float px = point.x - line->translation.x;
+            const float py = point.y - line->translation.y;
+            if (px < line->min.x - r || px > line->max.x + r || py < line->min.y - r || py > line->max.y + r)
+                continue;
+
+            // Smooth strokes are tested against their curve, a fraction of the radius off at most
+            const std::vector<Point>* points = &line->points;
+            if (line->smooth) {
+                Rendering::ExpandCurve(line->points.data(), line->points.size(), radius * 0.25f, curve);
+                points = &curve;
+            }
+
+            for (std::size_t i = 0; i + 1 < points->size(); i++) {
+                const Point& a = (*points)[i];
+                const Point& b = (*points)[i + 1];
+
+                // Distance from the point to the segment
+                const float dx = b.x - a.x, dy = b.y - a.y;
+                const float lengthSq = dx * dx + dy * dy;
+                float t = lengthSq > 0.f ? ((px - a.x) * dx + (py - a.y) * dy) / lengthSq : 0.f;
+                t = std::clamp(t, 0.f, 1.f);
+
+                const float cx = a.x + t * dx - px, cy = a.y + t * dy - py;
+                if (cx * cx + cy * cy <= r * r)
+                    return line->id;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    const std::vector<Line> &OperationLog::GetLines() const { return lines; }
+
+    const Line *OperationLog::Find(StrokeID id) const {
+        auto it = entries.find(id);
+        return it == entries.end() ? nullptr : &lines[it->second.index];
+    }
+
+    bool OperationLog::IsCompacted(StrokeID id) const { return compacted.contains(id); }
+    std::size_t OperationLog::GetTombstoneCount() const { return tombstones; }
+    std::size_t OperationLog::GetCompactedCount() const { return compacted.size(); }
+    std::size_t OperationLog::GetPendingCount() const { return pending.size(); }
+
+    OperationLog::Stamps OperationLog::GetStamps(StrokeID id) const {
+        const Entry& entry = entries.at(id);
+        return Stamps{ entry.added, entry.visibility, entry.transform };
+    }
+
+    std::uint64_t OperationLog::GetClock() const { return clock; }
+
+    std::vector<Operation> OperationLog::Snapshot() const {
+        std::vector<Operation> ops;
+        ops.reserve(lines.size());
+
+        for (const auto& line : lines)
+            RebuildStroke(Line(line), this->GetStamps(line.id), ops);
+
+        return ops;
+    }
+
+    void OperationLog::RebuildStroke(Line &&line, const Stamps &stamps, std::vector<Operation> &ops) {
+        Operation add{ Operation::Type::Add, line.id, stamps.added.clock, stamps.added.author };
+        add.totalPoints = line.points.size();
+        add.points = std::move(line.points);
+        add.color = line.color;
+        add.thickness = line.thickness;
+        add.smooth = line.smooth;
+        ops.push_back(std::move(add));
+
+        // Registers still hold the Add stamp if nobody wrote them since
+        if (!line.visible || stamps.visibility != stamps.added) {
+            const auto type = line.visible ? Operation::Type::Restore : Operation::Type::Remove;
+            ops.push_back(Operation{ type, line.id, stamps.visibility.clock, stamps.visibility.author });
+        }
+        if (stamps.transform != Stamp{}) {
+            Operation transform{ Operation::Type::Transform, line.id, stamps.transform.clock, stamps.transform.author };
+            transform.translation = line.translation;
+            ops.push_back(std::move(transform));
+        }
+    }
+
+    std::vector<Networking::Package> OperationLog::Encode(const Operation &op) {
+        using namespace Networking;
+
+        std::vector<Package> packages;
+
+        nlohmann::json data;
+        data["id"] = { op.stroke.client, op.stroke.sequence };
+        data["clock"] = op.clock;
+
+        if (op.type != Operation::Type::Add) {
+            data["op"] = op.type;
+            if (op.type == Operation::Type::Transform)
+                data["translation"] = { op.translation.x, op.translation.y };
+
+            packages.emplace_back(
+                Package::Header{ data.dump().size(), Package::Type::BoardOperation, op.author },
+                Package::Body{ data }
+            );
+            return packages;
+        }
+
+        data["options"]["color"] = { op.color.r, op.color.g, op.color.b, op.color.a };
+        data["options"]["thickness"] = op.thickness;
+        if (op.smooth)
+            data["options"]["smooth"] = true;
+        data["totalPoints"] = op.points.size();
+
+        // Send the points in packages of POINTS_PER_PACKAGE each,
+        // the receiver appends them to the same stroke.
+        for (std::size_t first = 0; first < op.points.size() || first == 0; first += Settings::POINTS_PER_PACKAGE) {
+            const std::size_t last = std::min(op.points.size(), first + Settings::POINTS_PER_PACKAGE);
+
+            data["points"] = nlohmann::json::array();
+            for (std::size_t i = first; i < last; i++)
+                data["points"].push_back({ op.points[i].x, op.points[i].y });
+            data["numberOfPoints"] = last - first;
+            if (first != 0)
+                data["firstPoint"] = first;
+
+            packages.emplace_back(
+                Package::Header{ data.dump().size(), Package::Type::BoardUpdate, op.author },
+                Package::Body{ data }
+            );
+            data.erase("totalPoints"); // Only the first chunk carries it
+
+            if (last == op.points.size())
+                break;
+        }
+
+        return packages;
+    }
+
+    Operation OperationLog::Decode(const Networking::Package &package) {
+        using namespace Networking;
+
+        const auto& data = package.getBody().data;
+
+        Operation op{};
+        op.author = package.getHeader().senderID;
+        op.stroke = StrokeID{ data.at("id").at(0), data.at("id").at(1) };
+        op.clock = data.at("clock");
+
+        if (package.getHeader().type == Package::Type::BoardOperation) {
+            op.type = data.at("op");
+            if (op.type == Operation::Type::Transform)
+                op.translation = Point{ data.at("translation").at(0), data.at("translation").at(1) };
+            return op;
+        }
+
+        op.type = Operation::Type::Add;
+
+        const auto& options = data.at("options");
+        op.color = Color{ options.at("color").at(0), options.at("color").at(1), options.at("color").at(2), options.at("color").at(3) };
+        op.thickness = options.at("thickness");
+        op.smooth = options.value("smooth", false);
+
+        if (auto total = data.find("totalPoints"); total != data.end())
+            op.totalPoints = total->get<std::size_t>();
+        op.firstPoint = data.value("firstPoint", std::size_t{0});
+
+        // Decoding straight into the preallocated storage, walking the array once.
+        // A point that isn't numbers throws like any other broken field.
+        const auto& points = data.at("points");
+        const std::size_t numberOfPoints = data.at("numberOfPoints");
+        op.points.resize(std::min(numberOfPoints, points.size()));
+        for (std::size_t i = 0; i < op.points.size(); i++) {
+            const auto& p = points[i];
+            op.points[i] = Point{ p.at(0).get<float>(), p.at(1).get<float>() };
+        }
+
+        return op;
+    }
+
+    Operation OperationLog::Stamped(Operation::Type type, StrokeID stroke) {
+        Operation op{};
+        op.type = type;
+        op.stroke = stroke;
+        op.clock = ++clock;
+        op.author = localID;
+        return op;
+    }
+
+    void OperationLog::PushHistory(HistoryEntry entry) {
+        redoHistory.clear();
+        undoHistory.push_back(entry);
+        if (undoHistory.size() > Networking::Settings::UNDO_HISTORY_SIZE)
+            undoHistory.pop_front();
+    }
+
+    bool OperationLog::IsInHistory(StrokeID id) const {
+        auto matches = [id](const HistoryEntry& h) { return h.stroke == id; };
+        return std::any_of(undoHistory.begin(), undoHistory.end(), matches) ||
+               std::any_of(redoHistory.begin(), redoHistory.end(), matches);
+    }
+
+    void OperationLog::InsertLine(Line &&line, Stamp added) {
+        const StrokeID id = line.id;
+        Entry entry{ lines.size(), added, added, Stamp{} };
+
+        if (lines.empty() || entries.at(lines.back().id).added < added) {
+            lines.push_back(std::move(line));
+            entries.emplace(id, entry);
+            return;
+        }
+
+        if (batching) {
+            // Sorted once when the batch is over
+            lines.push_back(std::move(line));
+            entries.emplace(id, entry);
+            outOfOrder = true;
+            return;
+        }
+
+        // Arrived out of order, find its place and shift everything after it
+        auto position = std::upper_bound(
+            lines.begin(), lines.end(), added,
+            [this](const Stamp& stamp, const Line& l) { return stamp < entries.at(l.id).added; }
+        );
+        entry.index = position - lines.begin();
+        lines.insert(position, std::move(line));
+        entries.emplace(id, entry);
+
+        for (std::size_t i = entry.index + 1; i < lines.size(); i++)
+            entries.at(lines[i].id).index = i;
+    }
+
+    void OperationLog::RestoreOrder() {
+        std::stable_sort(lines.begin(), lines.end(), [this](const Line& a, const Line& b) {
+            return entries.at(a.id).added < entries.at(b.id).added;
+        });
+        for (std::size_t i = 0; i < lines.size(); i++)
+            entries.at(lines[i].id).index = i;
+
+        outOfOrder = false;
+    }
+
+    void OperationLog::SetVisible(Entry &entry, bool visible, Stamp stamp) {
+        Line& line = lines[entry.index];
+        if (line.visible && !visible) tombstones++;
+        else if (!line.visible && visible) tombstones--;
+
+        line.visible = visible;
+        entry.visibility = stamp;
+    }
+    OperationLog::PendingEntry &OperationLog::Pending(StrokeID id) {
+        auto [it, added] = pending.try_emplace(id);
+        if (added)
+            pendingOrder.emplace_back(clock, id);
+        return it->second;
+    }
+}
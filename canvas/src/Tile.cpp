@@ -0,0 +1,70 @@
+#include "canvas/Tile.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils/settings.h"
+
+namespace Core::Canvas {
+    // Far enough that no real board gets there, close enough that counting tiles can't overflow
+    static constexpr float TILE_COORDINATE_MAX = 1 << 30;
+
+    static std::int32_t TileCoordinate(float v) {
+        const float t = std::floor(v / Networking::Settings::TILE_SIZE);
+        // NaN fails both
+        if (!(t > -TILE_COORDINATE_MAX))
+            return -static_cast<std::int32_t>(TILE_COORDINATE_MAX);
+        if (!(t < TILE_COORDINATE_MAX))
+            return static_cast<std::int32_t>(TILE_COORDINATE_MAX);
+        return static_cast<std::int32_t>(t);
+    }
+
+    bool TileRange::Contains(Tile tile) const {
+        return tile.x >= min.x && tile.x <= max.x && tile.y >= min.y && tile.y <= max.y;
+    }
+
+    bool TileRange::Intersects(const TileRange &other) const {
+        return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+    }
+
+    std::size_t TileRange::Count() const {
+        return static_cast<std::size_t>(static_cast<std::int64_t>(max.x) - min.x + 1) *
+               static_cast<std::size_t>(static_cast<std::int64_t>(max.y) - min.y + 1);
+    }
+
+    Tile TileOf(Point point) {
+        return Tile{ TileCoordinate(point.x), TileCoordinate(point.y) };
+    }
+
+    TileRange TilesOf(Point min, Point max) {
+        const Tile a = TileOf(min), b = TileOf(max);
+        return TileRange{ { std::min(a.x, b.x), std::min(a.y, b.y) }, { std::max(a.x, b.x), std::max(a.y, b.y) } };
+    }
+
+    TileRange TilesOf(const Line& line) {
+        const float margin = line.thickness * 0.5f;
+        return TilesOf(
+            { line.min.x + line.translation.x - margin, line.min.y + line.translation.y - margin },
+            { line.max.x + line.translation.x + margin, line.max.y + line.translation.y + margin }
+        );
+    }
+
+    TileRange ViewTiles(Point min, Point max) {
+        using Networking::Settings::TILE_MARGIN;
+
+        TileRange range = TilesOf(min, max);
+        range.min = { range.min.x - TILE_MARGIN, range.min.y - TILE_MARGIN };
+        range.max = { range.max.x + TILE_MARGIN, range.max.y + TILE_MARGIN };
+        return range;
+    }
+
+    nlohmann::json ToJSON(Tile tile) {
+        return { tile.x, tile.y };
+    }
+
+    Tile TileFromJSON(const nlohmann::json &json) {
+        if (!json.is_array() || json.size() != 2 || !json[0].is_number_integer() || !json[1].is_number_integer())
+            throw nlohmann::json::type_error::create(302, "tile is not [x, y]", &json);
+        return Tile{ json[0].get<std::int32_t>(), json[1].get<std::int32_t>() };
+    }
+}
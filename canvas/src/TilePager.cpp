@@ -0,0 +1,203 @@
+#include "canvas/TilePager.h"
+
+#include <algorithm>
+
+namespace Core::Canvas {
+    TilePager::TilePager(std::size_t maxResident) : maxResident(maxResident) {
+    }
+
+    TilePager::Received TilePager::Receive(const Networking::Package &package) {
+        Received received;
+        if (package.getHeader().type == Networking::Package::Type::TileLoaded) {
+            for (const auto& tile : package.getBody().data.at("tiles"))
+                received.loaded.push_back(TileFromJSON(tile));
+            return received;
+        }
+        if (package.getHeader().type == Networking::Package::Type::TileDirty) {
+            for (const auto& tile : package.getBody().data.at("tiles"))
+                received.dirty.push_back(TileFromJSON(tile));
+            return received;
+        }
+
+        received.op = OperationLog::Decode(package);
+        received.paged = package.getBody().data.value("paged", false);
+        return received;
+    }
+
+    std::optional<nlohmann::json> TilePager::View(Point min, Point max) {
+        view = ViewTiles(min, max);
+        viewRect = { min.x, min.y, max.x, max.y };
+        if (view.Count() > Networking::Settings::TILE_REQUEST_MAX)
+            return std::nullopt;
+
+        nlohmann::json data;
+        data["tiles"] = nlohmann::json::array();
+        for (std::int32_t y = view.min.y; y <= view.max.y; y++) {
+            for (std::int32_t x = view.min.x; x <= view.max.x; x++) {
+                if (resident.contains({ x, y }))
+                    this->Touch({ x, y });
+                else
+                    data["tiles"].push_back(ToJSON({ x, y }));
+            }
+        }
+
+        if (pending || (data["tiles"].empty() && !resync))
+            return std::nullopt;
+
+        data["resident"] = nlohmann::json::array();
+        for (const Tile& tile : order)
+            data["resident"].push_back(ToJSON(tile));
+
+        pending = true;
+        resync = false;
+        return data;
+    }
+
+    std::optional<nlohmann::json> TilePager::Report(std::chrono::steady_clock::time_point now) {
+        if (reported == view || now - lastReport < std::chrono::milliseconds(Networking::Settings::VIEWPORT_INTERVAL_MS))
+            return std::nullopt;
+
+        reported = view;
+        lastReport = now;
+
+        nlohmann::json data;
+        data["view"] = viewRect;
+        return data;
+    }
+
+    std::vector<Operation> TilePager::Filter(std::vector<Received> &&received, const OperationLog &board) {
+        std::vector<Operation> ops;
+        ops.reserve(received.size());
+
+        // New strokes of this batch, not on the board yet
+        std::unordered_set<Rendering::StrokeID> added;
+        auto known = [&](Rendering::StrokeID id) { return board.Find(id) != nullptr || added.contains(id); };
+
+        for (auto& item : received) {
+            if (!item.dirty.empty()) {
+                // Fetched again once in view, until then strokes there stay as they were
+                for (const Tile& tile : item.dirty)
+                    this->MarkDirty({ tile, tile });
+                continue;
+            }
+            if (!item.op) {
+                this->Loaded(item.loaded);
+                continue;
+            }
+
+            Operation& op = *item.op;
+            if (op.type != Operation::Type::Add) {
+                if (known(op.stroke))
+                    ops.push_back(std::move(op));
+                continue;
+            }
+
+            // Only the first chunk of a stroke carries its size
+            const bool first = op.totalPoints > 0;
+
+            if (item.paged) {
+                // A stroke touching a tile that wasn't resident yet might have come live in the meantime
+                if (first && known(op.stroke))
+                    duplicates.insert(op.stroke);
+                else if (first)
+                    added.insert(op.stroke);
+                if (!duplicates.contains(op.stroke) && known(op.stroke))
+                    ops.push_back(std::move(op));
+                continue;
+            }
+
+            if (known(op.stroke)) {
+                ops.push_back(std::move(op));
+                continue;
+            }
+
+            // Curve of the whole stroke may bulge past the points of one chunk, a tile around them covers it
+            Point min = op.points.empty() ? Point{} : op.points[0], max = min;
+            for (const Point& p : op.points) {
+                min = { std::min(min.x, p.x), std::min(min.y, p.y) };
+                max = { std::max(max.x, p.x), std::max(max.y, p.y) };
+            }
+            TileRange range = TilesOf(min, max);
+            range.min = { range.min.x - 1, range.min.y - 1 };
+            range.max = { range.max.x + 1, range.max.y + 1 };
+            if (!Touches(range, resident))
+                continue;
+
+            if (first) {
+                added.insert(op.stroke);
+                ops.push_back(std::move(op));
+            }
+            else {
+                // Rest of a stroke whose start was elsewhere, the tiles it got to miss it now
+                this->MarkDirty(range);
+            }
+        }
+
+        return ops;
+    }
+
+    void TilePager::Evict(OperationLog &board) {
+        // The request on its way told the server what we hold
+        if (pending)
+            return;
+
+        // Never the tiles on screen, however many there are
+        const std::size_t limit = std::max(maxResident, view.Count());
+        if (resident.size() <= limit)
+            return;
+
+        while (resident.size() > limit) {
+            resident.erase(order.back());
+            order.pop_back();
+        }
+
+        board.Evict([this](const Line& line) { return Touches(TilesOf(line), resident); });
+    }
+
+    void TilePager::Reset() {
+        order.clear();
+        resident.clear();
+        duplicates.clear();
+        pending = false;
+        resync = false;
+        reported.reset();
+    }
+
+    void TilePager::Resync() {
+        // Same frame as the request, the server needs to know of the view to take what we hold
+        reported.reset();
+        lastReport = {};
+        resync = true;
+    }
+
+    std::size_t TilePager::GetResidentCount() const { return resident.size(); }
+
+    void TilePager::Touch(Tile tile) {
+        auto it = resident.find(tile);
+        if (it == resident.end()) {
+            order.push_front(tile);
+            resident.emplace(tile, order.begin());
+        }
+        else
+            order.splice(order.begin(), order, it->second);
+    }
+
+    void TilePager::Loaded(const std::vector<Tile> &tiles) {
+        for (const Tile& tile : tiles)
+            this->Touch(tile);
+
+        pending = false;
+        duplicates.clear();
+    }
+
+    void TilePager::MarkDirty(const TileRange &range) {
+        for (auto it = order.begin(); it != order.end();) {
+            if (range.Contains(*it)) {
+                resident.erase(*it);
+                it = order.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+}
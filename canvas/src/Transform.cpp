@@ -0,0 +1,71 @@
+#include "canvas/Transform.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DRAWING_ROOM_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Core::Rendering {
+    // Points are interleaved x, y pairs, so every vector lane
+    // pair gets the same (origin.x, origin.y) and the same zoom.
+    static void TransformScalar(const float* in, std::size_t floats, Point origin, float zoom, float* out) {
+        for (std::size_t i = 0; i < floats; i += 2) {
+            out[i] = origin.x + in[i] * zoom;
+            out[i + 1] = origin.y + in[i + 1] * zoom;
+        }
+    }
+
+#ifdef DRAWING_ROOM_X86
+    static void TransformSSE(const float* in, std::size_t floats, Point origin, float zoom, float* out) {
+        const __m128 o = _mm_setr_ps(origin.x, origin.y, origin.x, origin.y);
+        const __m128 z = _mm_set1_ps(zoom);
+
+        std::size_t i = 0;
+        for (; i + 4 <= floats; i += 4)
+            _mm_storeu_ps(out + i, _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(in + i), z)));
+
+        TransformScalar(in + i, floats - i, origin, zoom, out + i);
+    }
+
+#if defined(__GNUC__)
+    __attribute__((target("avx2,fma")))
+    static void TransformAVX2(const float* in, std::size_t floats, Point origin, float zoom, float* out) {
+        const __m256 o = _mm256_setr_ps(origin.x, origin.y, origin.x, origin.y, origin.x, origin.y, origin.x, origin.y);
+        const __m256 z = _mm256_set1_ps(zoom);
+
+        std::size_t i = 0;
+        for (; i + 16 <= floats; i += 16) {
+            __m256 a = _mm256_loadu_ps(in + i);
+            __m256 b = _mm256_loadu_ps(in + i + 8);
+            _mm256_storeu_ps(out + i, _mm256_fmadd_ps(a, z, o));
+            _mm256_storeu_ps(out + i + 8, _mm256_fmadd_ps(b, z, o));
+        }
+        for (; i + 8 <= floats; i += 8)
+            _mm256_storeu_ps(out + i, _mm256_fmadd_ps(_mm256_loadu_ps(in + i), z, o));
+
+        TransformScalar(in + i, floats - i, origin, zoom, out + i);
+    }
+#endif
+#endif
+
+    using TransformKernel = void (*)(const float*, std::size_t, Point, float, float*);
+
+    static TransformKernel PickKernel() {
+#ifdef DRAWING_ROOM_X86
+#if defined(__GNUC__)
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return TransformAVX2;
+#endif
+        return TransformSSE;
+#else
+        return TransformScalar;
+#endif
+    }
+
+    void TransformPoints(const Point *in, std::size_t count, Point origin, float zoom, Point *out) {
+        static const TransformKernel kernel = PickKernel();
+
+        static_assert(sizeof(Point) == 2 * sizeof(float));
+        kernel(reinterpret_cast<const float*>(in), count * 2, origin, zoom, reinterpret_cast<float*>(out));
+    }
+}
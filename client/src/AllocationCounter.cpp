@@ -0,0 +1,29 @@
+#ifdef DRAWING_ROOM_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+#include "gui/Profiler.h"
+
+// Every heap allocation of the process is counted for the profiler, the count is all the replacement does.
+// Defined in the executable, a library replacing them would do it for whatever links it.
+void* operator new(std::size_t size) {
+    Core::GUI::Profiler::CountAllocation();
+    if (size == 0)
+        size = 1;
+
+    while (true) {
+        if (void* p = std::malloc(size))
+            return p;
+
+        auto handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+#endif
@@ -3,12 +3,23 @@
 #include "imgui_internal.h"
 #include "misc/cpp/imgui_stdlib.h"
 #include "utils/log.h"
+#include "canvas/Transform.h"
+#include "canvas/CanvasFile.h"
+#include "gui/Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <utility>
+
+static_assert(sizeof(ImVec2) == sizeof(Core::Rendering::Point), "Board points are handed to ImGui as ImVec2");
 
 namespace Client {
     ClientApplication::ClientApplication() : guiLayer(new Core::GUI::ImGuiLayer) {
     }
 
     ClientApplication::~ClientApplication() {
+        // The receiving thread requests redraws, it's gone before the window is
         client.Stop();
         if (receiveThread.joinable())
             receiveThread.join();
@@ -25,36 +36,50 @@ namespace Client {
         client.pkgRecCallback = [this](const Core::Networking::Package &pkg) {
             using namespace Core::Networking;
 
+            this->packetsReceived.fetch_add(1, std::memory_order_relaxed);
             switch (pkg.getHeader().type) {
                 case Package::Type::TextMessage: {
-                    this->chat.push_back(pkg.getBody().data["message"]);
+                    std::lock_guard lock(this->inboxMutex);
+                    this->chatInbox.push_back(pkg.getBody().data.value("message", ""));
+                    break;
+                }
+                case Package::Type::BoardUpdate:
+                case Package::Type::BoardOperation:
+                case Package::Type::TileLoaded:
+                case Package::Type::TileDirty: {
+                    // Decoded here, applied by the render thread in one batch per frame
+                    auto received = Core::Canvas::TilePager::Receive(pkg);
+                    std::lock_guard lock(this->inboxMutex);
+                    this->inbox.push_back(std::move(received));
                     break;
                 }
-                case Package::Type::BoardUpdate: {
-                    this->lines.push_back(Core::Rendering::Line{});
-                    int linesCount = pkg.getBody().data.at("numberOfPoints");
-
-                    // Reading options
-                    Core::Rendering::Color c{};
-                    c.r = pkg.getBody().data.at("options").at("color").at(0);
-                    c.g = pkg.getBody().data.at("options").at("color").at(1);
-                    c.b = pkg.getBody().data.at("options").at("color").at(2);
-                    c.a = pkg.getBody().data.at("options").at("color").at(3);
-                    this->lines.back().color = c;
-
-                    this->lines.back().thickness = pkg.getBody().data.at("options").at("thickness");
-
-                    // Reading points
-                    for (int i = 0; i < linesCount; i++) {
-                        ImVec2 point;
-                        point.x = pkg.getBody().data.at("points").at(i).at(0);
-                        point.y = pkg.getBody().data.at("points").at(i).at(1);
-                        this->lines.back().points.push_back(point);
-                    }
+                case Package::Type::CursorUpdate:
+                case Package::Type::StrokePreview: {
+                    std::lock_guard lock(this->inboxMutex);
+                    this->transientInbox.push_back(pkg);
                     break;
                 }
                 case Package::Type::Handshake: break;
             }
+
+            this->guiLayer->RequestRedraw();
+        };
+
+        client.connectionLostCallback = [this]() { this->guiLayer->RequestRedraw(); };
+        client.reconnectCallback = [this](bool resumed) {
+            // A new session brings the board and chat again, nothing received before counts
+            if (!resumed) {
+                std::lock_guard lock(this->inboxMutex);
+                this->inbox.clear();
+                this->chatInbox.clear();
+                this->transientInbox.clear();
+                this->resetBoard = true;
+            }
+            else {
+                std::lock_guard lock(this->inboxMutex);
+                this->resyncTiles = true;
+            }
+            this->guiLayer->RequestRedraw();
         };
 
         return true;
@@ -64,27 +89,99 @@ namespace Client {
         this->guiLayer->Run();
     }
 
+    bool ClientApplication::InitHeadless(int width, int height) {
+        if (!guiLayer->InitHeadless(width, height))
+            return false;
+
+        this->headless = true;
+        guiLayer->SetClientSideWork([this]() { this->Render(); });
+        return true;
+    }
+
+    int ClientApplication::RunHeadless(const HeadlessOptions &options) {
+        using Clock = std::chrono::steady_clock;
+
+        if (!options.canvas.empty()) {
+            Core::Canvas::MappedCanvas saved;
+            if (!saved.Open(options.canvas)) {
+                LOG_LINE("Can't open canvas " << options.canvas);
+                return 1;
+            }
+            board.ApplyBatch(saved.ToOperations());
+        }
+
+        std::ofstream report;
+        if (!options.report.empty()) {
+            report.open(options.report, std::ios::trunc);
+            report << "frame,ms,vertices,indices,draw_lists,strokes_on_screen\n";
+        }
+        if (!options.trace.empty())
+            Core::GUI::Profiler::Get().StartTrace(options.trace);
+
+        HeadlessScript script(options.frames);
+        std::vector<double> times;
+        times.reserve(options.frames);
+        double vertices = 0.0;
+
+        for (std::size_t frame = 0; frame < options.frames; frame++) {
+            script.Feed(guiLayer->GetIO(), frame, canvasMin, canvasMax);
+
+            const auto start = Clock::now();
+            guiLayer->RunHeadlessFrame(1.f / 60.f);
+            times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            const ImDrawData* drawData = ImGui::GetDrawData();
+            vertices += drawData->TotalVtxCount;
+            if (report.is_open()) {
+                report << frame << ',' << times.back() << ',' << drawData->TotalVtxCount << ',' << drawData->TotalIdxCount
+                       << ',' << drawData->CmdListsCount << ',' << visibleLines.size() << '\n';
+            }
+        }
+        Core::GUI::Profiler::Get().StopTrace();
+
+        if (times.empty())
+            return 0;
+
+        std::vector<double> sorted = times;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](double p) { return sorted[static_cast<std::size_t>(p * (sorted.size() - 1))]; };
+        double total = 0.0;
+        for (double t : times)
+            total += t;
+
+        LOG_LINE(times.size() << " frames of " << board.GetLines().size() << " strokes: avg " << total / times.size()
+                 << " ms, p50 " << percentile(0.5) << " ms, p95 " << percentile(0.95) << " ms, max " << sorted.back()
+                 << " ms, " << vertices / times.size() << " vertices per frame");
+
+        if (options.budget > 0.0 && percentile(0.95) > options.budget) {
+            LOG_LINE("Over budget: p95 " << percentile(0.95) << " ms > " << options.budget << " ms");
+            return 1;
+        }
+        return 0;
+    }
+
     void ClientApplication::Render() {
-        if (!client.IsConnected() || connecting) {
+        if (((!client.IsConnected() && !client.IsReconnecting()) || connecting) && !headless) {
             ImGui::Begin("Lobby", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoResize);
 
             ImGui::InputText("Address", &address);
             ImGui::InputText("Port", &port);
             ImGui::InputText("Username", &username);
-
-            static bool loadTheCanvas = false;
-            ImGui::Checkbox("Load the canvas", &loadTheCanvas);
+            ImGui::InputText("Room", &room);
 
             if (!connecting) {
                 if (ImGui::Button("Connect")) {
                     client.SetUsername(username);
+                    client.SetRoom(room);
                     connecting = true;
                     auto ec = client.ConnectTo(address, port);
 
                     if (!ec) {
                         receiveThread = std::thread([this] {
-                            if (client.Handshake(loadTheCanvas)) {
+                            // Board comes in tiles once we see where we are on it
+                            if (client.Handshake()) {
                                 connecting = false;
+                                guiLayer->RequestRedraw();
                                 client.StartReading();
                             } else {
                                 LOG_LINE("Handshake failed");
@@ -93,8 +190,10 @@ namespace Client {
                     } else
                         LOG_LINE("Error connecting: " << ec.what());
                 }
-            } else
+            } else {
                 ImGui::ProgressBar(-1.0f * (float) ImGui::GetTime(), ImVec2(0.0f, 0.0f), "Connecting..");
+                guiLayer->RequestRedraw(); // Keep the progress bar animated
+            }
 
             ImGui::End();
         } else {
@@ -132,9 +231,21 @@ namespace Client {
 
             if (guiLayer->GetIO().ConfigFlags & ImGuiConfigFlags_DockingEnable) {
                 ImGuiID dockspace_id = ImGui::GetID("MainDockSpace");
+                if (headless && ImGui::DockBuilderGetNode(dockspace_id) == nullptr)
+                    this->DockHeadlessLayout(dockspace_id, viewport->WorkSize);
                 ImGui::DockSpace(dockspace_id, ImVec2(0.0f, 0.0f), dockspace_flags);
             }
 
+            {
+                PROFILE_SCOPE("Packet drain");
+                this->DrainInbox();
+                this->DrainTransient();
+            }
+
+            const std::uint64_t received = packetsReceived.load(std::memory_order_relaxed);
+            Core::GUI::Profiler::Get().CountEvents("Packets in", received - packetsCounted);
+            packetsCounted = received;
+
             this->RenderChat();
             this->RenderCanvas();
             this->RenderTools();
@@ -148,6 +259,9 @@ namespace Client {
     void ClientApplication::RenderChat() {
         ImGui::Begin("Chat", nullptr, ImGuiWindowFlags_NoScrollbar);
 
+        if (client.IsReconnecting())
+            ImGui::TextDisabled("Connection lost, reconnecting..");
+
         ImGui::InputText(" ", &message);
         ImGui::SameLine();
         if (ImGui::Button("Send", {ImGui::GetContentRegionAvail().x, 0.f}) && !message.empty()) {
@@ -155,7 +269,7 @@ namespace Client {
 
             nlohmann::json data;
             data["message"] = message;
-            client.AsyncSendPackage(Package{
+            client.Send(Package{
                 Package::Header{message.size(), Package::Type::TextMessage, (int)client.GetID()},
                 Package::Body{data}
             });
@@ -163,10 +277,36 @@ namespace Client {
             message = "";
         }
 
+        std::vector<std::string> received;
+        {
+            std::lock_guard lock(this->inboxMutex);
+            received.swap(this->chatInbox);
+        }
+        for (auto &m : received) {
+            // One line per message, the clipper below needs rows of the same height
+            while (!m.empty() && (m.back() == '\n' || m.back() == '\r'))
+                m.pop_back();
+            std::replace(m.begin(), m.end(), '\n', ' ');
+            chat.Add(m);
+        }
+
         ImGui::BeginChild("Scrolling");
-        for (const auto &m: chat) {
-            ImGui::Text("%s", m.c_str());
+        const bool atBottom = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+
+        // Only the rows in view are laid out, however long the log is
+        ImGuiListClipper clipper;
+        clipper.Begin((int)chat.Size());
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                const std::string_view m = chat[i];
+                ImGui::TextUnformatted(m.data(), m.data() + m.size());
+            }
         }
+        clipper.End();
+
+        // Follow new messages unless scrolled up to read older ones
+        if (!received.empty() && atBottom)
+            ImGui::SetScrollHereY(1.0f);
         ImGui::EndChild();
 
         ImGui::End(); // Chat
@@ -184,6 +324,8 @@ namespace Client {
         ImVec2 canvas_p0 = ImGui::GetCursorScreenPos();
         ImVec2 canvas_sz = ImGui::GetContentRegionAvail();
         ImVec2 canvas_p1 = ImVec2(canvas_p0.x + canvas_sz.x, canvas_p0.y + canvas_sz.y);
+        canvasMin = canvas_p0;
+        canvasMax = canvas_p1;
 
         // Draw borders and background
         ImDrawList *draw_list = ImGui::GetWindowDrawList();
@@ -201,8 +343,6 @@ namespace Client {
             (guiLayer->GetIO().MousePos.y - origin.y) / zoom
         );
 
-        static ImVec2 lastPoint;
-
         if (isHovered && this->guiLayer->GetIO().MouseWheel != 0.f) {
             // Scaling clamp
             float old_zoom = zoom;
@@ -215,78 +355,56 @@ namespace Client {
             offset.y += (mouse_pos_in_canvas.y * (old_zoom - zoom));
         }
 
-        if (isHovered && isActive && ImGui::IsMouseDragging(ImGuiMouseButton_Left, 0.0f) && !isDrawing) {
+        if (isHovered && isActive && ImGui::IsMouseDragging(ImGuiMouseButton_Left, 0.0f) && eraser) {
+            // Erase whatever stroke is under the cursor
+            auto hit = board.HitTest({ mouse_pos_in_canvas.x, mouse_pos_in_canvas.y }, 4.0f / zoom);
+            if (hit) {
+                if (auto op = board.EraseLocal(*hit))
+                    this->SendOperation(*op);
+            }
+        }
+        else if (isHovered && isActive && ImGui::IsMouseDragging(ImGuiMouseButton_Left, 0.0f) && !isDrawing) {
             // Create new line
-            lines.push_back(Core::Rendering::Line{});
-            lines.back().thickness = this->thickness;
-
-            lines.back().color.LoadFromArray(this->color);
-
-            lines.back().points.push_back(mouse_pos_in_canvas);
-            lines.back().points.push_back(mouse_pos_in_canvas);
+            currentLine = Core::Rendering::Line{};
+            currentLine.thickness = this->thickness;
 
-            this->currentLine = &lines.back();
+            currentLine.smooth = true;
+            currentLine.color.LoadFromArray(this->color);
+            strokeSampler.Begin({ mouse_pos_in_canvas.x, mouse_pos_in_canvas.y }, currentLine.points);
 
             isDrawing = true;
-            lastPoint = lines.back().points.back();
+            this->SendPreview();
         }
 
         if (isDrawing) {
-            this->currentLine->points.back() = mouse_pos_in_canvas;
-
-            if (sqrtf(powf(lastPoint.x - mouse_pos_in_canvas.x, 2) + powf(lastPoint.y - mouse_pos_in_canvas.y, 2)) > 8.0f) {
-                this->currentLine->points.push_back(mouse_pos_in_canvas);
-                lastPoint = lines.back().points.back();
-            }
+            // Control points where the path bends, the tolerance is in screen pixels
+            const float tolerance = Core::Networking::Settings::STROKE_TOLERANCE / zoom;
+            if (strokeSampler.Add({ mouse_pos_in_canvas.x, mouse_pos_in_canvas.y }, tolerance, currentLine.points))
+                this->SendPreview();
 
             if (!ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
                 isDrawing = false;
-                this->currentLine = nullptr;
-
-                using namespace Core::Networking;
 
-                // Construct package body
-                nlohmann::json data;
-                data["options"]["color"] = color;
-                data["options"]["thickness"] = thickness;
-                if (lines.back().points.size() <= Settings::POINTS_PER_PACKAGE) {
-                    data["numberOfPoints"] = lines.back().points.size();
-                    for (const auto &p: lines.back().points)
-                        data["points"].push_back({p.x,p.y});
-
-                    client.AsyncSendPackage(Package{
-                        Package::Header{data.dump().size(), Package::Type::BoardUpdate, (int)client.GetID()},
-                        Package::Body{data}
-                    });
-                }
-                else {
-                    // Send the points in packages 100 points each
-                    int pointsCount = 0;
-
-                    LOG_LINE(lines.back().points.size() << " points to send.");
-
-                    for (int i = 0; i < lines.back().points.size(); i++) {
-                        const auto &p = lines.back().points[i];
-                        data["points"].push_back({p.x, p.y});
-                        pointsCount++;
-
-                        if (pointsCount >= Settings::POINTS_PER_PACKAGE || i == lines.back().points.size() - 1) {
-                            data["numberOfPoints"] = pointsCount;
-                            // Send new line to the server
-                            client.AsyncSendPackage(Package{
-                                Package::Header{data.dump().size(), Package::Type::BoardUpdate, (int)client.GetID()},
-                                Package::Body{data}
-                            });
-
-                            // Reconstruct the package to prepare for the next line
-                            data.erase("points"); // Clear all the points we added so far. Those are already sent
-                            pointsCount = 0;
-                        }
-                    }
-                }
+                // Commit the stroke to the board and send it to the server
+                LOG_LINE(currentLine.points.size() << " points to send.");
+                this->SendOperation(board.AddLocal(std::move(currentLine.points), currentLine.color, currentLine.thickness, true));
+                currentLine.points.clear();
             }
         }
 
+        // Cursor comes from the same IO as everything else, presence decides if it's worth sending
+        if (isHovered && presence.SampleLocal({ mouse_pos_in_canvas.x, mouse_pos_in_canvas.y }, ImGui::GetTime()))
+            this->SendCursor({ mouse_pos_in_canvas.x, mouse_pos_in_canvas.y });
+        if (presence.HasPending())
+            guiLayer->RequestRedraw();
+
+        if (!guiLayer->GetIO().WantTextInput) {
+            if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Z))
+                this->Undo();
+            if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Y))
+                this->Redo();
+        }
+
         if (isActive && ImGui::IsMouseDragging(ImGuiMouseButton_Right, 0.0f)) {
             offset.x += guiLayer->GetIO().MouseDelta.x;
             offset.y += guiLayer->GetIO().MouseDelta.y;
@@ -301,6 +419,14 @@ namespace Client {
         ImGui::Text("%f, %f", mouse_pos_in_canvas.x, mouse_pos_in_canvas.y);
         ImGui::Text("%f, %f", offset.x, offset.y);
         ImGui::Text("%f", zoom);
+        ImGui::Text("%zu of %zu strokes on screen", visibleLines.size(), board.GetLines().size());
+        ImGui::Text("%zu tiles resident", pager.GetResidentCount());
+        ImGui::Separator();
+        ImGui::TextWrapped("Round trip: %s", client.GetRoundTrip().Summary().c_str());
+        ImGui::TextWrapped("Strokes of others: %s", client.GetStrokeLatency().Summary().c_str());
+        ImGui::Text("Previews lost: %llu", static_cast<unsigned long long>(client.GetDatagramsLost()));
+        ImGui::Separator();
+        Core::GUI::Profiler::Get().Render();
         ImGui::End();
 
         // Draw grid
@@ -316,15 +442,82 @@ namespace Client {
         }
 
         // Draw lines
-        for (const auto &[points, color, thickness] : lines) {
-            for (int i = 0; i < points.size() - 1; i++) {
-                draw_list->AddLine(
-                    ImVec2(origin.x + points[i].x * zoom, origin.y + points[i].y * zoom),
-                    ImVec2(origin.x + points[i + 1].x * zoom, origin.y + points[i + 1].y * zoom),
-                    IM_COL32(color.r * 255, color.g * 255, color.b* 255, color.a * 255),
-                    thickness
-                );
+        auto drawLine = [&](const Core::Rendering::Line &line) {
+            if (line.points.size() < 2)
+                return;
+
+            // Whole stroke goes to screen space in one pass, every point transformed once
+            screenPoints.resize(line.points.size());
+            Core::Rendering::TransformPoints(
+                line.points.data(), line.points.size(),
+                { origin.x + line.translation.x * zoom, origin.y + line.translation.y * zoom }, zoom,
+                screenPoints.data()
+            );
+
+            // Curves are flattened in screen space, as finely as the zoom needs
+            const auto* points = &screenPoints;
+            if (line.smooth) {
+                Core::Rendering::ExpandCurve(screenPoints.data(), screenPoints.size(), Core::Networking::Settings::CURVE_TOLERANCE, curvePoints);
+                points = &curvePoints;
             }
+
+            draw_list->AddPolyline(
+                reinterpret_cast<const ImVec2*>(points->data()), (int)points->size(),
+                IM_COL32(line.color.r * 255, line.color.g * 255, line.color.b* 255, line.color.a * 255),
+                ImDrawFlags_None, line.thickness
+            );
+        };
+
+        {
+            // Board rectangle on screen against the bounds of every stroke
+            PROFILE_SCOPE("Culling");
+            const Core::Rendering::Point viewMin{ (canvas_p0.x - origin.x) / zoom, (canvas_p0.y - origin.y) / zoom };
+            const Core::Rendering::Point viewMax{ (canvas_p1.x - origin.x) / zoom, (canvas_p1.y - origin.y) / zoom };
+
+            visibleLines.clear();
+            for (const auto &line : board.GetLines()) {
+                const float margin = line.thickness * 0.5f;
+                if (line.visible &&
+                    line.min.x + line.translation.x - margin <= viewMax.x && line.max.x + line.translation.x + margin >= viewMin.x &&
+                    line.min.y + line.translation.y - margin <= viewMax.y && line.max.y + line.translation.y + margin >= viewMin.y)
+                    visibleLines.push_back(&line);
+            }
+
+            // Pages in the tiles around it and tells the server where we look,
+            // while reconnecting both wait in the client
+            if (!headless && (client.IsConnected() || client.IsReconnecting())) {
+                using namespace Core::Networking;
+                auto request = pager.View(viewMin, viewMax);
+                if (auto report = pager.Report()) {
+                    client.Send(Package{
+                        Package::Header{ report->dump().size(), Package::Type::Viewport, (IDType)client.GetID() },
+                        Package::Body{ *report }
+                    });
+                }
+                if (request) {
+                    client.Send(Package{
+                        Package::Header{ request->dump().size(), Package::Type::TileRequest, (IDType)client.GetID() },
+                        Package::Body{ *request }
+                    });
+                }
+            }
+        }
+
+        {
+            PROFILE_SCOPE("Tessellation");
+            for (const auto *line : visibleLines)
+                drawLine(*line);
+            for (const auto &[author, preview] : previews)
+                drawLine(preview.line);
+            if (isDrawing)
+                drawLine(currentLine);
+        }
+
+        for (const auto &[author, cursor] : presence.GetCursors()) {
+            draw_list->AddCircleFilled(
+                ImVec2(origin.x + cursor.position.x * zoom, origin.y + cursor.position.y * zoom),
+                4.0f, IM_COL32(255, 200, 0, 255)
+            );
         }
         draw_list->PopClipRect();
 
@@ -337,6 +530,200 @@ namespace Client {
         ImGui::ColorEdit4("Colour", color);
         ImGui::Spacing();
         ImGui::SliderFloat("Thickness", &thickness, 0.f, 10.f);
+        ImGui::Checkbox("Eraser", &eraser);
+        ImGui::Spacing();
+
+        if (ImGui::Button("Undo"))
+            this->Undo();
+        ImGui::SameLine();
+        if (ImGui::Button("Redo"))
+            this->Redo();
+        ImGui::Spacing();
+
+        ImGui::InputText("File", &canvasPath);
+        // The board holds only the tiles around the view, strokes elsewhere aren't ours to save
+        if (ImGui::Button("Save loaded tiles"))
+            Core::Canvas::SaveCanvas(canvasPath, board);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Saves the %zu tiles around the view, strokes elsewhere on the board are left out", pager.GetResidentCount());
+        ImGui::SameLine();
+        if (ImGui::Button("Load"))
+            this->LoadCanvas();
         ImGui::End();
     }
+
+    void ClientApplication::LoadCanvas() {
+        Core::Canvas::MappedCanvas saved;
+        if (!saved.Open(canvasPath))
+            return;
+
+        // Saved strokes are drawn again as our own: their IDs may belong to someone else in this room by now
+        for (const auto &stroke : saved.GetStrokes()) {
+            if (!stroke.visible)
+                continue;
+
+            std::vector<Core::Rendering::Point> points;
+            points.reserve(stroke.pointCount);
+            for (const auto &p : saved.GetPoints(stroke))
+                points.push_back({ p.x + stroke.translation.x, p.y + stroke.translation.y });
+
+            this->SendOperation(board.AddLocal(std::move(points), stroke.color, stroke.thickness, (stroke.flags & Core::Canvas::STROKE_SMOOTH) != 0));
+        }
+    }
+
+    void ClientApplication::DockHeadlessLayout(ImGuiID dockspace, ImVec2 size) {
+        // No saved layout to restore, windows mustn't overlap the board or the script would click them
+        ImGui::DockBuilderAddNode(dockspace, ImGuiDockNodeFlags_DockSpace);
+        ImGui::DockBuilderSetNodeSize(dockspace, size);
+
+        ImGuiID side;
+        const ImGuiID boardNode = ImGui::DockBuilderSplitNode(dockspace, ImGuiDir_Left, 0.75f, nullptr, &side);
+        ImGui::DockBuilderDockWindow("Board", boardNode);
+        ImGui::DockBuilderDockWindow("Chat", side);
+        ImGui::DockBuilderDockWindow("Tools", side);
+        ImGui::DockBuilderDockWindow("dbg info", side);
+        ImGui::DockBuilderFinish(dockspace);
+    }
+
+    void ClientApplication::SendOperation(const Core::Canvas::Operation &op) {
+        // While reconnecting they wait in the client and go out once the session is back
+        if (!client.IsConnected() && !client.IsReconnecting())
+            return;
+
+        for (const auto &package : Core::Canvas::OperationLog::Encode(op))
+            client.Send(package);
+    }
+
+    void ClientApplication::SendPreview() {
+        using namespace Core::Networking;
+        if (!client.IsConnected())
+            return;
+
+        // Only the tail of the stroke, previews overlap so a lost datagram
+        // is covered by the next one. The whole stroke follows over TCP once finished.
+        const auto& points = currentLine.points;
+        const std::size_t from = points.size() > Settings::PREVIEW_POINTS ? points.size() - Settings::PREVIEW_POINTS : 0;
+
+        nlohmann::json data;
+        data["from"] = from;
+        data["points"] = nlohmann::json::array();
+        for (std::size_t i = from; i < points.size(); i++)
+            data["points"].push_back({ points[i].x, points[i].y });
+        data["color"] = { currentLine.color.r, currentLine.color.g, currentLine.color.b, currentLine.color.a };
+        data["thickness"] = currentLine.thickness;
+        data["smooth"] = currentLine.smooth;
+
+        client.SendDatagram(Package{
+            Package::Header{ data.dump().size(), Package::Type::StrokePreview, (IDType)client.GetID() },
+            Package::Body{ data }
+        });
+    }
+
+    void ClientApplication::SendCursor(Core::Rendering::Point position) {
+        using namespace Core::Networking;
+        if (!client.IsConnected())
+            return;
+
+        nlohmann::json data;
+        data["position"] = { position.x, position.y };
+
+        client.SendDatagram(Package{
+            Package::Header{ data.dump().size(), Package::Type::CursorUpdate, (IDType)client.GetID() },
+            Package::Body{ data }
+        });
+    }
+
+    void ClientApplication::DrainInbox() {
+        std::vector<Core::Canvas::TilePager::Received> received;
+        bool reset, resync;
+        {
+            std::lock_guard lock(this->inboxMutex);
+            received.swap(this->inbox);
+            reset = std::exchange(this->resetBoard, false);
+            resync = std::exchange(this->resyncTiles, false);
+        }
+
+        if (reset) {
+            board = Core::Canvas::OperationLog{};
+            pager.Reset();
+            previews.clear();
+            chat.Clear();
+        }
+        else if (resync)
+            pager.Resync();
+
+        // Our ID is known once the handshake is done
+        board.SetLocalID((Core::Networking::IDType)client.GetID(), client.GetFirstSequence());
+
+        // Finished stroke replaces its preview
+        for (const auto &item : received) {
+            if (item.op && item.op->type == Core::Canvas::Operation::Type::Add && !item.paged)
+                previews.erase(item.op->author);
+        }
+
+        if (!received.empty()) {
+            board.ApplyBatch(pager.Filter(std::move(received), board));
+            board.CompactTombstones();
+        }
+        pager.Evict(board);
+    }
+
+    void ClientApplication::DrainTransient() {
+        using namespace Core::Networking;
+
+        std::vector<Package> received;
+        {
+            std::lock_guard lock(this->inboxMutex);
+            received.swap(this->transientInbox);
+        }
+
+        const double now = ImGui::GetTime();
+        for (const auto &pkg : received) {
+            const auto &data = pkg.getBody().data;
+            const IDType sender = pkg.getHeader().senderID;
+
+            try {
+                if (pkg.getHeader().type == Package::Type::CursorUpdate) {
+                    // Only the server sends them, one frame with the whole room
+                    if (sender == Settings::SERVER_ID)
+                        presence.Apply(data, (IDType)client.GetID(), now);
+                    continue;
+                }
+
+                auto &preview = previews[sender];
+                auto &line = preview.line;
+                const auto &color = data.at("color");
+                line.color = Core::Rendering::Color{ color.at(0), color.at(1), color.at(2), color.at(3) };
+                line.thickness = data.at("thickness");
+                line.smooth = data.value("smooth", false);
+
+                // Points from 'from' on replace what we had, a gap left by lost datagrams becomes a straight segment
+                const std::size_t from = data.at("from");
+                if (from <= line.points.size())
+                    line.points.resize(from);
+                for (const auto &p : data.at("points"))
+                    line.points.push_back({ p.at(0).get<float>(), p.at(1).get<float>() });
+
+                preview.updated = now;
+            }
+            catch (const nlohmann::json::exception &) { }
+        }
+
+        std::erase_if(previews, [now](const auto &p) { return now - p.second.updated > PREVIEW_TIMEOUT; });
+
+        // Keep frames coming while cursors glide and until stale previews are gone
+        const bool cursorsMoving = presence.Update(now);
+        if (cursorsMoving || !previews.empty())
+            guiLayer->RequestRedraw();
+    }
+
+    void ClientApplication::Undo() {
+        if (auto op = board.Undo())
+            this->SendOperation(*op);
+    }
+
+    void ClientApplication::Redo() {
+        if (auto op = board.Redo())
+            this->SendOperation(*op);
+    }
 }
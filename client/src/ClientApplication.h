@@ -3,27 +3,16 @@
 
 #include "gui/ImGuiLayer.h"
 #include "networking/TCPClient.h"
-
+#include "networking/ChatLog.h"
+#include "canvas/OperationLog.h"
+#include "canvas/TilePager.h"
+#include "canvas/Curve.h"
+#include "Presence.h"
+#include "Headless.h"
+
+#include <mutex>
 #include <string>
-
-namespace Core::Rendering {
-    struct Color {
-        float r, g ,b, a;
-
-        void LoadFromArray(const float color[4]) {
-            r = color[0];
-            g = color[1];
-            b = color[2];
-            a = color[3];
-        }
-    };
-
-    struct Line {
-        ImVector<ImVec2> points{};
-        Color color;
-        float thickness;
-    };
-}
+#include <unordered_map>
 
 namespace Client {
     class ClientApplication {
@@ -35,6 +24,11 @@ namespace Client {
         void Run();
         void Render();
 
+        // Board only, without a window or a server. RunHeadless loads the canvas, plays a HeadlessScript
+        // and reports frame times and draw list sizes. Returns the exit code.
+        bool InitHeadless(int width, int height);
+        int RunHeadless(const HeadlessOptions& options);
+
         Core::GUI::ImGuiLayer &GetGUI() const;
 
     private:
@@ -42,21 +36,58 @@ namespace Client {
         void RenderCanvas();
         void RenderTools();
 
+        void DrainInbox();
+        void DrainTransient();
+        void SendOperation(const Core::Canvas::Operation& op);
+        void SendPreview();
+        void SendCursor(Core::Rendering::Point position);
+        void LoadCanvas();
+        void DockHeadlessLayout(ImGuiID dockspace, ImVec2 size);
+        void Undo();
+        void Redo();
+
         Core::GUI::ImGuiLayer *guiLayer;
 
         std::string address = "localhost", port = "1499", username = "user";
-        std::vector<std::string> chat;
+        std::string room = Core::Networking::Settings::DEFAULT_ROOM;
+        Core::Networking::ChatLog chat{ Core::Networking::Settings::CHAT_LOG_MESSAGES, Core::Networking::Settings::CHAT_LOG_BYTES };
+        std::vector<std::string> chatInbox; // Filled by the receiving thread, guarded by inboxMutex
         std::string message;
 
         Core::Networking::TCPClient client;
         std::thread receiveThread;
 
-        ImVector<Core::Rendering::Line> lines;
+        Core::Canvas::OperationLog board;
+        Core::Canvas::TilePager pager; // Which part of the board we hold
+        std::vector<Core::Canvas::TilePager::Received> inbox; // Filled by the receiving thread
+        std::mutex inboxMutex;
+        bool resetBoard = false; // Reconnected with a new session, guarded by inboxMutex
+        bool resyncTiles = false; // Resumed the session, maybe with another server process. Guarded by inboxMutex.
         float color[4] {0.f, 1.f, 0.f, 1.0f};
         float thickness = 2.f;
-        Core::Rendering::Line* currentLine = nullptr;
+        bool eraser = false;
+        std::string canvasPath = "board.canvas"; // Save and Load in the tools window
+        Core::Rendering::Line currentLine; // Stroke being drawn, goes to the board once finished
+        Core::Rendering::StrokeSampler strokeSampler; // Turns the cursor path of currentLine into control points
+        std::vector<Core::Rendering::Point> screenPoints; // Scratch buffer for the stroke being rendered
+        std::vector<Core::Rendering::Point> curvePoints; // Same, once a smooth stroke is flattened
+        std::vector<const Core::Rendering::Line*> visibleLines; // Board strokes on screen this frame
+        ImVec2 canvasMin, canvasMax; // Board on screen, for scripted input
+        bool headless = false;
+
+        // Transient state of other users, from datagrams. Dropped once stale.
+        struct RemotePreview {
+            Core::Rendering::Line line; // Stroke the user is drawing right now
+            double updated;
+        };
+        std::vector<Core::Networking::Package> transientInbox; // Guarded by inboxMutex as well
+        std::unordered_map<Core::Networking::IDType, RemotePreview> previews;
+        Presence presence;
+        static constexpr double PREVIEW_TIMEOUT = 2.0; // Seconds without updates before a preview disappears
 
         std::atomic<bool> connecting = false;
+        std::atomic<std::uint64_t> packetsReceived = 0; // Counted by the receiving thread
+        std::uint64_t packetsCounted = 0; // Already handed to the profiler
     };
 
 }
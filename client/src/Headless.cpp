@@ -0,0 +1,79 @@
+#include "Headless.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Client {
+    static constexpr std::size_t STROKE_FRAMES = 60; // Length of one stroke of the drawing part
+    static constexpr float TWO_PI = 6.28318530718f;
+
+    HeadlessScript::HeadlessScript(std::size_t frames) : frames(std::max<std::size_t>(frames, 4)) {
+    }
+
+    void HeadlessScript::Feed(ImGuiIO &io, std::size_t frame, ImVec2 min, ImVec2 max) {
+        const ImVec2 center{ (min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f };
+        const ImVec2 size{ max.x - min.x, max.y - min.y };
+        // Board isn't laid out before the first frame
+        if (size.x <= 1.f || size.y <= 1.f)
+            return;
+
+        const std::size_t part = frames / 4;
+        const std::size_t step = frame % part;
+        const float t = static_cast<float>(step) / static_cast<float>(part);
+
+        switch (std::min<std::size_t>(frame / part, 3)) {
+            case 0: {
+                // Right drag around a circle, the whole board goes past the screen
+                const float radius = std::min(size.x, size.y) * 0.3f;
+                const ImVec2 position{ center.x + radius * std::cos(t * TWO_PI), center.y + radius * std::sin(t * TWO_PI) };
+                if (pressed != ImGuiMouseButton_Right)
+                    this->Press(io, ImGuiMouseButton_Right, position);
+                else
+                    io.AddMousePosEvent(position.x, position.y);
+                break;
+            }
+            case 1: {
+                // Zoom all the way in, then all the way out
+                this->Release(io);
+                io.AddMousePosEvent(center.x, center.y);
+                io.AddMouseWheelEvent(0.f, t < 0.5f ? 1.f : -1.f);
+                break;
+            }
+            case 2: {
+                // Wavy strokes across the board, one every STROKE_FRAMES
+                const float s = static_cast<float>(step % STROKE_FRAMES) / STROKE_FRAMES;
+                const float row = static_cast<float>((step / STROKE_FRAMES) % 8) / 8.f;
+                const ImVec2 position{
+                    min.x + size.x * (0.1f + 0.8f * s),
+                    min.y + size.y * (0.1f + 0.8f * row) + std::sin(s * TWO_PI * 2.f) * size.y * 0.04f
+                };
+
+                if (step % STROKE_FRAMES == STROKE_FRAMES - 1)
+                    this->Release(io);
+                else if (pressed != ImGuiMouseButton_Left)
+                    this->Press(io, ImGuiMouseButton_Left, position);
+                else
+                    io.AddMousePosEvent(position.x, position.y);
+                break;
+            }
+            default:
+                this->Release(io);
+                break;
+        }
+    }
+
+    void HeadlessScript::Press(ImGuiIO &io, int button, ImVec2 position) {
+        this->Release(io);
+        io.AddMousePosEvent(position.x, position.y);
+        io.AddMouseButtonEvent(button, true);
+        pressed = button;
+    }
+
+    void HeadlessScript::Release(ImGuiIO &io) {
+        if (pressed < 0)
+            return;
+
+        io.AddMouseButtonEvent(pressed, false);
+        pressed = -1;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <cstddef>
+#include <string>
+
+#include "imgui.h"
+
+namespace Client {
+    struct HeadlessOptions {
+        std::string canvas; // Board to load before the first frame
+        std::size_t frames = 600;
+        int width = 1280, height = 720;
+        std::string report; // Per frame CSV, nothing written if empty
+        std::string trace; // Chrome trace of the run, see Core::GUI::Profiler
+        double budget = 0.0; // 95th percentile of frame time in ms above which the run fails, 0 for none
+    };
+
+    // Input of a headless run, fed to ImGui the way a user would give it. The frames are split in four:
+    // panning the board around, zooming in and out, drawing strokes and sitting still.
+    // Same frame count gives the same input, so runs on different builds are comparable.
+    class HeadlessScript {
+    public:
+        explicit HeadlessScript(std::size_t frames);
+
+        // Queues the input of a frame. min and max are the board on screen, as of the previous frame.
+        void Feed(ImGuiIO& io, std::size_t frame, ImVec2 min, ImVec2 max);
+
+    private:
+        void Press(ImGuiIO& io, int button, ImVec2 position);
+        void Release(ImGuiIO& io);
+
+        std::size_t frames;
+        int pressed = -1; // Mouse button held down, -1 for none
+    };
+}
+
+#endif //HEADLESS_H
@@ -0,0 +1,71 @@
+#include "Presence.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utils/settings.h"
+
+namespace Client {
+    using namespace Core::Networking;
+
+    static constexpr double TICK = Settings::PRESENCE_TICK_MS / 1000.0;
+    static constexpr double TIMEOUT = Settings::PRESENCE_TIMEOUT_MS / 1000.0;
+
+    bool Presence::SampleLocal(Point position, double now) {
+        const bool moved = std::hypot(position.x - lastSent.x, position.y - lastSent.y) > Settings::CURSOR_DEAD_BAND;
+        if (lastSendTime >= 0.0 && !moved) {
+            pending = false;
+            return false;
+        }
+
+        if (lastSendTime >= 0.0 && now - lastSendTime < TICK) {
+            pending = true;
+            return false;
+        }
+
+        lastSent = position;
+        lastSendTime = now;
+        pending = false;
+        return true;
+    }
+
+    bool Presence::HasPending() const { return pending; }
+
+    void Presence::Apply(const nlohmann::json &data, IDType self, double now) {
+        // [[id, x, y], ...]
+        for (const auto &entry : data.value("cursors", nlohmann::json::array())) {
+            const IDType id = entry.at(0);
+            if (id == self)
+                continue;
+
+            const Point target{ entry.at(1).get<float>(), entry.at(2).get<float>() };
+            auto it = cursors.find(id);
+            if (it == cursors.end())
+                cursors.emplace(id, Cursor{ target, target, target, now });
+            else
+                it->second = Cursor{ it->second.position, target, it->second.position, now };
+        }
+
+        for (const auto &id : data.value("left", nlohmann::json::array()))
+            cursors.erase(id.get<IDType>());
+    }
+
+    bool Presence::Update(double now) {
+        std::erase_if(cursors, [now](const auto &c) { return now - c.second.updated > TIMEOUT; });
+
+        // Updates come once per tick, so a cursor takes one tick to get where it was sent
+        bool moving = false;
+        for (auto &[id, cursor] : cursors) {
+            const float t = static_cast<float>(std::clamp((now - cursor.updated) / TICK, 0.0, 1.0));
+            cursor.position = {
+                cursor.from.x + (cursor.to.x - cursor.from.x) * t,
+                cursor.from.y + (cursor.to.y - cursor.from.y) * t
+            };
+            moving |= t < 1.f;
+        }
+
+        return moving;
+    }
+
+    const std::unordered_map<IDType, Presence::Cursor> &Presence::GetCursors() const { return cursors; }
+}
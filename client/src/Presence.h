@@ -0,0 +1,45 @@
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+#include <unordered_map>
+
+#include "canvas/Line.h"
+#include "networking/TCPPackage.h"
+
+namespace Client {
+    using Core::Rendering::Point;
+
+    // Cursors of everyone in the room.
+    // Local cursor is throttled to one update per presence tick and dead-banded,
+    // remote ones come aggregated from the server and are interpolated between updates.
+    class Presence {
+    public:
+        struct Cursor {
+            Point from, to;
+            Point position; // What to draw right now
+            double updated; // Seconds, when 'to' arrived
+        };
+
+        // Called every frame with the local cursor. Returns true if it should be sent now.
+        bool SampleLocal(Point position, double now);
+        // A move was held back by the throttle, another frame is needed to send it
+        bool HasPending() const;
+
+        // Applies a presence frame from the server
+        void Apply(const nlohmann::json& data, Core::Networking::IDType self, double now);
+
+        // Moves cursors along and drops stale ones. Returns true while some cursor is still moving.
+        bool Update(double now);
+
+        const std::unordered_map<Core::Networking::IDType, Cursor>& GetCursors() const;
+
+    private:
+        Point lastSent{};
+        double lastSendTime = -1.0;
+        bool pending = false;
+
+        std::unordered_map<Core::Networking::IDType, Cursor> cursors;
+    };
+}
+
+#endif //PRESENCE_H
@@ -1,9 +1,40 @@
 #include "ClientApplication.h"
 #include "utils/log.h"
 
-int main()
+#include <cstdio>
+#include <cstring>
+
+// Usage: DrawingRoomClient
+//        DrawingRoomClient --headless [--canvas <file>] [--frames <count>] [--size <width>x<height>]
+//                          [--report <csv>] [--trace <json>] [--budget <ms>]
+// Headless mode needs neither a display nor a GPU: it plays a scripted pan, zoom and draw sequence
+// over the board and prints frame times, --budget fails the run if the 95th percentile is above it.
+
+int main(int argc, char** argv)
 {
+    bool headless = false;
+    Client::HeadlessOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0) headless = true;
+        else if (i + 1 < argc) {
+            if (std::strcmp(argv[i], "--canvas") == 0) options.canvas = argv[++i];
+            else if (std::strcmp(argv[i], "--frames") == 0) options.frames = std::stoul(argv[++i]);
+            else if (std::strcmp(argv[i], "--size") == 0) std::sscanf(argv[++i], "%dx%d", &options.width, &options.height);
+            else if (std::strcmp(argv[i], "--report") == 0) options.report = argv[++i];
+            else if (std::strcmp(argv[i], "--trace") == 0) options.trace = argv[++i];
+            else if (std::strcmp(argv[i], "--budget") == 0) options.budget = std::stod(argv[++i]);
+        }
+    }
+
     Client::ClientApplication app;
+    if (headless) {
+        if (!app.InitHeadless(options.width, options.height)) {
+            LOG_LINE("Failed to init headless application.");
+            return 1;
+        }
+        return app.RunHeadless(options);
+    }
+
     if (!app.Init()) {
         LOG_LINE("Failed to init application.");
         return 1;
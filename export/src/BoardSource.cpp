@@ -0,0 +1,121 @@
+#include "BoardSource.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "canvas/CanvasFile.h"
+#include "networking/SessionCapture.h"
+#include "networking/TCPClient.h"
+#include "utils/log.h"
+
+namespace Export {
+    using namespace Core::Networking;
+    using Core::Canvas::Operation;
+    using Core::Canvas::OperationLog;
+
+    static bool IsBoardPackage(const Package& package) {
+        return package.getHeader().type == Package::Type::BoardUpdate ||
+               package.getHeader().type == Package::Type::BoardOperation;
+    }
+
+    static bool LoadCanvasFile(const std::string& path, OperationLog& board) {
+        Core::Canvas::MappedCanvas canvas;
+        if (!canvas.Open(path))
+            return false;
+
+        board.ApplyBatch(canvas.ToOperations());
+        return true;
+    }
+
+    static bool LoadCapture(const std::string& path, const std::string& room, OperationLog& board) {
+        SessionReader reader;
+        if (!reader.Open(path))
+            return false;
+
+        // Room of every connection comes from its handshake
+        std::unordered_map<IDType, std::string> rooms;
+        std::vector<Operation> ops;
+
+        CaptureRecord record;
+        while (reader.Next(record)) {
+            if (record.event != CaptureRecord::Event::Package)
+                continue;
+
+            try {
+                Package package = Package::Parse(record.payload);
+                const auto& data = package.getBody().data;
+
+                if (package.getHeader().type == Package::Type::Handshake)
+                    rooms[record.connection] = data.value("room", std::string(Settings::DEFAULT_ROOM));
+                else if (IsBoardPackage(package) && rooms[record.connection] == room)
+                    ops.push_back(OperationLog::Decode(package));
+            }
+            catch (const nlohmann::json::exception&) { }
+        }
+
+        board.ApplyBatch(std::move(ops));
+        return true;
+    }
+
+    static bool LoadFromServer(const std::string& address, const std::string& room, OperationLog& board) {
+        const auto colon = address.rfind(':');
+        if (colon == std::string::npos)
+            return false;
+
+        TCPClient client;
+        client.SetUsername("export");
+        client.SetRoom(room);
+
+        std::vector<Operation> ops;
+        std::mutex mutex;
+        auto lastPackage = std::chrono::steady_clock::now();
+
+        client.pkgRecCallback = [&](const Package& package) {
+            if (!IsBoardPackage(package))
+                return;
+
+            std::lock_guard lock(mutex);
+            ops.push_back(OperationLog::Decode(package));
+            lastPackage = std::chrono::steady_clock::now();
+        };
+
+        if (client.ConnectTo(address.substr(0, colon), address.substr(colon + 1)) || !client.Handshake(true))
+            return false;
+
+        // The board comes in one burst right after the handshake, it's over once the server goes quiet
+        std::thread receiveThread([&client] { client.StartReading(); });
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            std::lock_guard lock(mutex);
+            if (std::chrono::steady_clock::now() - lastPackage > std::chrono::milliseconds(500))
+                break;
+        }
+        client.Stop();
+        receiveThread.join();
+
+        board.ApplyBatch(std::move(ops));
+        return true;
+    }
+
+    bool LoadBoard(const std::string &source, const std::string &room, OperationLog &board) {
+        if (!std::filesystem::exists(source))
+            return LoadFromServer(source, room, board);
+
+        // Files are told apart by their magic
+        char magic[4]{};
+        std::ifstream(source, std::ios::binary).read(magic, sizeof(magic));
+
+        if (std::memcmp(magic, "DRCV", 4) == 0)
+            return LoadCanvasFile(source, board);
+        if (std::memcmp(magic, "DRCP", 4) == 0)
+            return LoadCapture(source, room, board);
+
+        LOG_LINE(source << " is neither a canvas file nor a capture");
+        return false;
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef BOARDSOURCE_H
+#define BOARDSOURCE_H
+
+#include <string>
+
+#include "canvas/OperationLog.h"
+
+namespace Export {
+    // Fills the board from where it's kept: a canvas file (see CanvasFile.h),
+    // a session capture of a server (see SessionCapture.h), or a running server given as host:port.
+    // Captures and servers hold many rooms, only strokes of 'room' are taken.
+    bool LoadBoard(const std::string& source, const std::string& room, Core::Canvas::OperationLog& board);
+}
+
+#endif //BOARDSOURCE_H
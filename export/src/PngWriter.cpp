@@ -0,0 +1,108 @@
+#include "PngWriter.h"
+
+#include <cstring>
+
+namespace Export {
+    static constexpr std::uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    static constexpr std::size_t IDAT_SIZE = 1 << 16;
+
+    static void PutBE(std::uint8_t* out, std::uint32_t value) {
+        for (int i = 0; i < 4; i++)
+            out[i] = static_cast<std::uint8_t>(value >> (24 - 8 * i));
+    }
+
+    PngWriter::~PngWriter() {
+        if (deflating)
+            deflateEnd(&stream);
+    }
+
+    bool PngWriter::Open(const std::string &path, std::uint32_t width, std::uint32_t height) {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        this->width = width;
+        previous.assign(static_cast<std::size_t>(width) * 4, 0);
+        filtered.resize(previous.size() + 1);
+        compressed.resize(IDAT_SIZE);
+
+        file.write(reinterpret_cast<const char*>(SIGNATURE), sizeof(SIGNATURE));
+
+        std::uint8_t header[13];
+        PutBE(header, width);
+        PutBE(header + 4, height);
+        header[8] = 8;  // Bits per channel
+        header[9] = 6;  // RGBA
+        header[10] = 0; // Deflate
+        header[11] = 0; // Adaptive filtering
+        header[12] = 0; // Not interlaced
+        this->WriteChunk("IHDR", header, sizeof(header));
+
+        stream = z_stream{};
+        deflating = deflateInit(&stream, Z_DEFAULT_COMPRESSION) == Z_OK;
+        return deflating;
+    }
+
+    void PngWriter::WriteRow(const std::uint8_t *rgba) {
+        // Up filter: flat background and long strokes turn into runs of zeros
+        filtered[0] = 2;
+        for (std::size_t i = 0; i < previous.size(); i++)
+            filtered[i + 1] = static_cast<std::uint8_t>(rgba[i] - previous[i]);
+        std::memcpy(previous.data(), rgba, previous.size());
+
+        stream.next_in = filtered.data();
+        stream.avail_in = static_cast<uInt>(filtered.size());
+        this->Deflate(Z_NO_FLUSH);
+    }
+
+    bool PngWriter::Close() {
+        if (!deflating)
+            return false;
+
+        this->Deflate(Z_FINISH);
+        deflateEnd(&stream);
+        deflating = false;
+
+        this->WriteChunk("IEND", nullptr, 0);
+        file.close();
+        return static_cast<bool>(file);
+    }
+
+    bool PngWriter::Write(const std::string &path, std::uint32_t width, std::uint32_t height, const std::uint8_t *rgba) {
+        PngWriter writer;
+        if (!writer.Open(path, width, height))
+            return false;
+
+        for (std::uint32_t y = 0; y < height; y++)
+            writer.WriteRow(rgba + static_cast<std::size_t>(y) * width * 4);
+        return writer.Close();
+    }
+
+    void PngWriter::WriteChunk(const char type[4], const std::uint8_t *data, std::size_t size) {
+        std::uint8_t length[4], crc[4];
+        PutBE(length, static_cast<std::uint32_t>(size));
+
+        uLong checksum = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+        if (size > 0)
+            checksum = crc32(checksum, data, static_cast<uInt>(size));
+        PutBE(crc, static_cast<std::uint32_t>(checksum));
+
+        file.write(reinterpret_cast<const char*>(length), 4);
+        file.write(type, 4);
+        file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        file.write(reinterpret_cast<const char*>(crc), 4);
+    }
+
+    void PngWriter::Deflate(int flush) {
+        // Every time the output buffer fills up it goes out as one IDAT chunk
+        do {
+            stream.next_out = compressed.data();
+            stream.avail_out = static_cast<uInt>(compressed.size());
+            deflate(&stream, flush);
+
+            const std::size_t produced = compressed.size() - stream.avail_out;
+            if (produced > 0)
+                this->WriteChunk("IDAT", compressed.data(), produced);
+        } while (stream.avail_out == 0);
+    }
+}
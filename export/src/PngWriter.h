@@ -0,0 +1,44 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+namespace Export {
+    // Writes an 8 bit RGBA PNG row by row, so an image never has to be in memory as a whole
+    class PngWriter {
+    public:
+        PngWriter() = default;
+        ~PngWriter();
+
+        PngWriter(const PngWriter&) = delete;
+        PngWriter& operator=(const PngWriter&) = delete;
+
+        bool Open(const std::string& path, std::uint32_t width, std::uint32_t height);
+        // Rows go top to bottom, width * 4 bytes each
+        void WriteRow(const std::uint8_t* rgba);
+        // Returns false if anything failed since Open
+        bool Close();
+
+        // Whole image at once
+        static bool Write(const std::string& path, std::uint32_t width, std::uint32_t height, const std::uint8_t* rgba);
+
+    private:
+        void WriteChunk(const char type[4], const std::uint8_t* data, std::size_t size);
+        void Deflate(int flush);
+
+        std::ofstream file;
+        z_stream stream{};
+        bool deflating = false;
+        std::uint32_t width = 0;
+
+        std::vector<std::uint8_t> previous, filtered; // Rows for the Up filter
+        std::vector<std::uint8_t> compressed;
+    };
+}
+
+#endif //PNGWRITER_H
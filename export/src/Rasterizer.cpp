@@ -0,0 +1,159 @@
+#include "Rasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Export {
+    // Anti-aliasing adds half a pixel of falloff on each side of a stroke
+    static constexpr float FRINGE = 1.f;
+
+    static float HalfWidth(const Line& line, float scale) {
+        // Hairlines still cover a pixel, like ImGui draws them
+        return std::max(line.thickness * scale, 1.f) * 0.5f;
+    }
+
+    // Pixel coordinate to index, safe for coordinates way off the image
+    static int ClampToInt(float v, int lo, int hi) {
+        return static_cast<int>(std::clamp(v, static_cast<float>(lo), static_cast<float>(hi)));
+    }
+
+    Rasterizer::Rasterizer(const std::vector<Line> &lines, Point origin, float scale,
+                           std::uint32_t width, std::uint32_t height, std::uint32_t tileSize)
+        : lines(lines), origin(origin), scale(scale), width(width), height(height), tileSize(tileSize),
+          columns((width + tileSize - 1) / tileSize), rows((height + tileSize - 1) / tileSize)
+    {
+        bounds.resize(lines.size());
+        buckets.resize(static_cast<std::size_t>(columns) * rows);
+
+        for (std::uint32_t i = 0; i < lines.size(); i++) {
+            const Line& line = lines[i];
+            if (!line.visible || line.points.size() < 2)
+                continue;
+
+            Bounds b{ INFINITY, INFINITY, -INFINITY, -INFINITY };
+            for (const auto& p : line.points) {
+                b.minX = std::min(b.minX, p.x); b.maxX = std::max(b.maxX, p.x);
+                b.minY = std::min(b.minY, p.y); b.maxY = std::max(b.maxY, p.y);
+            }
+
+            const float margin = HalfWidth(line, scale) + FRINGE;
+            b.minX = (b.minX + line.translation.x - origin.x) * scale - margin;
+            b.maxX = (b.maxX + line.translation.x - origin.x) * scale + margin;
+            b.minY = (b.minY + line.translation.y - origin.y) * scale - margin;
+            b.maxY = (b.maxY + line.translation.y - origin.y) * scale + margin;
+            bounds[i] = b;
+
+            // Off the image, or NaN coordinates: no tile gets it
+            if (!(b.maxX >= 0.f && b.minX < static_cast<float>(width) && b.maxY >= 0.f && b.minY < static_cast<float>(height)))
+                continue;
+
+            const auto c0 = static_cast<std::uint32_t>(std::max(b.minX, 0.f) / tileSize);
+            const auto c1 = static_cast<std::uint32_t>(std::min(b.maxX, width - 1.f) / tileSize);
+            const auto r0 = static_cast<std::uint32_t>(std::max(b.minY, 0.f) / tileSize);
+            const auto r1 = static_cast<std::uint32_t>(std::min(b.maxY, height - 1.f) / tileSize);
+            for (std::uint32_t r = r0; r <= r1; r++)
+                for (std::uint32_t c = c0; c <= c1; c++)
+                    buckets[static_cast<std::size_t>(r) * columns + c].push_back(i);
+        }
+    }
+
+    std::uint32_t Rasterizer::GetColumns() const { return columns; }
+    std::uint32_t Rasterizer::GetRows() const { return rows; }
+    std::uint32_t Rasterizer::GetTileWidth(std::uint32_t column) const { return std::min(tileSize, width - column * tileSize); }
+    std::uint32_t Rasterizer::GetTileHeight(std::uint32_t row) const { return std::min(tileSize, height - row * tileSize); }
+
+    void Rasterizer::RenderTile(std::uint32_t column, std::uint32_t row, Color background, std::vector<std::uint8_t> &rgba) const {
+        const std::uint32_t tileWidth = this->GetTileWidth(column), tileHeight = this->GetTileHeight(row);
+        const float left = static_cast<float>(column * tileSize), top = static_cast<float>(row * tileSize);
+
+        // Premultiplied colour, and the coverage of the stroke being drawn.
+        // Coverage of one stroke is merged before blending, so joints of its segments aren't blended twice.
+        thread_local std::vector<float> pixels, coverage;
+        pixels.resize(static_cast<std::size_t>(tileWidth) * tileHeight * 4);
+        coverage.assign(static_cast<std::size_t>(tileWidth) * tileHeight, 0.f);
+        for (std::size_t i = 0; i < pixels.size(); i += 4) {
+            pixels[i] = background.r * background.a;
+            pixels[i + 1] = background.g * background.a;
+            pixels[i + 2] = background.b * background.a;
+            pixels[i + 3] = background.a;
+        }
+
+        for (const std::uint32_t index : buckets[static_cast<std::size_t>(row) * columns + column]) {
+            const Line& line = lines[index];
+            const float halfWidth = HalfWidth(line, scale);
+            const float reach = halfWidth + FRINGE;
+
+            // Part of the tile this stroke may touch
+            const Bounds& b = bounds[index];
+            const int x0 = ClampToInt(std::floor(b.minX - left), 0, tileWidth - 1);
+            const int x1 = ClampToInt(std::ceil(b.maxX - left), 0, tileWidth - 1);
+            const int y0 = ClampToInt(std::floor(b.minY - top), 0, tileHeight - 1);
+            const int y1 = ClampToInt(std::ceil(b.maxY - top), 0, tileHeight - 1);
+
+            const float offsetX = (line.translation.x - origin.x) * scale - left;
+            const float offsetY = (line.translation.y - origin.y) * scale - top;
+
+            for (std::size_t s = 0; s + 1 < line.points.size(); s++) {
+                const float ax = line.points[s].x * scale + offsetX, ay = line.points[s].y * scale + offsetY;
+                const float bx = line.points[s + 1].x * scale + offsetX, by = line.points[s + 1].y * scale + offsetY;
+
+                if (!std::isfinite(ax + ay + bx + by))
+                    continue;
+
+                // Empty range if the segment misses the tile
+                const int sx0 = ClampToInt(std::floor(std::min(ax, bx) - reach), x0, x1 + 1);
+                const int sx1 = ClampToInt(std::ceil(std::max(ax, bx) + reach), x0 - 1, x1);
+                const int sy0 = ClampToInt(std::floor(std::min(ay, by) - reach), y0, y1 + 1);
+                const int sy1 = ClampToInt(std::ceil(std::max(ay, by) + reach), y0 - 1, y1);
+                if (sx0 > sx1 || sy0 > sy1)
+                    continue;
+
+                const float dx = bx - ax, dy = by - ay;
+                const float lengthSq = dx * dx + dy * dy;
+                const float inverse = lengthSq > 0.f ? 1.f / lengthSq : 0.f;
+
+                for (int y = sy0; y <= sy1; y++) {
+                    const float py = y + 0.5f - ay;
+                    float* covered = coverage.data() + static_cast<std::size_t>(y) * tileWidth;
+
+                    for (int x = sx0; x <= sx1; x++) {
+                        // Distance from the pixel centre to the segment
+                        const float px = x + 0.5f - ax;
+                        const float t = std::clamp((px * dx + py * dy) * inverse, 0.f, 1.f);
+                        const float cx = px - t * dx, cy = py - t * dy;
+                        const float distance = std::sqrt(cx * cx + cy * cy);
+
+                        const float c = std::clamp(halfWidth + 0.5f - distance, 0.f, 1.f);
+                        covered[x] = std::max(covered[x], c);
+                    }
+                }
+            }
+
+            // Source over, then the coverage is cleared for the next stroke
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    const std::size_t i = static_cast<std::size_t>(y) * tileWidth + x;
+                    const float alpha = line.color.a * coverage[i];
+                    coverage[i] = 0.f;
+                    if (alpha <= 0.f)
+                        continue;
+
+                    float* pixel = pixels.data() + i * 4;
+                    pixel[0] = line.color.r * alpha + pixel[0] * (1.f - alpha);
+                    pixel[1] = line.color.g * alpha + pixel[1] * (1.f - alpha);
+                    pixel[2] = line.color.b * alpha + pixel[2] * (1.f - alpha);
+                    pixel[3] = alpha + pixel[3] * (1.f - alpha);
+                }
+            }
+        }
+
+        rgba.resize(pixels.size());
+        for (std::size_t i = 0; i < pixels.size(); i += 4) {
+            const float alpha = pixels[i + 3];
+            const float unpremultiply = alpha > 0.f ? 1.f / alpha : 0.f;
+            for (int channel = 0; channel < 3; channel++)
+                rgba[i + channel] = static_cast<std::uint8_t>(std::clamp(pixels[i + channel] * unpremultiply, 0.f, 1.f) * 255.f + 0.5f);
+            rgba[i + 3] = static_cast<std::uint8_t>(std::clamp(alpha, 0.f, 1.f) * 255.f + 0.5f);
+        }
+    }
+}
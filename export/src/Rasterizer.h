@@ -0,0 +1,50 @@
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "canvas/Line.h"
+
+namespace Export {
+    using Core::Rendering::Color;
+    using Core::Rendering::Line;
+    using Core::Rendering::Point;
+
+    // CPU rasterizer for one zoom level of a board. The image is cut into square tiles
+    // and every stroke is bucketed into the tiles its bounds touch, so a tile only
+    // looks at the strokes that can reach it and tiles can be rendered on any thread.
+    // Strokes are anti-aliased and blended once each, in drawing order.
+    class Rasterizer {
+    public:
+        // Board point p lands on pixel (p - origin) * scale. Stroke thickness scales with it.
+        Rasterizer(const std::vector<Line>& lines, Point origin, float scale,
+                   std::uint32_t width, std::uint32_t height, std::uint32_t tileSize);
+
+        std::uint32_t GetColumns() const;
+        std::uint32_t GetRows() const;
+        // Size of a tile in pixels, those on the right and bottom edges may be smaller
+        std::uint32_t GetTileWidth(std::uint32_t column) const;
+        std::uint32_t GetTileHeight(std::uint32_t row) const;
+
+        // Renders a tile into rgba, GetTileWidth * GetTileHeight * 4 bytes, rows top to bottom.
+        // Thread safe, every call only reads the board.
+        void RenderTile(std::uint32_t column, std::uint32_t row, Color background, std::vector<std::uint8_t>& rgba) const;
+
+    private:
+        struct Bounds {
+            float minX, minY, maxX, maxY; // Pixels
+        };
+
+        const std::vector<Line>& lines;
+        Point origin;
+        float scale;
+        std::uint32_t width, height, tileSize;
+        std::uint32_t columns, rows;
+
+        std::vector<Bounds> bounds; // Per line
+        std::vector<std::vector<std::uint32_t>> buckets; // Per tile, indices into lines in drawing order
+    };
+}
+
+#endif //RASTERIZER_H
@@ -0,0 +1,55 @@
+#include "ThreadPool.h"
+
+namespace Export {
+    ThreadPool::ThreadPool(std::size_t threads) {
+        for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); i++)
+            workers.emplace_back([this] { this->Work(); });
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    void ThreadPool::Submit(std::function<void()> task) {
+        {
+            std::lock_guard lock(mutex);
+            tasks.push(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    void ThreadPool::Wait() {
+        std::unique_lock lock(mutex);
+        idle.wait(lock, [this] { return tasks.empty() && busy == 0; });
+    }
+
+    void ThreadPool::Work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+
+                task = std::move(tasks.front());
+                tasks.pop();
+                busy++;
+            }
+
+            task();
+
+            {
+                std::lock_guard lock(mutex);
+                busy--;
+            }
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Export {
+    // Fixed set of workers taking tasks in the order they were submitted
+    class ThreadPool {
+    public:
+        explicit ThreadPool(std::size_t threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void Submit(std::function<void()> task);
+        // Blocks until every task submitted so far has finished
+        void Wait();
+
+    private:
+        void Work();
+
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable wake, idle;
+        std::size_t busy = 0;
+        bool stopping = false;
+    };
+}
+
+#endif //THREADPOOL_H
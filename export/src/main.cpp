@@ -0,0 +1,197 @@
+#include "BoardSource.h"
+#include "PngWriter.h"
+#include "Rasterizer.h"
+#include "ThreadPool.h"
+#include "canvas/Curve.h"
+#include "utils/log.h"
+#include "utils/settings.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+// Usage: DrawingRoomExport <source> <output> [--room <name>] [--scale <pixels per board unit>]
+//                          [--tile <pixels>] [--threads <count>] [--pyramid] [--transparent]
+// <source> is a canvas file, a session capture or host:port of a running server.
+// Without --pyramid <output> is one PNG of the whole board. With it <output> is a directory of
+// <zoom>/<x>/<y>.png tiles, zoom 0 fits the whole board in one tile and the last one is at --scale.
+// No window or GPU is needed.
+
+using namespace Export;
+
+static constexpr std::uint32_t IMAGE_MAX_SIZE = 1 << 20; // Pixels per side of a single image, use a pyramid beyond that
+static constexpr float BOARD_MARGIN = 16.f; // Board units around the strokes
+
+// Band by band: tiles of one band render on the pool while the band before is being compressed
+static bool ExportImage(const std::vector<Line>& lines, Point origin, float scale, std::uint32_t width, std::uint32_t height,
+                        std::uint32_t tileSize, Color background, ThreadPool& pool, const std::string& output) {
+    const Rasterizer rasterizer(lines, origin, scale, width, height, tileSize);
+
+    PngWriter png;
+    if (!png.Open(output, width, height))
+        return false;
+
+    std::vector<std::vector<std::uint8_t>> bands[2];
+    bands[0].resize(rasterizer.GetColumns());
+    bands[1].resize(rasterizer.GetColumns());
+
+    auto submitBand = [&](std::uint32_t row) {
+        for (std::uint32_t column = 0; column < rasterizer.GetColumns(); column++) {
+            pool.Submit([&, row, column] {
+                rasterizer.RenderTile(column, row, background, bands[row % 2][column]);
+            });
+        }
+    };
+
+    std::vector<std::uint8_t> scanline(static_cast<std::size_t>(width) * 4);
+    submitBand(0);
+    for (std::uint32_t row = 0; row < rasterizer.GetRows(); row++) {
+        pool.Wait();
+        if (row + 1 < rasterizer.GetRows())
+            submitBand(row + 1);
+
+        const auto& band = bands[row % 2];
+        for (std::uint32_t y = 0; y < rasterizer.GetTileHeight(row); y++) {
+            for (std::uint32_t column = 0; column < rasterizer.GetColumns(); column++) {
+                const std::size_t tileWidth = rasterizer.GetTileWidth(column);
+                std::memcpy(
+                    scanline.data() + static_cast<std::size_t>(column) * tileSize * 4,
+                    band[column].data() + y * tileWidth * 4,
+                    tileWidth * 4
+                );
+            }
+            png.WriteRow(scanline.data());
+        }
+    }
+    pool.Wait();
+
+    return png.Close();
+}
+
+// Every zoom level is rasterized on its own instead of downscaling the one below,
+// so strokes keep their shape and every tile is independent work for the pool
+static bool ExportPyramid(const std::vector<Line>& lines, Point origin, Point extent, float scale,
+                          std::uint32_t tileSize, Color background, ThreadPool& pool, const std::string& output) {
+    const float largest = std::max(extent.x, extent.y) * scale;
+    const int maxZoom = std::max(0, static_cast<int>(std::ceil(std::log2(largest / tileSize))));
+
+    std::atomic<bool> ok = true;
+    for (int zoom = 0; zoom <= maxZoom; zoom++) {
+        const float levelScale = std::ldexp(scale, zoom - maxZoom);
+        const auto width = std::max<std::uint32_t>(1, static_cast<std::uint32_t>(std::ceil(extent.x * levelScale)));
+        const auto height = std::max<std::uint32_t>(1, static_cast<std::uint32_t>(std::ceil(extent.y * levelScale)));
+        const Rasterizer rasterizer(lines, origin, levelScale, width, height, tileSize);
+
+        for (std::uint32_t x = 0; x < rasterizer.GetColumns(); x++) {
+            const auto directory = std::filesystem::path(output) / std::to_string(zoom) / std::to_string(x);
+            std::filesystem::create_directories(directory);
+
+            for (std::uint32_t y = 0; y < rasterizer.GetRows(); y++) {
+                pool.Submit([&, directory, x, y] {
+                    thread_local std::vector<std::uint8_t> rgba;
+                    rasterizer.RenderTile(x, y, background, rgba);
+
+                    const auto path = (directory / (std::to_string(y) + ".png")).string();
+                    if (!PngWriter::Write(path, rasterizer.GetTileWidth(x), rasterizer.GetTileHeight(y), rgba.data()))
+                        ok = false;
+                });
+            }
+        }
+
+        // Tiles of a level use its rasterizer
+        pool.Wait();
+        LOG_LINE("Zoom " << zoom << ": " << rasterizer.GetColumns() * rasterizer.GetRows() << " tiles");
+    }
+
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        LOG_LINE("Usage: " << argv[0] << " <canvas|capture|host:port> <output> [--room <name>] [--scale <factor>]"
+                 " [--tile <pixels>] [--threads <count>] [--pyramid] [--transparent]");
+        return 1;
+    }
+
+    const std::string source = argv[1], output = argv[2];
+    std::string room = Core::Networking::Settings::DEFAULT_ROOM;
+    float scale = 1.f;
+    std::uint32_t tileSize = 256;
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    bool pyramid = false;
+    Color background{ 50.f / 255.f, 50.f / 255.f, 50.f / 255.f, 1.f }; // Same as the board in the client
+
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--pyramid") == 0) pyramid = true;
+        else if (std::strcmp(argv[i], "--transparent") == 0) background = Color{ 0.f, 0.f, 0.f, 0.f };
+        else if (i + 1 < argc) {
+            if (std::strcmp(argv[i], "--room") == 0) room = argv[++i];
+            else if (std::strcmp(argv[i], "--scale") == 0) scale = std::stof(argv[++i]);
+            else if (std::strcmp(argv[i], "--tile") == 0) tileSize = std::max(16ul, std::stoul(argv[++i]));
+            else if (std::strcmp(argv[i], "--threads") == 0) threads = std::stoul(argv[++i]);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    Core::Canvas::OperationLog board;
+    if (!LoadBoard(source, room, board)) {
+        LOG_LINE("Can't load a board from " << source);
+        return 1;
+    }
+
+    // Curves are flattened once, finely enough for the largest scale
+    std::vector<Line> lines = board.GetLines();
+    for (auto& line : lines) {
+        if (!line.smooth)
+            continue;
+
+        std::vector<Point> flat;
+        Core::Rendering::ExpandCurve(line.points.data(), line.points.size(), Core::Networking::Settings::CURVE_TOLERANCE / scale, flat);
+        line.points = std::move(flat);
+        line.smooth = false;
+    }
+
+    // Image covers the visible strokes
+    Point min{ INFINITY, INFINITY }, max{ -INFINITY, -INFINITY };
+    for (const auto& line : lines) {
+        if (!line.visible)
+            continue;
+        for (const auto& p : line.points) {
+            min = { std::min(min.x, p.x + line.translation.x), std::min(min.y, p.y + line.translation.y) };
+            max = { std::max(max.x, p.x + line.translation.x), std::max(max.y, p.y + line.translation.y) };
+        }
+    }
+    if (!(min.x <= max.x && min.y <= max.y)) {
+        LOG_LINE("Nothing to export, the board is empty");
+        return 1;
+    }
+
+    const Point origin{ min.x - BOARD_MARGIN, min.y - BOARD_MARGIN };
+    const Point extent{ max.x - min.x + 2 * BOARD_MARGIN, max.y - min.y + 2 * BOARD_MARGIN };
+    if (!std::isfinite(extent.x * extent.y)) {
+        LOG_LINE("Board has strokes at infinity, can't export it");
+        return 1;
+    }
+
+    ThreadPool pool(threads);
+    bool ok;
+    if (pyramid)
+        ok = ExportPyramid(lines, origin, extent, scale, tileSize, background, pool, output);
+    else {
+        const double width = std::ceil(extent.x * scale), height = std::ceil(extent.y * scale);
+        if (!(width <= IMAGE_MAX_SIZE && height <= IMAGE_MAX_SIZE)) {
+            LOG_LINE("Image would be " << width << "x" << height << ", use --pyramid or a smaller --scale");
+            return 1;
+        }
+        ok = ExportImage(lines, origin, scale, static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height),
+                         tileSize, background, pool, output);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG_LINE((ok ? "Exported " : "Export failed, ") << lines.size() << " strokes in " << elapsed.count() << "s on " << threads << " threads");
+    return ok ? 0 : 1;
+}
@@ -6,7 +6,9 @@
 #define GL_SILENCE_DEPRECATION
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 #include <functional>
+#include <mutex>
 
 namespace Core::GUI {
     typedef std::function<void()> ClientSideWork;
@@ -19,16 +21,41 @@ namespace Core::GUI {
         bool Init();
         void Run();
 
+        // No window and no GPU: frames are built for a screen of the given size but never drawn.
+        // Input is whatever the caller queues on GetIO() before each RunHeadlessFrame.
+        bool InitHeadless(int width, int height);
+        // Builds one frame, its draw lists are left in ImGui::GetDrawData()
+        void RunHeadlessFrame(float deltaTime);
+        bool IsHeadless() const;
+
         ImGuiIO& GetIO() const;
 
         void SetClientSideWork(ClientSideWork&& work);
 
+        // When enabled (default) the loop sleeps until there is input or
+        // a redraw request instead of rendering every vsync.
+        void SetEventDriven(bool enabled);
+
+        // Asks for a new frame. Safe to call from any thread, wakes the loop up
+        // if it's waiting for events. Does nothing once the window is destroyed.
+        void RequestRedraw();
+
     private:
+        bool ShouldRender();
+        // Part of a frame shared by both modes, from the client's work to the draw data
+        void BuildFrame();
+
         GLFWwindow* window;
+        std::mutex windowMutex; // Written by the loop's thread, other threads read it under the lock only
         ImVec4 clearColor;
 
         ClientSideWork clientSideWork;
 
+        bool headless = false;
+        bool eventDriven = true;
+        int framesToRender = 0;
+        std::atomic<bool> redrawRequested = true;
+
     };
 }
 
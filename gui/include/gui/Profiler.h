@@ -0,0 +1,103 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Core::GUI {
+    // Frame profiler of the render thread. Phases of a frame are timed with scoped timers,
+    // counters (vertices, packets, ...) are added up per frame. Both are kept for the last
+    // HISTORY frames and drawn as histograms by Render. Timings can also be streamed
+    // to a Chrome trace file (chrome://tracing, Perfetto).
+    class Profiler {
+    public:
+        static constexpr std::size_t HISTORY = 240; // Frames kept for the histograms
+
+        static Profiler& Get();
+
+        void BeginFrame();
+        void EndFrame();
+
+        // Phases may nest. Names must outlive the profiler, string literals are expected.
+        void Begin(const char* phase);
+        void End();
+
+        // Size of something in the current frame (vertices, ...), adds up if counted several times
+        void Count(const char* counter, double value);
+        // Events that happened since the last call (packets, ...), also shown per second
+        void CountEvents(const char* counter, std::uint64_t events);
+
+        // Called for every heap allocation by an executable that counts them, safe before main
+        static void CountAllocation();
+        // Heap allocations made by the whole process so far, 0 if it doesn't count them
+        static std::uint64_t GetAllocations();
+
+        bool StartTrace(const std::string& path);
+        void StopTrace();
+        bool IsTracing() const;
+
+        // Histograms and trace controls, drawn into the current window
+        void Render();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        enum class Kind { Phase, Size, Events };
+
+        struct Series {
+            const char* name;
+            Kind kind;
+            double current = 0.0; // Sum over the frame in progress
+            std::array<float, HISTORY> values{}; // Finished frames, milliseconds for phases
+        };
+
+        struct OpenScope {
+            std::size_t series;
+            Clock::time_point start;
+        };
+
+        Profiler();
+        ~Profiler();
+
+        std::size_t Find(const char* name, Kind kind);
+        double Microseconds(Clock::time_point time) const;
+        // Events of the frames in the last second
+        double PerSecond(const Series& s) const;
+        void TraceEvent(const char* name, Clock::time_point start, Clock::time_point end);
+
+        std::vector<Series> series;
+        std::vector<OpenScope> open;
+        std::array<float, HISTORY> frameTimes{}; // Milliseconds
+        std::array<double, HISTORY> frameStarts{}; // Seconds since the profiler was created
+        std::size_t frame = 0; // Slot of the current frame in the histories
+        std::size_t frames = 0;
+        std::uint64_t allocationsAtStart = 0;
+
+        Clock::time_point created = Clock::now();
+        Clock::time_point frameStart;
+
+        std::ofstream trace;
+        std::string tracePath = "trace.json";
+    };
+
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(const char* phase) { Profiler::Get().Begin(phase); }
+        ~ScopedTimer() { Profiler::Get().End(); }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// Times the rest of the enclosing scope as a phase of the frame
+#define PROFILE_SCOPE(phase) ::Core::GUI::ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(phase)
+
+#endif //PROFILER_H
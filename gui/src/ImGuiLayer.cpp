@@ -1,7 +1,9 @@
 #include "gui/ImGuiLayer.h"
+#include "gui/Profiler.h"
 
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include "imgui_internal.h"
 
 #if defined(IMGUI_IMPL_OPENGL_ES2)
 #include <GLES2/gl2.h>
@@ -16,16 +18,31 @@
 #endif
 
 namespace Core::GUI {
+    // Frames rendered after anything happened. ImGui needs a couple of them
+    // to settle hover and layout state after input.
+    static constexpr int SETTLE_FRAMES = 3;
+    // Longest time the loop blocks waiting for events, in seconds.
+    static constexpr double IDLE_WAIT_TIMEOUT = 0.5;
+
     ImGuiLayer::ImGuiLayer() : window(nullptr) {
 
     }
 
     ImGuiLayer::~ImGuiLayer() {
+        if (this->IsHeadless()) {
+            if (ImGui::GetCurrentContext())
+                ImGui::DestroyContext();
+            return;
+        }
+
         ImGui_ImplOpenGL3_Shutdown();
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
 
+        // No thread wakes the loop up from now on
+        std::lock_guard lock(windowMutex);
         glfwDestroyWindow(window);
+        window = nullptr;
         glfwTerminate();
     }
 
@@ -63,12 +80,25 @@ namespace Core::GUI {
 #endif
 
         // Create window with graphics context
-        this->window = glfwCreateWindow(1280, 720, "Drawing room by @hackpulsar", nullptr, nullptr);
-        if (window == nullptr)
+        GLFWwindow* created = glfwCreateWindow(1280, 720, "Drawing room by @hackpulsar", nullptr, nullptr);
+        if (created == nullptr)
             return false;
+        {
+            std::lock_guard lock(windowMutex);
+            this->window = created;
+        }
         glfwMakeContextCurrent(window);
         glfwSwapInterval(1); // Enable vsync
 
+        // Input is noticed through ImGui's event queue, window changes need their own callbacks
+        glfwSetWindowUserPointer(window, this);
+        glfwSetWindowRefreshCallback(window, [](GLFWwindow* w) {
+            static_cast<ImGuiLayer*>(glfwGetWindowUserPointer(w))->RequestRedraw();
+        });
+        glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int, int) {
+            static_cast<ImGuiLayer*>(glfwGetWindowUserPointer(w))->RequestRedraw();
+        });
+
         // Setup Dear ImGui context
         IMGUI_CHECKVERSION();
         ImGui::CreateContext();
@@ -113,55 +143,155 @@ namespace Core::GUI {
         while (!glfwWindowShouldClose(window))
 #endif
         {
-            glfwPollEvents();
+            if (eventDriven && framesToRender == 0 && !redrawRequested)
+                glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+            else
+                glfwPollEvents();
+
             if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0)
             {
                 ImGui_ImplGlfw_Sleep(10);
                 continue;
             }
 
+            if (!this->ShouldRender())
+                continue;
+
+            Profiler& profiler = Profiler::Get();
+            profiler.BeginFrame();
+
             // Start the Dear ImGui frame
-            ImGui_ImplOpenGL3_NewFrame();
-            ImGui_ImplGlfw_NewFrame();
-            ImGui::NewFrame();
+            {
+                PROFILE_SCOPE("New frame");
+                ImGui_ImplOpenGL3_NewFrame();
+                ImGui_ImplGlfw_NewFrame();
+                ImGui::NewFrame();
+            }
 
-            this->clientSideWork();
+            this->BuildFrame();
 
-            // Rendering
-            ImGui::Render();
-            int display_w, display_h;
-            glfwGetFramebufferSize(window, &display_w, &display_h);
-            glViewport(0, 0, display_w, display_h);
-            glClearColor(
-                clearColor.x * clearColor.w,
-                clearColor.y * clearColor.w,
-                clearColor.z * clearColor.w,
-                clearColor.w
-            );
-            glClear(GL_COLOR_BUFFER_BIT);
-            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-            // Update and Render additional Platform Windows
-            if (this->GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
             {
-                GLFWwindow* backup_current_context = glfwGetCurrentContext();
-                ImGui::UpdatePlatformWindows();
-                ImGui::RenderPlatformWindowsDefault();
-                glfwMakeContextCurrent(backup_current_context);
+                PROFILE_SCOPE("GL submit");
+                int display_w, display_h;
+                glfwGetFramebufferSize(window, &display_w, &display_h);
+                glViewport(0, 0, display_w, display_h);
+                glClearColor(
+                    clearColor.x * clearColor.w,
+                    clearColor.y * clearColor.w,
+                    clearColor.z * clearColor.w,
+                    clearColor.w
+                );
+                glClear(GL_COLOR_BUFFER_BIT);
+                ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+                // Update and Render additional Platform Windows
+                if (this->GetIO().ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
+                {
+                    GLFWwindow* backup_current_context = glfwGetCurrentContext();
+                    ImGui::UpdatePlatformWindows();
+                    ImGui::RenderPlatformWindowsDefault();
+                    glfwMakeContextCurrent(backup_current_context);
+                }
             }
 
-            glfwSwapBuffers(window);
+            {
+                // Waits for vsync, a long swap is an idle GPU rather than slow code
+                PROFILE_SCOPE("Swap");
+                glfwSwapBuffers(window);
+            }
+
+            profiler.EndFrame();
         }
 #ifdef __EMSCRIPTEN__
         EMSCRIPTEN_MAINLOOP_END;
 #endif
     }
 
+    bool ImGuiLayer::InitHeadless(int width, int height) {
+        this->headless = true;
+
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO();
+        io.ConfigFlags |= ImGuiConfigFlags_DockingEnable; // No viewports, there is no platform to open windows with
+        io.IniFilename = nullptr; // Layout of a run mustn't depend on the one before
+        io.ConfigInputTrickleEventQueue = false; // Queued input is seen in the very next frame
+        io.DisplaySize = ImVec2(static_cast<float>(width), static_cast<float>(height));
+        io.DeltaTime = 1.f / 60.f;
+
+        // No renderer to upload the font texture to, it's only built
+        unsigned char* pixels = nullptr;
+        int atlasWidth = 0, atlasHeight = 0;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &atlasWidth, &atlasHeight);
+
+        ImGui::StyleColorsDark();
+        return true;
+    }
+
+    void ImGuiLayer::RunHeadlessFrame(float deltaTime) {
+        Profiler& profiler = Profiler::Get();
+        profiler.BeginFrame();
+
+        this->GetIO().DeltaTime = deltaTime;
+        {
+            PROFILE_SCOPE("New frame");
+            ImGui::NewFrame();
+        }
+
+        this->BuildFrame();
+        profiler.EndFrame();
+    }
+
+    bool ImGuiLayer::IsHeadless() const { return headless; }
+
+    void ImGuiLayer::BuildFrame() {
+        {
+            PROFILE_SCOPE("Client");
+            this->clientSideWork();
+        }
+
+        {
+            PROFILE_SCOPE("ImGui render");
+            ImGui::Render();
+        }
+        const ImDrawData* drawData = ImGui::GetDrawData();
+        Profiler::Get().Count("Vertices", drawData->TotalVtxCount);
+        Profiler::Get().Count("Indices", drawData->TotalIdxCount);
+    }
+
     ImGuiIO& ImGuiLayer::GetIO() const { return ImGui::GetIO(); }
 
     void ImGuiLayer::SetClientSideWork(ClientSideWork &&work) {
         this->clientSideWork = std::move(work);
     }
 
+    void ImGuiLayer::SetEventDriven(bool enabled) { this->eventDriven = enabled; }
+
+    void ImGuiLayer::RequestRedraw() {
+        // One wake-up per frame, however many packages arrive until the loop takes the request
+        if (redrawRequested.exchange(true) || this->IsHeadless())
+            return;
+
+        std::lock_guard lock(windowMutex);
+        if (window != nullptr)
+            glfwPostEmptyEvent();
+    }
+
+    bool ImGuiLayer::ShouldRender() {
+        // Backends feed input of every viewport through the event queue,
+        // anything in there means ImGui has to process a frame.
+        const bool hasInput = ImGui::GetCurrentContext()->InputEventsQueue.Size > 0;
+        if (redrawRequested.exchange(false) || hasInput)
+            framesToRender = SETTLE_FRAMES;
+
+        if (!eventDriven)
+            return true;
+        if (framesToRender == 0)
+            return false;
+
+        framesToRender--;
+        return true;
+    }
+
 
 }
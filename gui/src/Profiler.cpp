@@ -0,0 +1,202 @@
+#include "gui/Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+
+#include "imgui.h"
+#include "misc/cpp/imgui_stdlib.h"
+
+namespace Core::GUI {
+    // Counted only if the executable replaces operator new, see AllocationCounter.cpp of the client
+    static std::atomic<std::uint64_t> allocations{ 0 };
+
+    Profiler &Profiler::Get() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    Profiler::Profiler() {
+        series.reserve(16);
+        open.reserve(16);
+    }
+
+    Profiler::~Profiler() { this->StopTrace(); }
+
+    void Profiler::BeginFrame() {
+        frameStart = Clock::now();
+        frameStarts[frame] = std::chrono::duration<double>(frameStart - created).count();
+        allocationsAtStart = GetAllocations();
+    }
+
+    void Profiler::EndFrame() {
+        const auto now = Clock::now();
+        if (const std::uint64_t total = GetAllocations())
+            this->CountEvents("Allocations", total - allocationsAtStart);
+
+        if (trace.is_open()) {
+            this->TraceEvent("Frame", frameStart, now);
+            for (const auto& s : series) {
+                if (s.kind != Kind::Phase)
+                    trace << ",\n{\"name\":\"" << s.name << "\",\"ph\":\"C\",\"ts\":" << this->Microseconds(now)
+                          << ",\"pid\":1,\"tid\":1,\"args\":{\"value\":" << s.current << "}}";
+            }
+        }
+
+        frameTimes[frame] = std::chrono::duration<float, std::milli>(now - frameStart).count();
+        for (auto& s : series) {
+            s.values[frame] = static_cast<float>(s.current);
+            s.current = 0.0;
+        }
+
+        frame = (frame + 1) % HISTORY;
+        frames = std::min(frames + 1, HISTORY);
+        open.clear();
+    }
+
+    void Profiler::Begin(const char *phase) {
+        open.push_back({ this->Find(phase, Kind::Phase), Clock::now() });
+    }
+
+    void Profiler::End() {
+        if (open.empty())
+            return;
+
+        const auto now = Clock::now();
+        const OpenScope scope = open.back();
+        open.pop_back();
+
+        Series& s = series[scope.series];
+        s.current += std::chrono::duration<double, std::milli>(now - scope.start).count();
+        if (trace.is_open())
+            this->TraceEvent(s.name, scope.start, now);
+    }
+
+    void Profiler::Count(const char *counter, double value) {
+        series[this->Find(counter, Kind::Size)].current += value;
+    }
+
+    void Profiler::CountEvents(const char *counter, std::uint64_t events) {
+        series[this->Find(counter, Kind::Events)].current += static_cast<double>(events);
+    }
+
+    void Profiler::CountAllocation() { allocations.fetch_add(1, std::memory_order_relaxed); }
+    std::uint64_t Profiler::GetAllocations() { return allocations.load(std::memory_order_relaxed); }
+
+    bool Profiler::StartTrace(const std::string &path) {
+        this->StopTrace();
+
+        trace.open(path, std::ios::trunc);
+        if (!trace)
+            return false;
+
+        // Timestamps are microseconds since the start, exponent notation would lose them
+        trace << std::fixed << std::setprecision(3);
+        trace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                 "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Render\"}}";
+        return true;
+    }
+
+    void Profiler::StopTrace() {
+        if (!trace.is_open())
+            return;
+
+        trace << "\n]}\n";
+        trace.close();
+    }
+
+    bool Profiler::IsTracing() const { return trace.is_open(); }
+
+    void Profiler::Render() {
+        if (frames == 0)
+            return;
+
+        // Oldest frame first, the slot of the current frame is the oldest one
+        const int offset = static_cast<int>(frames < HISTORY ? 0 : frame);
+        const int count = static_cast<int>(frames);
+        const float width = ImGui::GetContentRegionAvail().x;
+        char overlay[64];
+
+        auto plot = [&](const char* label, const float* values, const char* unit) {
+            float sum = 0.f, max = 0.f;
+            for (int i = 0; i < count; i++) {
+                sum += values[i];
+                max = std::max(max, values[i]);
+            }
+            std::snprintf(overlay, sizeof(overlay), "avg %.2f%s, max %.2f%s", sum / count, unit, max, unit);
+            ImGui::PlotHistogram(label, values, count, offset, overlay, 0.f, max * 1.1f, ImVec2(width * 0.6f, 40.f));
+        };
+
+        const float last = frameTimes[(frame + HISTORY - 1) % HISTORY];
+        ImGui::Text("Frame %.2f ms", last);
+        plot("Frame", frameTimes.data(), " ms");
+
+        if (ImGui::CollapsingHeader("Phases", ImGuiTreeNodeFlags_DefaultOpen)) {
+            for (const auto& s : series) {
+                if (s.kind == Kind::Phase)
+                    plot(s.name, s.values.data(), " ms");
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Counters", ImGuiTreeNodeFlags_DefaultOpen)) {
+            for (const auto& s : series) {
+                if (s.kind == Kind::Phase)
+                    continue;
+
+                const float value = s.values[(frame + HISTORY - 1) % HISTORY];
+                if (s.kind == Kind::Events)
+                    ImGui::Text("%s: %.0f last frame, %.0f/s", s.name, value, this->PerSecond(s));
+                else
+                    ImGui::Text("%s: %.0f", s.name, value);
+                plot(s.name, s.values.data(), "");
+            }
+        }
+
+        ImGui::InputText("Trace file", &tracePath);
+        if (!this->IsTracing()) {
+            if (ImGui::Button("Start trace"))
+                this->StartTrace(tracePath);
+        }
+        else if (ImGui::Button("Stop trace"))
+            this->StopTrace();
+    }
+
+    std::size_t Profiler::Find(const char *name, Kind kind) {
+        // A handful of series, a linear search beats hashing the name
+        for (std::size_t i = 0; i < series.size(); i++) {
+            if (series[i].name == name || std::strcmp(series[i].name, name) == 0)
+                return i;
+        }
+
+        series.push_back({ name, kind });
+        return series.size() - 1;
+    }
+
+    double Profiler::Microseconds(Clock::time_point time) const {
+        return std::chrono::duration<double, std::micro>(time - created).count();
+    }
+
+    double Profiler::PerSecond(const Series &s) const {
+        const std::size_t newest = (frame + HISTORY - 1) % HISTORY;
+        const double now = frameStarts[newest];
+
+        double sum = 0.0, oldest = now;
+        for (std::size_t i = 0; i < frames; i++) {
+            const std::size_t slot = (newest + HISTORY - i) % HISTORY;
+            if (now - frameStarts[slot] > 1.0)
+                break;
+            sum += s.values[slot];
+            oldest = frameStarts[slot];
+        }
+
+        // Frames only come when something happens, a quiet second may hold a single frame
+        return sum / std::max(now - oldest, 1.0);
+    }
+
+    void Profiler::TraceEvent(const char *name, Clock::time_point start, Clock::time_point end) {
+        trace << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"ts\":" << this->Microseconds(start)
+              << ",\"dur\":" << std::chrono::duration<double, std::micro>(end - start).count()
+              << ",\"pid\":1,\"tid\":1}";
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Core::Networking {
+    // Process wide pool of I/O buffers, shared by all connections.
+    // Sizes are rounded up to a power of two size class, starting at BUFFER_MIN_SIZE.
+    // Freed buffers wait for reuse up to POOL_RETAINED_BYTES per class, the rest is freed.
+    class BufferPool {
+    public:
+        static BufferPool& Instance();
+
+        std::unique_ptr<char[]> Acquire(std::size_t size, std::size_t& capacity);
+        void Release(std::unique_ptr<char[]> buffer, std::size_t capacity);
+
+        // Largest package accepted on the wire, FRAME_MAX_SIZE by default.
+        // Bigger ones fail with error::message_size.
+        static void SetMaxFrameSize(std::size_t size);
+        static std::size_t MaxFrameSize();
+
+        std::size_t GetRetainedBytes() const;
+
+    private:
+        BufferPool() = default;
+
+        static std::size_t ClassOf(std::size_t size);
+
+        struct SizeClass {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<char[]>> free;
+        };
+
+        std::array<SizeClass, 32> classes;
+        std::atomic<std::size_t> retainedBytes{0};
+    };
+
+    // Buffer borrowed from the pool, given back when destroyed
+    class PooledBuffer {
+    public:
+        PooledBuffer() = default;
+        explicit PooledBuffer(std::size_t size);
+        ~PooledBuffer();
+
+        PooledBuffer(PooledBuffer&& other) noexcept;
+        PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+
+        char* data() { return buffer.get(); }
+        const char* data() const { return buffer.get(); }
+        std::size_t capacity() const { return bufferCapacity; }
+
+        // Bytes in use, for buffers that are sent
+        std::size_t size() const { return used; }
+        void SetSize(std::size_t size) { used = size; }
+
+        void Reset();
+
+    private:
+        std::unique_ptr<char[]> buffer;
+        std::size_t bufferCapacity = 0;
+        std::size_t used = 0;
+    };
+
+    // Bytes received but not parsed yet. Holds a pooled buffer only while it
+    // has some, so connections waiting for data cost no buffer memory.
+    class ReceiveBuffer {
+    public:
+        const char* data() const { return buffer.data() + begin; }
+        std::size_t size() const { return end - begin; }
+
+        // Makes room for at least 'size' more bytes, returns where they go.
+        // Free() tells how many fit there.
+        char* Prepare(std::size_t size);
+        std::size_t Free() const { return buffer.capacity() - end; }
+        void Commit(std::size_t size) { end += size; }
+
+        void Consume(std::size_t size);
+        void Clear();
+
+    private:
+        PooledBuffer buffer;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+}
+
+#endif //BUFFERPOOL_H
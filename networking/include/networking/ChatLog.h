@@ -0,0 +1,39 @@
+#ifndef CHATLOG_H
+#define CHATLOG_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Core::Networking {
+    // Last messages of a chat in a fixed amount of memory. Text of all messages lives in one
+    // ring of bytes allocated up front, a new message overwrites the oldest ones when it's full.
+    // Adding never allocates and a room that chats for weeks takes as much memory as on day one.
+    class ChatLog {
+    public:
+        ChatLog(std::size_t maxMessages, std::size_t maxBytes);
+
+        // Longer messages are cut to a quarter of the byte ring
+        void Add(std::string_view message);
+        void Clear();
+
+        std::size_t Size() const;
+        // 0 is the oldest message. Valid until the next Add.
+        std::string_view operator[](std::size_t i) const;
+
+    private:
+        struct Entry {
+            std::uint32_t offset;
+            std::uint32_t length;
+        };
+
+        void DropOldest();
+
+        std::vector<char> bytes;
+        std::vector<Entry> entries; // Ring of messages, oldest at 'first'
+        std::size_t first = 0, count = 0;
+        std::size_t head = 0; // Where the next message goes in 'bytes'
+    };
+}
+
+#endif //CHATLOG_H
@@ -0,0 +1,68 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Core::Networking {
+    enum class Codec : std::uint8_t {
+        None = 0,
+        LZ4,  // Live traffic: cheap enough to run on every package
+        Zstd  // Big packages like board snapshots: better ratio for more CPU
+    };
+
+    // Once compression is negotiated packages are no longer ';' terminated,
+    // every package goes in a frame instead:
+    //   u8  codec
+    //   u32 size of the package once decompressed
+    //   u32 size of the stored bytes that follow
+    // Integers are little endian.
+    constexpr std::size_t FRAME_HEADER_SIZE = 9;
+
+    struct FrameHeader {
+        Codec codec;
+        std::uint32_t rawSize;
+        std::uint32_t storedSize;
+    };
+
+    // Per connection compression state. Both codecs use the same built-in
+    // dictionary primed with the layout of board update packages, so even
+    // small stroke packages compress well.
+    class Compressor {
+    public:
+        Compressor();
+        ~Compressor();
+
+        Compressor(const Compressor&) = delete;
+        Compressor& operator=(const Compressor&) = delete;
+
+        // Codec names this build supports, sent during the handshake
+        static std::vector<std::string> SupportedCodecs();
+        static int DictionaryID();
+
+        // Enables the codecs both sides support. Returns the names of the enabled ones.
+        std::vector<std::string> Negotiate(const std::vector<std::string>& offered);
+        bool IsEnabled() const;
+
+        // Room a frame of a package of this size may need
+        static std::size_t PackBound(std::size_t size);
+        // Wraps a serialized package into a frame, picking a codec by its size.
+        // 'frame' must have PackBound() bytes. Returns the size of the frame.
+        std::size_t Pack(const std::string& package, char* frame);
+        // Same with the given codec whatever the size, e.g. to compare them. Stored as is if it's not enabled.
+        std::size_t Pack(const std::string& package, char* frame, Codec codec);
+
+        static FrameHeader ParseHeader(const char* data);
+        bool Unpack(const FrameHeader& header, const char* stored, std::string& package);
+
+    private:
+        bool lz4 = false;
+        bool zstd = false;
+
+        void* zstdCompression = nullptr;
+        void* zstdDecompression = nullptr;
+    };
+}
+
+#endif //COMPRESSION_H
@@ -0,0 +1,32 @@
+#ifndef DATAGRAM_H
+#define DATAGRAM_H
+
+#include <cstdint>
+#include <string>
+
+#include "TCPPackage.h"
+
+namespace Core::Networking {
+    // Loss tolerant traffic (cursors, previews of strokes being drawn) goes over UDP
+    // next to the TCP connection, so a lost segment doesn't hold it back.
+    // Datagram layout:
+    //   i32 connection ID issued at the handshake
+    //   u32 token issued at the handshake, proves the sender owns that connection
+    //   serialized package, no terminator
+    // Server fills the token with 0 when relaying. Integers are little endian.
+    constexpr std::size_t DATAGRAM_HEADER_SIZE = 8;
+
+    struct Datagram {
+        IDType connection;
+        std::uint32_t token;
+        std::string payload;
+    };
+
+    std::string PackDatagram(IDType connection, std::uint32_t token, const std::string& payload);
+    bool UnpackDatagram(const char* data, std::size_t size, Datagram& datagram);
+
+    // Package types allowed on the datagram channel
+    bool IsTransient(Package::Type type);
+}
+
+#endif //DATAGRAM_H
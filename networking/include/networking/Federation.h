@@ -0,0 +1,75 @@
+#ifndef FEDERATION_H
+#define FEDERATION_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TCPConnection.h"
+
+namespace Core::Networking {
+    // Several server processes sharing one deployment. Every node gets the same
+    // list of nodes, the owner of a room is picked by rendezvous hashing of its
+    // name over that list, so all nodes agree on it without talking to each other.
+    // Nodes also share a secret, a connection that wants to be linked as a node has to know it.
+    class Federation {
+    public:
+        // Nodes as "host:port,host:port,..." and our position in that list
+        bool Configure(const std::string& nodes, std::size_t self, const std::string& secret);
+        bool IsEnabled() const;
+
+        const std::string& Secret() const;
+        // Another node of ours opening a link, as far as its handshake tells
+        bool IsPeer(std::size_t node, const std::string& secret) const;
+
+        std::size_t Owner(const std::string& room) const;
+        bool Owns(const std::string& room) const;
+
+        std::size_t Self() const;
+        const std::string& Host(std::size_t node) const;
+        const std::string& Port(std::size_t node) const;
+        std::string Address(std::size_t node) const;
+
+    private:
+        struct Node {
+            std::string host;
+            std::string port;
+        };
+
+        std::vector<Node> nodes;
+        std::size_t self = 0;
+        std::string secret;
+    };
+
+    // Link between a node clients connected to and the owner of their room.
+    // Packages of all relayed clients share one connection and go out batched,
+    // as a single Relay package per flush:
+    //   {"frames": [[client, package], ...]}
+    // client is the ID of the client on the node that accepted it, a null
+    // package means the client left.
+    class RelayLink {
+    public:
+        explicit RelayLink(TCPConnection::pointer connection);
+
+        void Queue(IDType client, const Package& package);
+        void QueueLeave(IDType client);
+        void Flush();
+
+        const TCPConnection::pointer& GetConnection() const;
+
+        // Frames wait in the queue while the link is still being opened
+        void SetLinked(bool linked);
+        bool IsLinked() const;
+
+        // Owner side: ID the owner gave to each client relayed over this link
+        std::unordered_map<IDType, IDType> members;
+
+    private:
+        TCPConnection::pointer connection;
+        nlohmann::json frames = nlohmann::json::array();
+        bool linked = true;
+    };
+}
+
+#endif //FEDERATION_H
@@ -0,0 +1,54 @@
+#ifndef HANDOVER_H
+#define HANDOVER_H
+
+#include <boost/asio.hpp>
+
+#include <functional>
+#include <optional>
+#include <string>
+
+#include "nlohmann/json.hpp"
+
+namespace Core::Networking {
+    using namespace boost::asio;
+
+    // Restart without downtime: a new process of the server takes over from the running one.
+    // The running one waits on a Unix socket, the new one connects there before it binds anything.
+    // The running one stops reading from its clients, saves its rooms and sends over its listening
+    // sockets along with its sessions, see TCPServer::Export. Then it flushes what's queued for its
+    // clients and exits, they reconnect to the new process and resume their sessions there.
+    //
+    // On the socket: the size of the state in 8 bytes of host order, carrying both socket handles,
+    // then the state as JSON. A server that can't hand over closes without a word.
+    // Unix only, elsewhere there's never anyone to take over from.
+    class Handover {
+    public:
+        struct Inherited {
+            int acceptor = -1; // Native handles, bound to the port already
+            int datagrams = -1;
+            nlohmann::json state;
+        };
+
+        explicit Handover(io_context& context);
+        ~Handover();
+
+        // New process: what the server waiting at 'path' handed over. Nothing if there is none or it refused.
+        static std::optional<Inherited> Request(const std::string& path);
+
+        // Running process: waits at 'path' for a new one and calls 'requested' once it asks
+        bool Listen(const std::string& path, std::function<void()> requested);
+        // Answers the new process. False if it's gone.
+        bool Send(int acceptor, int datagrams, const nlohmann::json& state);
+        // Stops waiting and frees the path for the next server
+        void Close();
+
+    private:
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        local::stream_protocol::acceptor listener;
+        std::optional<local::stream_protocol::socket> successor;
+#endif
+        std::string path;
+    };
+}
+
+#endif //HANDOVER_H
@@ -0,0 +1,40 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace Core::Networking {
+    // Microseconds of the monotonic clock, what timestamps in package headers count in
+    std::uint64_t MonotonicMicroseconds();
+
+    // Distribution of latencies in microseconds. Every power of two is split into four buckets,
+    // so a percentile is off by a quarter at most, and the whole range takes a fixed array.
+    // Recording is lock free and may happen on another thread than reading.
+    class LatencyHistogram {
+    public:
+        void Record(std::uint64_t microseconds);
+
+        std::uint64_t Count() const;
+        std::uint64_t Max() const;
+        double Mean() const;
+        // Upper end of the bucket the percentile (0..1) falls into, 0 without samples
+        std::uint64_t Percentile(double p) const;
+
+        // Count and percentiles in milliseconds, for logs and the debug window
+        std::string Summary() const;
+
+    private:
+        static constexpr std::size_t BUCKETS = 144; // Up to 2^37 µs, about a day
+
+        static std::size_t BucketOf(std::uint64_t microseconds);
+        static std::uint64_t UpperBound(std::size_t bucket);
+
+        std::array<std::atomic<std::uint64_t>, BUCKETS> buckets{};
+        std::atomic<std::uint64_t> count{0}, sum{0}, max{0};
+    };
+}
+
+#endif //LATENCYHISTOGRAM_H
@@ -0,0 +1,41 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <array>
+#include <chrono>
+
+#include "TCPPackage.h"
+
+namespace Core::Networking {
+    // Token buckets of one connection, one per package type. A bucket holds up to a burst
+    // of packages and refills at a steady rate, both from settings.
+    class RateLimiter {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Limit {
+            double rate; // Packages per second
+            double burst;
+        };
+
+        static Limit LimitOf(Package::Type type);
+
+        // Takes a token, false if there was none. With 'borrow' the token is taken anyway
+        // and the bucket goes into debt, Wait says how long until it's paid back.
+        bool Take(Package::Type type, bool borrow = false, Clock::time_point now = Clock::now());
+        Clock::duration Wait(Package::Type type, Clock::time_point now = Clock::now()) const;
+
+    private:
+        struct Bucket {
+            double tokens = 0.0;
+            Clock::time_point updated{};
+            bool started = false;
+        };
+
+        static double TokensAt(const Bucket& bucket, Limit limit, Clock::time_point now);
+
+        std::array<Bucket, Package::TYPE_COUNT> buckets{};
+    };
+}
+
+#endif //RATELIMITER_H
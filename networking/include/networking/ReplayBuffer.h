@@ -0,0 +1,38 @@
+#ifndef REPLAYBUFFER_H
+#define REPLAYBUFFER_H
+
+#include <deque>
+#include <vector>
+
+#include "TCPPackage.h"
+
+namespace Core::Networking {
+    // Last board packages of a room, numbered in the order the server took them.
+    // Every package goes out with its number in "seq", so a client that lost its
+    // connection can say what it got last and catch up from here instead of
+    // downloading the whole board again.
+    class ReplayBuffer {
+    public:
+        explicit ReplayBuffer(std::size_t capacity);
+
+        // Numbers the package, keeps it and returns it the way it goes out
+        const Package& Push(const Package& package);
+        // Number of the last package, 0 if there was none
+        std::uint64_t Last() const;
+
+        // Packages after 'sequence' that 'except' didn't send itself.
+        // False if some of them are gone already.
+        bool Since(std::uint64_t sequence, IDType except, std::vector<Package>& out) const;
+
+        // Numbering and packages, for another process to go on from here, see Handover.h
+        nlohmann::json Export() const;
+        void Import(const nlohmann::json& state);
+
+    private:
+        std::size_t capacity;
+        std::deque<Package> packages; // Oldest first, the last one is numbered 'last'
+        std::uint64_t last = 0;
+    };
+}
+
+#endif //REPLAYBUFFER_H
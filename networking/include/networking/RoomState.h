@@ -0,0 +1,46 @@
+#ifndef ROOMSTATE_H
+#define ROOMSTATE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TCPPackage.h"
+
+namespace Core::Networking {
+    // State the server keeps for the rooms it owns, like the board.
+    // The server only routes packages, whatever understands them plugs in here.
+    // Called from the server's thread only.
+    class RoomState {
+    public:
+        virtual ~RoomState() = default;
+
+        // Package a member of the room sent, before it goes out to the others.
+        // False if it's malformed or breaks the rules, the server drops it then.
+        // Members that reported a view get it only if they are in 'audience', the rest of the room always does.
+        virtual bool Apply(const std::string& room, const Package& package, std::vector<IDType>& audience) = 0;
+
+        // Viewport package of a member, where on the board it looks
+        virtual void View(const std::string& room, IDType member, const nlohmann::json& view) = 0;
+        // Member is gone for good
+        virtual void Leave(const std::string& room, IDType member) = 0;
+        // Packages waiting to go to members, e.g. about changes where they don't look. Called on every presence tick.
+        virtual void Notices(std::vector<std::pair<IDType, Package>>& out) = 0;
+
+        // Adds what a newcomer needs to know to the handshake response
+        virtual void Describe(const std::string& room, IDType client, nlohmann::json& response) = 0;
+
+        // Packages that bring a newcomer up to date, sent right after the handshake
+        virtual std::vector<Package> Snapshot(const std::string& room) = 0;
+
+        // Packages with the strokes of the tiles a TileRequest asks for, except
+        // those the client already has from the tiles it lists as resident
+        virtual std::vector<Package> Page(const std::string& room, IDType member, const nlohmann::json& request) = 0;
+
+        // Saves whatever it keeps before returning, for another process to go on with, see Handover.h.
+        // Nothing is applied anymore once it's called.
+        virtual void Persist() = 0;
+    };
+}
+
+#endif //ROOMSTATE_H
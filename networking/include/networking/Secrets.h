@@ -0,0 +1,15 @@
+#ifndef SECRETS_H
+#define SECRETS_H
+
+#include <cstdint>
+
+namespace Core::Networking {
+    // Tokens that prove a client owns a session or a connection. Drawn from the system's CSPRNG,
+    // seeing any number of them tells nothing about the next one.
+    std::uint64_t RandomSecret();
+
+    // Takes as long whatever the difference, so timing a guess doesn't tell how much of it was right
+    bool SecretsEqual(std::uint64_t a, std::uint64_t b);
+}
+
+#endif //SECRETS_H
@@ -0,0 +1,45 @@
+#ifndef SERVERCONFIG_H
+#define SERVERCONFIG_H
+
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "utils/settings.h"
+
+namespace Core::Networking {
+    // Runtime settings of the server: a JSON file with the command line on top of it, both use
+    // the same names ("max-frame" in the file is --max-frame on the command line). Anything left
+    // out keeps its default from settings.h. The server reads the file again on SIGHUP, settings
+    // below 'Reloadable' change right away, the others only with a restart.
+    struct ServerConfig {
+        int port = 1499;
+        std::size_t workers = 0; // Threads writing board snapshots, 0 writes them on the server's own
+        std::string snapshots; // Directory boards are kept in between restarts, none by default
+        std::string record; // Capture file of the session for the replay tool
+        std::string nodes; // host:port,... of a federation and our index in it, see Federation.h
+        std::size_t node = 0;
+        std::string secret; // Shared by the nodes, a link from anyone else is refused
+        std::string handover; // Unix socket a new process of the server takes over at, see Handover.h. Needs snapshots.
+
+        // Reloadable
+        bool compression = true; // Newly connected clients may negotiate compressed transport
+        std::size_t maxFrame = Settings::FRAME_MAX_SIZE; // See BufferPool
+        int tick = Settings::PRESENCE_TICK_MS; // Milliseconds between cursor broadcasts, dirty tiles and pings
+        std::size_t queueHigh = Settings::QUEUE_HIGH_PACKAGES; // See TCPConnection::SetQueueWatermarks
+        std::size_t queueLow = Settings::QUEUE_LOW_PACKAGES;
+
+        // Every '--<setting> <value>' pair into 'values', '--config <path>' into 'path'.
+        // Reports anything else and returns false.
+        static bool FromArguments(int argc, char** argv, nlohmann::json& values, std::string& path);
+
+        // Settings of the file at 'path' (none if it's empty) and 'overrides' over those.
+        // Reports unknown settings and bad values and returns false, leaving this half set then.
+        bool Load(const std::string& path, const nlohmann::json& overrides);
+
+        // Names of the settings that differ from 'running' and need a restart to change
+        std::vector<std::string> RestartNeeded(const ServerConfig& running) const;
+    };
+}
+
+#endif //SERVERCONFIG_H
@@ -0,0 +1,59 @@
+#ifndef SESSIONCAPTURE_H
+#define SESSIONCAPTURE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "TCPPackage.h"
+
+namespace Core::Networking {
+    // Binary capture of the traffic a server received.
+    // File starts with the "DRCP" magic and a version, followed by records:
+    //   u64 microseconds since capture start
+    //   i32 connection ID
+    //   u8  event
+    //   u32 payload size, then the payload (package as it was sent, without ';')
+    // All integers are little endian.
+    struct CaptureRecord {
+        enum class Event : std::uint8_t {
+            Package = 0,
+            Disconnect
+        };
+
+        std::uint64_t timestamp; // Microseconds since the capture started
+        IDType connection;
+        Event event;
+        std::string payload;
+    };
+
+    class SessionRecorder {
+    public:
+        SessionRecorder() = default;
+        ~SessionRecorder();
+
+        bool Open(const std::string& path);
+        bool IsOpen() const;
+
+        void Record(IDType connection, CaptureRecord::Event event, const std::string& payload = {});
+
+    private:
+        std::ofstream file;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::microseconds lastFlush{};
+    };
+
+    class SessionReader {
+    public:
+        bool Open(const std::string& path);
+
+        // Reads the next record. Returns false at the end of the capture or on a broken record.
+        bool Next(CaptureRecord& record);
+
+    private:
+        std::ifstream file;
+    };
+}
+
+#endif //SESSIONCAPTURE_H
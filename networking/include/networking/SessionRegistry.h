@@ -0,0 +1,64 @@
+#ifndef SESSIONREGISTRY_H
+#define SESSIONREGISTRY_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "TCPConnection.h"
+
+namespace Core::Networking {
+    // Connection IDs and the set of connections that finished their handshake.
+    //
+    // An ID is a slot in its low bits and the slot's generation above them.
+    // Freed slots are reused with the next generation, so an ID is never
+    // issued twice while its generation doesn't wrap, and strokes of a user
+    // that left can't be mistaken for strokes of the one that got its slot.
+    //
+    // Readers take the current snapshot and iterate it without locking,
+    // joins and leaves build a new snapshot and swap it in.
+    class SessionRegistry {
+    public:
+        struct Snapshot {
+            std::vector<TCPConnection::pointer> sessions;
+            std::unordered_map<IDType, TCPConnection::pointer> byID;
+        };
+
+        SessionRegistry();
+
+        // Nothing once every slot is taken, the connection has to be refused
+        std::optional<IDType> Allocate();
+        // Returns the ID for reuse. Done by Unregister for registered connections.
+        void Release(IDType id);
+
+        void Register(const TCPConnection::pointer& connection);
+        // Returns false if the connection wasn't registered. Without 'release'
+        // the ID stays taken, e.g. for the session to be resumed under it.
+        bool Unregister(IDType id, bool release = true);
+
+        std::shared_ptr<const Snapshot> Sessions() const;
+        TCPConnection::pointer Find(IDType id) const;
+
+        // Slots in use and their generations, for another process to go on issuing IDs, see Handover.h.
+        // Import before the first Allocate.
+        nlohmann::json Export();
+        void Import(const nlohmann::json& state);
+
+    private:
+        static constexpr IDType SLOT_MASK = (1 << Settings::SESSION_SLOT_BITS) - 1;
+        static constexpr IDType GENERATION_MASK = (1 << (31 - Settings::SESSION_SLOT_BITS)) - 1;
+
+        std::atomic<IDType> nextSlot{1}; // Slot 0 would give the server's ID
+        std::mutex freeSlotsMutex;
+        std::vector<IDType> freeSlots;
+        std::vector<IDType> generations;
+
+        std::mutex writeMutex;
+        std::atomic<std::shared_ptr<const Snapshot>> snapshot;
+    };
+}
+
+#endif //SESSIONREGISTRY_H
@@ -3,13 +3,20 @@
 
 #include <boost/asio.hpp>
 
+#include <array>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+
 #include "TCPCommunicative.hpp"
+#include "LatencyHistogram.h"
 #include "utils/settings.h"
 
 namespace Core::Networking {
     using namespace boost::asio;
 
     typedef std::function<void(const Package&)> PackageReceivedCallback;
+    typedef std::function<void(bool resumed)> ReconnectCallback;
 
     class TCPClient : public TCPCommunicative {
     public:
@@ -19,26 +26,111 @@ namespace Core::Networking {
         boost::system::error_code ConnectTo(const std::string& address, const std::string& port);
         bool Handshake(bool loadTheCanvas = false);
 
+        // Stamps the package with our sequence number and the time, see Package::Header
+        bool SendPackage(const Package& package) override;
+
         void StartReading();
         void Stop();
 
         bool IsConnected() const;
+        // Lost the connection and trying to get it back, see Send
+        bool IsReconnecting() const;
 
         void SetUsername(const std::string& username);
+        void SetRoom(const std::string& room);
+        // Offer compressed transport during the handshake. On by default.
+        void SetCompression(bool enabled);
 
         std::size_t GetID() const;
+        // Strokes of the room may carry our ID from an earlier session, numbering ours starts after them
+        std::uint32_t GetFirstSequence() const;
+
+        // Sends a package over TCP. Safe to call from any thread. The last ones are kept, so whatever
+        // didn't reach the server before the connection dropped goes out again once it's back.
+        void Send(const Package& package);
+
+        // Sends a transient package (see IsTransient) as a datagram. Lost ones are not resent.
+        // Safe to call from any thread. Returns false if the server didn't open the datagram channel.
+        bool SendDatagram(const Package& package);
+
+        // Round trips of our pings and how long board packages of others took from their sender to us,
+        // in microseconds. The latter needs the server's clock, known after the first ping.
+        const LatencyHistogram& GetRoundTrip() const;
+        const LatencyHistogram& GetStrokeLatency() const;
+        // Previews of others that never arrived, from gaps in their sequence numbers
+        std::uint64_t GetDatagramsLost() const;
 
         PackageReceivedCallback pkgRecCallback;
+        // Called on the reading thread when the connection drops and when it's back. The session
+        // is 'resumed' if the server only sent what we missed; otherwise it started a new one,
+        // with a new ID, and the board has to be fetched again.
+        std::function<void()> connectionLostCallback;
+        ReconnectCallback reconnectCallback;
 
     private:
-        void OnPackageReceived(const boost::system::error_code& ec, std::size_t bytesTransferred);
+        void ReadNext();
+        void OnPackageReceived(const boost::system::error_code& ec, std::optional<Package> package);
+
+        // Reconnects to the same node with a growing delay until it works
+        void Reconnect();
+        void OnReconnected(const boost::system::error_code& ec);
+        // After a resumed handshake: sends what the server didn't get
+        void Resend(std::uint64_t received);
+
+        void Stamp(Package& package);
+        // Our estimate of the server's monotonic clock, 0 until the first pong
+        std::uint64_t ServerTime() const;
+        void StartPing();
+        void OnPing(const Package& ping);
+        void OnPong(const Package& pong);
+
+        void OpenDatagramChannel(std::uint32_t token);
+        void ReceiveDatagram();
+        void OnDatagramReceived(const boost::system::error_code& ec, std::size_t size);
 
         io_context context{};
         tcp::endpoint endpoint;
 
-        bool connected = false;
+        std::atomic<bool> connected = false;
+        std::atomic<bool> reconnecting = false;
         std::string username;
+        std::string room = Settings::DEFAULT_ROOM;
+        int redirects = 0;
         IDType id{};
+        std::uint32_t firstSequence{};
+        bool compression = true;
+        bool loadCanvas = false; // Asked for with the first handshake, again when a session can't be resumed
+
+        // Session the server issued, sent back with the next handshake to resume it.
+        // Room sequence is the number of the last board package we got, see ReplayBuffer.
+        std::uint64_t session{};
+        std::uint64_t roomSequence{};
+        bool resumed = false;
+        std::deque<Package> sent; // Last packages sent over TCP, for Resend
+        std::uint64_t sentBefore = 0; // Packages sent before the first one in 'sent'
+        steady_timer reconnectTimer{context};
+        std::chrono::milliseconds reconnectDelay{Settings::RECONNECT_MIN_MS};
+
+        std::array<std::atomic<std::uint32_t>, Package::TYPE_COUNT> sequences{}; // Last one sent, by type
+        steady_timer pingTimer{context};
+        // Offset of the server's clock from ours, taken from the ping with the shortest
+        // round trip of the last few: the less time on the wire, the less it can be off.
+        struct ClockSample {
+            std::uint64_t roundTrip;
+            std::int64_t offset;
+        };
+        std::deque<ClockSample> clockSamples;
+        std::atomic<std::int64_t> clockOffset{0};
+        std::atomic<bool> clockKnown = false;
+        LatencyHistogram roundTrip, strokeLatency;
+        std::unordered_map<IDType, std::uint32_t> lastPreview; // Sequence number of the last preview, by sender
+        std::atomic<std::uint64_t> datagramsLost{0};
+
+        ip::udp::socket datagramSocket{context};
+        std::uint32_t datagramToken{};
+        bool datagrams = false;
+        bool receivingDatagrams = false;
+        std::array<char, Settings::DATAGRAM_MAX_SIZE> datagramBuffer{};
     };
 }
 
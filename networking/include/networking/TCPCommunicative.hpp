@@ -1,7 +1,13 @@
 #ifndef TCPCOMMUNICATIVE_HPP
 #define TCPCOMMUNICATIVE_HPP
 
+#include <cstring>
+#include <memory>
+#include <optional>
+
 #include "TCPPackage.h"
+#include "Compression.h"
+#include "BufferPool.h"
 #include "utils/log.h"
 #include "utils/settings.h"
 
@@ -10,6 +16,7 @@ namespace Core::Networking {
     using ip::tcp;
 
     typedef std::function<void(boost::system::error_code, std::size_t)> AsyncCallback;
+    typedef std::function<void(const boost::system::error_code&, std::optional<Package>)> ReadCallback;
 
     // Base class that implements basic sockets' communication.
     // Note that you should connect the socket yourself in a class
@@ -22,7 +29,7 @@ namespace Core::Networking {
         virtual bool SendPackage(const Package &package) {
             // Sending header with size of the body and package type.
             // Type is necessary for the server to parse the package correctly.
-            auto e = this->SendString(Package::CompressToJSON(package).dump() + ";");
+            auto e = this->SendBuffer(this->Serialize(package));
 
             if (e) return false;
             return true;
@@ -32,30 +39,190 @@ namespace Core::Networking {
         void AsyncSendPackage(
             const Package &package,
             const AsyncCallback& callback = [](boost::system::error_code ec, std::size_t bytes_transferred) {}
-        ) const {
-            LOG_LINE(Package::CompressToJSON(package).dump() + ";");
-            this->AsyncSendString(Package::CompressToJSON(package).dump() + ";", callback);
+        ) {
+            this->AsyncSendBuffer(this->Serialize(package), callback);
+        }
+
+        // Switches to compressed frames with the codecs both sides support.
+        // Call it once the handshake is over, handshake itself is never compressed.
+        std::vector<std::string> EnableCompression(const std::vector<std::string>& offered) {
+            return compressor.Negotiate(offered);
         }
 
     protected:
-        boost::system::error_code SendString(const std::string &message) const {
+        // Package as it goes on the wire, in a buffer from the pool
+        PooledBuffer Serialize(const Package &package) {
+            std::string serialized = Package::CompressToJSON(package).dump();
+
+            if (compressor.IsEnabled()) {
+                PooledBuffer frame(Compressor::PackBound(serialized.size()));
+                frame.SetSize(compressor.Pack(serialized, frame.data()));
+                return frame;
+            }
+
+            PooledBuffer text(serialized.size() + 1);
+            std::memcpy(text.data(), serialized.data(), serialized.size());
+            text.data()[serialized.size()] = ';';
+            text.SetSize(serialized.size() + 1);
+            return text;
+        }
+
+        // Reads one package: ';' terminated one, or a frame once compression is on.
+        void AsyncReadPackage(const ReadCallback& callback) {
             boost::system::error_code ec;
-            write(*socket, buffer(message), ec);
-            return ec;
+            auto package = this->ExtractPackage(ec);
+            if (package || ec) {
+                // Delivered through the executor, so a burst of buffered packages doesn't recurse
+                post(socket->get_executor(), [callback, ec, package = std::move(package)]() mutable {
+                    callback(ec, std::move(package));
+                });
+                return;
+            }
+
+            // Waiting doesn't hold a buffer, one is taken from the pool once there is data
+            socket->async_wait(
+                tcp::socket::wait_read,
+                [this, callback](boost::system::error_code ec) {
+                    if (ec) {
+                        callback(ec, std::nullopt);
+                        return;
+                    }
+
+                    std::size_t available = socket->available(ec);
+                    char* space = receiveBuffer.Prepare(std::max<std::size_t>(available, Settings::BUFFER_MIN_SIZE));
+                    socket->async_read_some(
+                        buffer(space, receiveBuffer.Free()),
+                        [this, callback](boost::system::error_code ec, std::size_t bytesTransferred) {
+                            receiveBuffer.Commit(bytesTransferred);
+                            if (ec) callback(ec, std::nullopt);
+                            else this->AsyncReadPackage(callback);
+                        }
+                    );
+                }
+            );
+        }
+
+        // Blocking version of AsyncReadPackage
+        std::optional<Package> ReadPackage(boost::system::error_code& ec) {
+            while (true) {
+                auto package = this->ExtractPackage(ec);
+                if (package || ec)
+                    return package;
+
+                char* space = receiveBuffer.Prepare(Settings::BUFFER_MIN_SIZE);
+                std::size_t bytesTransferred = socket->read_some(buffer(space, receiveBuffer.Free()), ec);
+                if (ec)
+                    return std::nullopt;
+                receiveBuffer.Commit(bytesTransferred);
+            }
+        }
+
+        // Drops whatever was received and not read yet
+        void DiscardReceived() {
+            receiveBuffer.Clear();
+            scanned = 0;
         }
 
-        boost::system::error_code ReadStringUntil(char delimiter) {
+        boost::system::error_code SendBuffer(const PooledBuffer &message) const {
             boost::system::error_code ec;
-            read_until(*socket, streamBuffer, delimiter, ec);
+            write(*socket, buffer(message.data(), message.size()), ec);
             return ec;
         }
 
-        void AsyncSendString(const std::string &message, const AsyncCallback& callback) const {
-            async_write(*socket, buffer(message), callback);
+        void AsyncSendBuffer(PooledBuffer message, const AsyncCallback& callback) const {
+            // The buffer has to outlive the write, it goes back to the pool after
+            auto data = std::make_shared<PooledBuffer>(std::move(message));
+            async_write(
+                *socket, buffer(data->data(), data->size()),
+                [data, callback](boost::system::error_code ec, std::size_t bytesTransferred) {
+                    callback(ec, bytesTransferred);
+                }
+            );
         }
 
-        streambuf streamBuffer { Settings::MESSAGE_MAX_SIZE };
+        // Several messages with one gathered write
+        void AsyncSendBuffers(std::vector<PooledBuffer> messages, const AsyncCallback& callback) const {
+            auto data = std::make_shared<std::vector<PooledBuffer>>(std::move(messages));
+            std::vector<const_buffer> buffers;
+            buffers.reserve(data->size());
+            for (const auto& message : *data)
+                buffers.emplace_back(message.data(), message.size());
+
+            async_write(
+                *socket, buffers,
+                [data, callback](boost::system::error_code ec, std::size_t bytesTransferred) {
+                    callback(ec, bytesTransferred);
+                }
+            );
+        }
+
+        ReceiveBuffer receiveBuffer;
         tcp::socket* socket{};
+
+    private:
+        // Takes one whole package out of the receive buffer, if it's there
+        std::optional<Package> ExtractPackage(boost::system::error_code& ec) {
+            if (compressor.IsEnabled())
+                return this->ExtractFrame(ec);
+
+            // Bytes before 'scanned' were searched already
+            const char* data = receiveBuffer.data();
+            const void* end = receiveBuffer.size() > scanned
+                ? std::memchr(data + scanned, ';', receiveBuffer.size() - scanned)
+                : nullptr;
+            if (!end) {
+                scanned = receiveBuffer.size();
+                if (scanned > BufferPool::MaxFrameSize())
+                    ec = error::message_size;
+                return std::nullopt;
+            }
+
+            const std::size_t size = static_cast<const char*>(end) - data;
+            const std::string text(data, size);
+            receiveBuffer.Consume(size + 1);
+            scanned = 0;
+            return Decode(text, ec);
+        }
+
+        std::optional<Package> ExtractFrame(boost::system::error_code& ec) {
+            if (receiveBuffer.size() < FRAME_HEADER_SIZE)
+                return std::nullopt;
+
+            const FrameHeader header = Compressor::ParseHeader(receiveBuffer.data());
+            if (header.storedSize > BufferPool::MaxFrameSize()) {
+                ec = error::message_size;
+                return std::nullopt;
+            }
+
+            const std::size_t needed = FRAME_HEADER_SIZE + header.storedSize;
+            if (receiveBuffer.size() < needed)
+                return std::nullopt;
+
+            std::string package;
+            const bool unpacked = compressor.Unpack(header, receiveBuffer.data() + FRAME_HEADER_SIZE, package);
+            receiveBuffer.Consume(needed);
+
+            if (!unpacked) {
+                ec = error::invalid_argument;
+                return std::nullopt;
+            }
+            return Decode(package, ec);
+        }
+
+        // Text that isn't JSON or lacks a header field is an error of the connection like a broken frame,
+        // the peer sent it and nothing after it can be trusted
+        static std::optional<Package> Decode(const std::string& text, boost::system::error_code& ec) {
+            try {
+                return Package::Parse(text);
+            }
+            catch (const nlohmann::json::exception&) {
+                ec = error::invalid_argument;
+                return std::nullopt;
+            }
+        }
+
+        Compressor compressor;
+        std::size_t scanned = 0;
     };
 }
 
@@ -4,19 +4,16 @@
 #include <boost/asio.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
+#include <deque>
+
 #include "TCPCommunicative.hpp"
+#include "RateLimiter.h"
 #include "utils/settings.h"
 
 namespace Core::Networking {
     using namespace boost::asio;
     using ip::tcp;
 
-    // Starting from 1, because 0 is server's ID.
-    inline size_t GetNextConnectionID() {
-        static size_t id = 1;
-        return id++;
-    }
-
     typedef std::function<void(const Package&)> PackageCallback;
     typedef std::function<void()> ErrorCallback;
 
@@ -33,32 +30,83 @@ namespace Core::Networking {
             return pointer(new TCPConnection(context));
         }
 
-        void SetID(std::size_t id);
+        void SetID(IDType id);
         void SetUsername(const std::string& username);
+        void SetRoom(const std::string& room);
+        void SetDatagramEndpoint(const ip::udp::endpoint& endpoint);
+        // Packages read so far, without pings and pongs. A resumed session counts on from where its last connection stopped.
+        void SetReceived(std::uint64_t received);
 
-        std::size_t GetID() const;
+        IDType GetID() const;
         const std::string& GetUsername() const;
+        const std::string& GetRoom() const;
+        std::uint32_t GetDatagramToken() const;
+        // Where the client's datagrams come from, unknown until the first one arrives
+        const std::optional<ip::udp::endpoint>& GetDatagramEndpoint() const;
+        std::uint64_t GetReceived() const;
+        // Packages of the type that went missing since the last one, from the client's sequence numbers
+        std::uint32_t Gap(Package::Type type, std::uint32_t sequence);
+        // The peer closed the connection itself rather than losing it
+        bool IsClosedByPeer() const;
+        // Closed because the peer sent something that isn't a package
+        bool IsMalformed() const;
 
         void Start(PackageCallback&& pckgCallback, ErrorCallback&& errorCallback);
 
         void Post(const Package &package);
+        // Sends a frame as it is, ahead of anything posted. Handshake responses go this way,
+        // packages posted meanwhile wait until it's out.
+        void Greet(const std::string& frame, std::function<void(const boost::system::error_code&)>&& sent);
+
+        RateLimiter& GetLimiter();
+        // Next package is read once the time is up, the client's socket backs up meanwhile
+        void PauseReading(RateLimiter::Clock::duration duration);
+
+        // Connections with 'high' packages waiting to be sent stop reading until they're down to 'low',
+        // so a peer that doesn't keep up can't have us queue ever more for it. Applies to all of them.
+        static void SetQueueWatermarks(std::size_t high, std::size_t low);
+
+        // Packages are still read but dropped from now on, uncounted, so the client sends them again
+        // wherever it resumes its session. Nothing is reported anymore, not even a lost connection.
+        void DropIncoming();
+        // Nothing is waiting to be sent
+        bool IsFlushed() const;
 
         tcp::socket& getSocket();
 
     private:
         void StartRead();
+        // Reads on unless the connection is paused or backed up
+        void ContinueReading();
         void StartWrite();
 
-        void HandleRead(const boost::system::error_code& ec, std::size_t bytesTransferred);
+        void HandleRead(const boost::system::error_code& ec, std::optional<Package> package);
         void HandleWrite(const boost::system::error_code& ec, std::size_t bytesTransferred);
 
-        std::stack<Package> pendingPackages;
+        std::deque<Package> pendingPackages;
+        std::size_t writing = 0; // Packages at the front of pendingPackages the current write sends
+        bool greeting = false;
 
         PackageCallback packageCallback;
         ErrorCallback errorCallback;
 
         IDType id{};
         std::string username = "unknown";
+        std::string room = Settings::DEFAULT_ROOM;
+
+        std::uint32_t datagramToken;
+        std::optional<ip::udp::endpoint> datagramEndpoint;
+
+        std::uint64_t received = 0;
+        bool closedByPeer = false;
+        bool malformed = false;
+        std::array<std::uint32_t, Package::TYPE_COUNT> lastSequence{}; // By type, for Gap
+
+        RateLimiter limiter;
+        steady_timer readTimer;
+        RateLimiter::Clock::time_point resumeReading{};
+        bool backedUp = false; // Over the high watermark, reading waits for the queue to drain
+        bool dropping = false;
 
     };
 }
@@ -1,6 +1,8 @@
 #ifndef TCPPACKAGE_H
 #define TCPPACKAGE_H
 
+#include <boost/asio.hpp>
+
 #include "nlohmann/json.hpp"
 
 namespace Core::Networking {
@@ -11,13 +13,29 @@ namespace Core::Networking {
         enum class Type {
             TextMessage = 0,
             BoardUpdate,
-            Handshake
+            Handshake,
+            BoardOperation,
+            CursorUpdate, // Transient, normally sent as a datagram
+            StrokePreview, // Transient, part of a stroke still being drawn
+            Relay, // Batch of packages of many clients between two servers, see Federation.h
+            Ping, // Answered with a Pong right away, "sent" is echoed back
+            Pong,
+            TileRequest, // Client asks for world tiles, see TilePager
+            TileLoaded, // Server is done sending the strokes of the tiles listed
+            Viewport, // Part of the board a client looks at, the server sends it only what changes there
+            TileDirty // Tiles that changed where the client doesn't look, fetched again once it does
         };
+        static constexpr std::size_t TYPE_COUNT = static_cast<std::size_t>(Type::TileDirty) + 1;
 
         struct Header {
             std::size_t bodySize;
             Type type;
             IDType senderID;
+            // Set by the sender and kept when the package is relayed, 0 if it didn't. Sequence counts
+            // the sender's packages, datagrams separately from TCP. Timestamp is when it was sent,
+            // in microseconds of the server's monotonic clock as far as the sender knows it.
+            std::uint32_t sequence = 0;
+            std::uint64_t timestamp = 0;
         };
 
         struct Body {
@@ -27,8 +45,15 @@ namespace Core::Networking {
         Package(Header header, Body body)
             : header(header), body(std::move(body)) { }
 
-        Header getHeader() const { return header; }
-        Body getBody() const { return body; }
+        const Header& getHeader() const { return header; }
+        const Body& getBody() const { return body; }
+
+        // Receivers put in who really sent the package, the header comes from the peer
+        void SetSenderID(IDType id) { header.senderID = id; }
+        void Stamp(std::uint32_t sequence, std::uint64_t timestamp) {
+            header.sequence = sequence;
+            header.timestamp = timestamp;
+        }
 
         static nlohmann::json CompressToJSON(const Package& package) {
             nlohmann::json compressed;
@@ -36,6 +61,10 @@ namespace Core::Networking {
             compressed["header"]["bodySize"] = package.header.bodySize;
             compressed["header"]["type"] = package.header.type;
             compressed["header"]["senderID"] = package.header.senderID;
+            if (package.header.sequence)
+                compressed["header"]["sequence"] = package.header.sequence;
+            if (package.header.timestamp)
+                compressed["header"]["timestamp"] = package.header.timestamp;
 
             compressed["body"]["data"] = package.body.data;
 
@@ -43,12 +72,18 @@ namespace Core::Networking {
         }
 
         static Package Parse(const std::string& buff) {
-            nlohmann::json receivedJSON = nlohmann::json::parse(buff);
+            return FromJSON(nlohmann::json::parse(buff));
+        }
+
+        static Package FromJSON(const nlohmann::json& receivedJSON) {
+            const auto& header = receivedJSON.at("header");
             return Package {
                 Header {
-                    receivedJSON.at("header").at("bodySize"),
-                    receivedJSON.at("header").at("type"),
-                    receivedJSON.at("header").at("senderID"),
+                    header.at("bodySize"),
+                    header.at("type"),
+                    header.at("senderID"),
+                    header.value("sequence", std::uint32_t{0}),
+                    header.value("timestamp", std::uint64_t{0})
                 },
                 Body {
                     receivedJSON.at("body").at("data")
@@ -3,33 +3,255 @@
 
 #include <boost/asio.hpp>
 
+#include <array>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "TCPConnection.h"
+#include "SessionCapture.h"
+#include "Federation.h"
+#include "SessionRegistry.h"
+#include "RoomState.h"
+#include "ChatLog.h"
+#include "ReplayBuffer.h"
+#include "LatencyHistogram.h"
+#include "ServerConfig.h"
+#include "Handover.h"
 
 namespace Core::Networking {
     using namespace boost::asio;
 
     class TCPServer {
     public:
-        explicit TCPServer(int port);
+        // Takes over the sockets and sessions of another process if 'inherited' came from one, see Handover.h
+        explicit TCPServer(int port, std::optional<Handover::Inherited> inherited = std::nullopt);
         ~TCPServer();
 
         void Run();
-        
+        void Stop();
+        // Stops taking clients and packages and saves the room state, then ends Run() once every client
+        // took what's still queued for it, or after DRAIN_TIMEOUT_MS. On SIGINT and SIGTERM, a second one stops right away.
+        void Drain();
+
+        // Lets a new process of the server take over once it asks at 'path', see Handover.h
+        bool AwaitSuccessor(const std::string& path);
+
+        // What Asio waits for sockets with, io_uring if built with DRAWING_ROOM_IO_URING
+        static const char* GetBackend();
+
         void StartAccept();
 
-        void BroadcastMessage(const std::string& message, IDType sender) const;
-        void BroadcastToEach(const Package& package) const;
-        void BroadcastToEachExcept(const Package& package, IDType except) const;
+        // Allow clients to negotiate compressed transport. On by default.
+        void SetCompression(bool enabled);
+
+        // Takes the reloadable settings of 'config', the rest is up to whoever starts the server
+        void Configure(const ServerConfig& config);
+        // Called on SIGHUP, e.g. to read the configuration again and Configure with it
+        void SetReloadCallback(std::function<void()> callback);
+
+        // Records every inbound package into a capture file, see SessionCapture.h
+        bool StartRecording(const std::string& path);
+
+        // Joins this server to a federation of nodes, see Federation.h.
+        // Clients of rooms owned by another node are redirected there,
+        // or relayed if they can't follow a redirect.
+        bool Federate(const std::string& nodes, std::size_t self, const std::string& secret);
+
+        // Keeps the state of owned rooms, e.g. their boards for newcomers. Not owned by the server.
+        void SetRoomState(RoomState* state);
+
+        // Broadcasts only reach users of the given room. Messages go to the room's chat history as well.
+        void BroadcastMessage(const std::string& message, IDType sender, const std::string& room);
+        void BroadcastToEach(const Package& package, const std::string& room) const;
+        void BroadcastToEachExcept(const Package& package, IDType except, const std::string& room) const;
+        // Members that reported where they look get the package only if they are in 'audience', see RoomState::Apply
+        void BroadcastToAudience(const Package& package, IDType except, const std::string& room, const std::vector<IDType>& audience) const;
+
+        // Packages refused since the start, by type. Unknown types and frames that
+        // aren't packages at all count as invalid of the last type.
+        struct Violations {
+            std::array<std::uint64_t, Package::TYPE_COUNT> invalid{}; // Malformed or against the rules
+            std::array<std::uint64_t, Package::TYPE_COUNT> dropped{}; // Over the rate limit
+            std::array<std::uint64_t, Package::TYPE_COUNT> deferred{}; // Over the rate limit, read later
+
+            std::uint64_t Total() const;
+        };
+        const Violations& GetViolations() const;
+
+        // Round trips of pings to clients and how long board packages took from their sender to us,
+        // in microseconds. Logged every LATENCY_LOG_MS as well.
+        const LatencyHistogram& GetRoundTrip() const;
+        const LatencyHistogram& GetStrokeLatency() const;
 
     private:
         void HandleAccept(TCPConnection::pointer& connection, const boost::system::error_code& ec);
+        // A new connection gets up to HANDSHAKE_TIMEOUT_MS to send its handshake, nobody waits for it meanwhile
+        struct HandshakeAttempt {
+            explicit HandshakeAttempt(io_context& context) : deadline(context) { }
+            steady_timer deadline;
+            std::string request;
+            bool read = false;
+        };
+        void ReadHandshake(const TCPConnection::pointer& connection);
+        void HandleHandshake(TCPConnection::pointer& connection, std::string handshakeBuff);
+        // Once the handshake response is out
+        void StartSession(const TCPConnection::pointer& connection, bool resumed);
+        void HandlePackage(IDType sender, const std::string& room, const Package& package);
+        void HandlePing(IDType sender, const Package& package);
+        // Strokes of the tiles asked for, from the room state, followed by a TileLoaded
+        void SendTiles(IDType sender, const std::string& room, const Package& request) const;
+        void SendNotices();
+        void LeaveRoomState(IDType id, const std::string& room);
+        void SendTo(IDType id, const Package& package) const;
+        void PingClients();
+        void LogLatency();
+        // Rate limit of the connection. Board packages over it are let through but pause reading
+        // from the connection, so the client backs off without losing strokes. Others are dropped.
+        bool Admit(TCPConnection& connection, const Package& package);
+        // Shape of what the broadcast path and the presence tick rely on. Board packages are checked by RoomState.
+        bool IsValid(const Package& package) const;
+        // Fields of a handshake request have the types the handshake reads them as
+        static bool IsValidHandshake(const nlohmann::json& request);
+        void LogViolations();
+
+        // Sessions outlive a lost connection for a while, the client gets the same ID back when it
+        // reconnects in time. It proves the session is its own with the secret it got along with the ID.
+        bool Resume(TCPConnection::pointer& connection, IDType id, std::uint64_t secret, std::uint64_t lastSequence, std::vector<Package>& missed);
+        void Suspend(const TCPConnection::pointer& connection);
+        void EndSession(IDType id);
+        void ExpireSessions();
+        ReplayBuffer& ReplayOf(const std::string& room);
+
+        // Datagram channel on the same port number, see Datagram.h
+        void StartReceiveDatagram();
+        void HandleDatagram(const boost::system::error_code& ec, std::size_t size);
+        void RelayDatagram(const Package& package, IDType sender, const std::string& room);
+
+        // Cursors are not relayed one by one, the latest position of each is kept
+        // and the whole room goes out once per tick. Bounded by the number of users
+        // no matter how often they send.
+        void UpdateCursor(IDType connection, const std::string& room, const Package& package);
+        void StartPresenceTick();
+        void BroadcastPresence();
+
+        // Federation. Entry side: clients connected here, their room lives on another node.
+        void Redirect(TCPConnection::pointer& connection, std::size_t node);
+        void RelayClient(TCPConnection::pointer& connection, std::size_t node, const Package& handshake);
+        // Opening a link to another node, it gets up to RELAY_LINK_TIMEOUT_MS
+        struct LinkAttempt {
+            explicit LinkAttempt(io_context& context) : resolver(context), deadline(context) { }
+            tcp::resolver resolver;
+            steady_timer deadline;
+            std::string request;
+            std::string response;
+        };
+        std::shared_ptr<RelayLink> LinkTo(std::size_t node);
+        void CompleteLink(std::size_t node, const std::shared_ptr<RelayLink>& link, std::string response);
+        void FailLink(std::size_t node, const std::shared_ptr<RelayLink>& link, const boost::system::error_code& ec);
+        void HandleRelayFromOwner(std::size_t node, const Package& package);
+        void DropOutgoingLink(std::size_t node);
+
+        // Owner side: rooms of this node, clients relayed by other nodes
+        void AcceptPeer(TCPConnection::pointer& connection, const nlohmann::json& request);
+        void HandleRelayFromPeer(const std::shared_ptr<RelayLink>& link, const Package& package);
+        void JoinRemoteMember(const std::shared_ptr<RelayLink>& link, IDType client, const Package& handshake);
+        void RemoveRemoteMember(IDType id);
+        void DropIncomingLink(const std::shared_ptr<RelayLink>& link);
+
+        void StartRelayFlush();
+
+        // Last messages of a room as TextMessage packages, oldest first
+        std::vector<Package> ChatHistory(const std::string& room) const;
+
+        // First half of draining: nothing comes in anymore and the room state is saved
+        void Quiesce();
+        // Second half: closes connections once they sent everything, see Drain
+        void Flush(std::chrono::steady_clock::time_point deadline);
+        // Sessions, replay buffers and chat histories for a process that takes over. Connections
+        // stay behind, the sessions are suspended there until their clients resume them.
+        nlohmann::json Export();
+        void Import(const nlohmann::json& state);
 
         int port;
         io_context IOContext;
         tcp::acceptor acceptor;
 
-        std::vector<TCPConnection::pointer> connections;
+        // Connections that finished the handshake and own a room here
+        SessionRegistry sessions;
+
+        ip::udp::socket datagramSocket;
+        ip::udp::endpoint datagramSender;
+        std::array<char, Settings::DATAGRAM_MAX_SIZE> datagramBuffer{};
+
+        struct Cursor {
+            float x, y;
+            bool changed; // Since the last tick
+            std::string room;
+        };
+        std::unordered_map<IDType, Cursor> cursors;
+        std::vector<std::pair<IDType, std::string>> cursorsLeft; // Disconnected since the last tick, with their room
+        steady_timer presenceTimer;
+        std::chrono::milliseconds tick{ Settings::PRESENCE_TICK_MS };
+        std::chrono::steady_clock::time_point lastPresenceRefresh{};
+
+        Federation federation;
+        steady_timer relayTimer;
+
+        // Ctrl+C and SIGTERM drain the server instead of ending the process
+        signal_set signals;
+        void StartSignalWait();
+        signal_set reloadSignals;
+        std::function<void()> reloadCallback;
+        void StartReloadWait();
+
+        struct RelayedClient {
+            TCPConnection::pointer connection;
+            std::size_t node;
+        };
+        std::unordered_map<IDType, RelayedClient> relayedClients;
+        std::unordered_map<std::size_t, std::shared_ptr<RelayLink>> outgoingLinks;
+
+        struct RemoteMember {
+            std::shared_ptr<RelayLink> link;
+            IDType client; // ID on the node that relays it
+            std::string username;
+            std::string room;
+            RateLimiter limiter; // The node relaying it limits it as well
+        };
+        // Limit of a relayed client. Its node can't be made to read slower for one client, so nothing over it gets through.
+        bool Admit(RemoteMember& member, const Package& package);
+        std::unordered_map<IDType, RemoteMember> remoteMembers;
+        std::vector<std::shared_ptr<RelayLink>> incomingLinks;
+
+        std::unordered_map<std::string, ChatLog> chatHistory; // By room, bounded in messages and bytes
+        std::unordered_map<std::string, ReplayBuffer> replays; // Board packages by room, for resumed sessions
+
+        struct Session {
+            std::uint64_t secret; // See Secrets.h
+            TCPConnection::pointer connection; // Latest one, closed while the session is suspended
+            std::optional<std::chrono::steady_clock::time_point> expires; // Set while suspended
+        };
+        std::unordered_map<IDType, Session> resumable; // Sessions of connections that finished the handshake here
+
+        LatencyHistogram roundTrip, strokeLatency;
+        std::uint64_t datagramsReceived = 0, datagramsLost = 0;
+        std::uint64_t latencyLogged = 0; // Samples at the last log
+        std::chrono::steady_clock::time_point lastPing{}, lastLatencyLog{};
+
+        Violations violations;
+        std::uint64_t violationsLogged = 0; // Total at the last log
+        std::chrono::steady_clock::time_point lastViolationsLog{};
+
+        SessionRecorder recorder;
+        RoomState* roomState = nullptr;
+        std::unordered_set<IDType> viewing; // Members that sent a Viewport, the room state routes board packages for them
+        bool compression = true;
 
+        Handover handover;
+        steady_timer drainTimer;
+        bool draining = false;
     };
 }
 
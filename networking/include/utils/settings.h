@@ -2,9 +2,87 @@
 #define SETTINGS_H
 
 namespace Core::Networking::Settings {
-    constexpr int MESSAGE_MAX_SIZE = 1024;
+    constexpr int BUFFER_MIN_SIZE = 1024; // Smallest pooled I/O buffer, also the least a read asks for
+    constexpr int FRAME_MAX_SIZE = 1 << 24; // Default limit for one package on the wire, see BufferPool
+    constexpr int POOL_RETAINED_BYTES = 8 << 20; // Free buffers the pool keeps per size class
+    constexpr int WRITE_BATCH_MAX = 64; // Queued packages a connection sends with one write
+    constexpr int QUEUE_HIGH_PACKAGES = 16384; // Server stops reading from a client this far behind on what it's sent
+    constexpr int QUEUE_LOW_PACKAGES = 4096; // and reads again once it caught up to this
     constexpr int POINTS_PER_PACKAGE = 20; // The most optimal number of points in one package
     constexpr int SERVER_ID = 0; // Default server ID
+    constexpr int SESSION_SLOT_BITS = 16; // Low bits of a connection ID, the rest is the generation of the slot
+    constexpr int SESSION_RESUME_MS = 60000; // How long the server keeps the session of a client that lost its connection
+    constexpr int HANDSHAKE_TIMEOUT_MS = 5000; // Longest a new connection may take to send its handshake
+    constexpr int REPLAY_BUFFER_PACKAGES = 8192; // Last board packages of a room a resumed session catches up from
+    constexpr int RESEND_BUFFER_PACKAGES = 4096; // Last packages a client keeps to send again after a reconnect
+    constexpr int RECONNECT_MIN_MS = 50; // First reconnect attempt, doubles after every failed one
+    constexpr int RECONNECT_MAX_MS = 5000;
+    constexpr int DRAIN_TIMEOUT_MS = 10000; // Longest a draining server waits for its clients to take what's queued for them
+
+    constexpr int STROKE_MAX_POINTS = 1 << 16; // Largest stroke the server takes
+    constexpr float STROKE_MAX_THICKNESS = 256.f;
+
+    constexpr int UNDO_HISTORY_SIZE = 128; // Local undo steps kept per client
+    constexpr int TOMBSTONE_MIN_AGE = 512; // Lamport ticks an erased stroke is kept before compaction
+    constexpr int TOMBSTONE_COMPACT_THRESHOLD = 64; // Tombstones accumulated before a compaction pass
+
+    constexpr float CANVAS_MIN_CELL_SIZE = 64.f; // Smallest cell of the spatial index in a saved board
+    constexpr int CANVAS_MAX_CELLS = 1 << 20;
+    constexpr int SNAPSHOT_EVERY_OPS = 256; // Board operations a room takes before the server saves it again
+
+    constexpr float TILE_SIZE = 2048.f; // Board units on a side of a world tile, see Tile.h
+    constexpr int TILE_MARGIN = 1; // Tiles around the view a client pages in ahead of panning there
+    constexpr int RESIDENT_TILES_MAX = 64; // Tiles a client holds, least recently seen ones go first
+    constexpr int TILE_REQUEST_MAX = 256; // Tiles a request may ask for, and may list as already resident
+    constexpr int TILE_INDEX_MAX_SPAN = 64; // Strokes over more tiles on a side are checked on every request instead
+    constexpr int VIEWPORT_INTERVAL_MS = 100; // Clients report their view at most this often, and only once it's over other tiles
+
+    constexpr float STROKE_TOLERANCE = 1.5f; // Screen pixels the drawn path may stray from a smooth stroke's chords
+    constexpr int STROKE_MAX_PATH = 256; // Raw positions between two control points, a longer straight run gets one more
+    constexpr float CURVE_TOLERANCE = 0.25f; // Screen pixels a rendered curve may stray from the true one
+    constexpr int CURVE_MAX_PIECES = 64; // Segments a span between two control points is drawn with at most
+
+    constexpr int COMPRESSION_MIN_SIZE = 64; // Smaller packages are sent uncompressed
+    constexpr int ZSTD_MIN_SIZE = 4096; // Packages from this size on use zstd instead of LZ4
+    constexpr int ZSTD_LEVEL = 3;
+    constexpr int LZ4_ACCELERATION = 1;
+    constexpr int UNPACKED_MAX_SIZE = 1 << 24; // Largest package a compressed frame may expand to
+
+    constexpr int CHAT_MESSAGE_MAX_SIZE = 1024; // Longer chat messages are refused by the server
+    constexpr int CHAT_HISTORY_MESSAGES = 100; // Last messages of a room the server keeps and sends to newcomers
+    constexpr int CHAT_HISTORY_BYTES = 64 << 10;
+    constexpr int CHAT_LOG_MESSAGES = 4096; // Messages the client keeps for scrolling back
+    constexpr int CHAT_LOG_BYTES = 1 << 20;
+
+    constexpr int DATAGRAM_MAX_SIZE = 1200; // Stays under the usual path MTU
+    constexpr int PREVIEW_POINTS = 24; // Most recent points of a stroke sent in one preview datagram
+
+    constexpr int PRESENCE_TICK_MS = 50; // Server sends cursors of the room once per tick, clients don't send faster
+    constexpr int PRESENCE_REFRESH_MS = 1000; // Every cursor is resent this often, moved or not
+    constexpr int PRESENCE_TIMEOUT_MS = 3000; // Cursor not heard of for this long is gone
+    constexpr float CURSOR_DEAD_BAND = 1.5f; // Smaller moves (in board units) are not sent
+    constexpr int CURSORS_PER_DATAGRAM = 48;
+
+    // Token buckets per connection and package type, see RateLimiter. Packages per second and burst.
+    // Board packages over the limit make the server stop reading from the connection for a while,
+    // other types over it are dropped.
+    constexpr double BOARD_RATE = 500.0;
+    constexpr double BOARD_BURST = 4000.0; // A canvas of a few hundred strokes loaded at once
+    constexpr double CHAT_RATE = 2.0;
+    constexpr double CHAT_BURST = 10.0;
+    constexpr double TRANSIENT_RATE = 60.0;
+    constexpr double TRANSIENT_BURST = 120.0;
+    constexpr int VIOLATIONS_LOG_MS = 60000; // How often the server logs refused packages, if there were any
+
+    constexpr int PING_INTERVAL_MS = 1000; // Clients ping the server and the server pings clients this often
+    constexpr int CLOCK_SYNC_SAMPLES = 16; // Last pings a client estimates the server's clock from
+    constexpr int LATENCY_LOG_MS = 60000; // How often the server logs its latency histograms
+
+    constexpr char DEFAULT_ROOM[] = "main";
+    constexpr int RELAY_FLUSH_MS = 5; // Longest a package waits in a relay batch
+    constexpr int RELAY_BATCH_MAX = 64; // Packages per relay batch, full batches go out right away
+    constexpr int RELAY_LINK_TIMEOUT_MS = 3000; // Longest opening a link to another node may take
+    constexpr int MAX_REDIRECTS = 3; // Handshake redirects a client follows before giving up
 }
 
 #endif //SETTINGS_H
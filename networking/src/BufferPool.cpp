@@ -0,0 +1,121 @@
+#include "networking/BufferPool.h"
+
+#include <bit>
+#include <cstring>
+
+#include "utils/settings.h"
+
+namespace Core::Networking {
+    static std::atomic<std::size_t> maxFrameSize{ Settings::FRAME_MAX_SIZE };
+
+    BufferPool &BufferPool::Instance() {
+        static BufferPool pool;
+        return pool;
+    }
+
+    std::size_t BufferPool::ClassOf(std::size_t size) {
+        const std::size_t rounded = std::bit_ceil(std::max<std::size_t>(size, Settings::BUFFER_MIN_SIZE));
+        return std::countr_zero(rounded) - std::countr_zero(static_cast<std::size_t>(Settings::BUFFER_MIN_SIZE));
+    }
+
+    std::unique_ptr<char[]> BufferPool::Acquire(std::size_t size, std::size_t &capacity) {
+        const std::size_t index = ClassOf(size);
+        capacity = static_cast<std::size_t>(Settings::BUFFER_MIN_SIZE) << index;
+
+        if (index < classes.size()) {
+            auto& sizeClass = classes[index];
+            std::lock_guard lock(sizeClass.mutex);
+            if (!sizeClass.free.empty()) {
+                auto buffer = std::move(sizeClass.free.back());
+                sizeClass.free.pop_back();
+                retainedBytes -= capacity;
+                return buffer;
+            }
+        }
+
+        return std::unique_ptr<char[]>(new char[capacity]);
+    }
+
+    void BufferPool::Release(std::unique_ptr<char[]> buffer, std::size_t capacity) {
+        const std::size_t index = ClassOf(capacity);
+        if (!buffer || index >= classes.size())
+            return;
+
+        auto& sizeClass = classes[index];
+        std::lock_guard lock(sizeClass.mutex);
+        if ((sizeClass.free.size() + 1) * capacity > Settings::POOL_RETAINED_BYTES)
+            return; // Enough of this size waiting already
+
+        sizeClass.free.push_back(std::move(buffer));
+        retainedBytes += capacity;
+    }
+
+    void BufferPool::SetMaxFrameSize(std::size_t size) { maxFrameSize = size; }
+    std::size_t BufferPool::MaxFrameSize() { return maxFrameSize; }
+
+    std::size_t BufferPool::GetRetainedBytes() const { return retainedBytes; }
+
+    PooledBuffer::PooledBuffer(std::size_t size) {
+        buffer = BufferPool::Instance().Acquire(size, bufferCapacity);
+    }
+
+    PooledBuffer::~PooledBuffer() { this->Reset(); }
+
+    PooledBuffer::PooledBuffer(PooledBuffer &&other) noexcept
+        : buffer(std::move(other.buffer)), bufferCapacity(other.bufferCapacity), used(other.used) {
+        other.bufferCapacity = 0;
+        other.used = 0;
+    }
+
+    PooledBuffer &PooledBuffer::operator=(PooledBuffer &&other) noexcept {
+        if (this != &other) {
+            this->Reset();
+            buffer = std::move(other.buffer);
+            bufferCapacity = other.bufferCapacity;
+            used = other.used;
+            other.bufferCapacity = 0;
+            other.used = 0;
+        }
+        return *this;
+    }
+
+    void PooledBuffer::Reset() {
+        if (buffer)
+            BufferPool::Instance().Release(std::move(buffer), bufferCapacity);
+        bufferCapacity = 0;
+        used = 0;
+    }
+
+    char *ReceiveBuffer::Prepare(std::size_t size) {
+        if (this->Free() >= size)
+            return buffer.data() + end;
+
+        const std::size_t pending = this->size();
+        if (buffer.capacity() >= pending + size) {
+            // Enough room once consumed bytes are dropped from the front
+            std::memmove(buffer.data(), buffer.data() + begin, pending);
+        }
+        else {
+            PooledBuffer bigger(pending + size);
+            if (pending)
+                std::memcpy(bigger.data(), buffer.data() + begin, pending);
+            buffer = std::move(bigger);
+        }
+
+        begin = 0;
+        end = pending;
+        return buffer.data() + end;
+    }
+
+    void ReceiveBuffer::Consume(std::size_t size) {
+        begin += size;
+        if (begin >= end)
+            this->Clear();
+    }
+
+    void ReceiveBuffer::Clear() {
+        buffer.Reset();
+        begin = 0;
+        end = 0;
+    }
+}
@@ -0,0 +1,55 @@
+#include "networking/ChatLog.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Core::Networking {
+    ChatLog::ChatLog(std::size_t maxMessages, std::size_t maxBytes)
+        : bytes(std::max<std::size_t>(maxBytes, 4)), entries(std::max<std::size_t>(maxMessages, 1)) {
+    }
+
+    void ChatLog::Add(std::string_view message) {
+        message = message.substr(0, bytes.size() / 4);
+
+        if (count == entries.size())
+            this->DropOldest();
+
+        // Messages are never split, one that doesn't fit before the end starts over at the beginning.
+        // Everything from 'head' to the end is older than what's before it, so it goes first.
+        if (head + message.size() > bytes.size()) {
+            while (count > 0 && entries[first].offset >= head)
+                this->DropOldest();
+            head = 0;
+        }
+
+        // Oldest messages in the way. Once one isn't, newer ones aren't either.
+        while (count > 0) {
+            const Entry& oldest = entries[first];
+            const bool overlaps = oldest.offset < head + message.size() && head < oldest.offset + oldest.length;
+            if (!overlaps && oldest.length > 0)
+                break;
+            this->DropOldest();
+        }
+
+        std::memcpy(bytes.data() + head, message.data(), message.size());
+        entries[(first + count) % entries.size()] = Entry{ static_cast<std::uint32_t>(head), static_cast<std::uint32_t>(message.size()) };
+        count++;
+        head += message.size();
+    }
+
+    void ChatLog::Clear() {
+        first = count = head = 0;
+    }
+
+    std::size_t ChatLog::Size() const { return count; }
+
+    std::string_view ChatLog::operator[](std::size_t i) const {
+        const Entry& entry = entries[(first + i) % entries.size()];
+        return { bytes.data() + entry.offset, entry.length };
+    }
+
+    void ChatLog::DropOldest() {
+        first = (first + 1) % entries.size();
+        count--;
+    }
+}
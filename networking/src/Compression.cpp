@@ -0,0 +1,208 @@
+#include "networking/Compression.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "utils/settings.h"
+
+#ifdef DRAWING_ROOM_COMPRESSION
+#include <lz4.h>
+#include <zstd.h>
+#endif
+
+namespace Core::Networking {
+    // Raw content dictionary: typical packages in their serialized form. Most common ones go last,
+    // matches closer to the end of the dictionary are cheaper to encode.
+    // Changing it breaks compatibility, bump DICTIONARY_ID when you do.
+    static constexpr int DICTIONARY_ID = 1;
+    static constexpr char DICTIONARY[] =
+        R"({"body":{"data":{"message":"Server: User  has joined.\n"}},"header":{"bodySize":29,"senderID":0,"type":0}})"
+        R"({"body":{"data":{"message":"user: "}},"header":{"bodySize":16,"senderID":1,"type":0}})"
+        R"({"body":{"data":{"clock":18,"id":[2,4],"op":1}},"header":{"bodySize":30,"senderID":2,"type":3}})"
+        R"({"body":{"data":{"clock":21,"id":[2,4],"op":2}},"header":{"bodySize":30,"senderID":2,"type":3}})"
+        R"({"body":{"data":{"clock":12,"id":[1,3],"numberOfPoints":20,"options":{"color":[0.0,1.0,0.0,1.0],"thickness":2.0},)"
+        R"("points":[[101.30000305175781,202.5],[103.69999694824219,204.25],[106.0,207.75],[108.5,211.19999694824219],)"
+        R"([111.25,214.80000305175781],[114.0,218.5],[116.75,222.25],[119.5,226.0]],"totalPoints":20}},)"
+        R"("header":{"bodySize":512,"senderID":1,"type":1}})";
+
+    template<typename T>
+    static void PutLE(char* out, T value) {
+        for (std::size_t i = 0; i < sizeof(T); i++)
+            out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+
+    template<typename T>
+    static T GetLE(const char* in) {
+        T value = 0;
+        for (std::size_t i = 0; i < sizeof(T); i++)
+            value |= static_cast<T>(static_cast<unsigned char>(in[i])) << (8 * i);
+        return value;
+    }
+
+#ifdef DRAWING_ROOM_COMPRESSION
+    // Digested dictionaries are read only, so all connections share them
+    static ZSTD_CDict* SharedCompressionDictionary() {
+        static ZSTD_CDict* dictionary = ZSTD_createCDict(DICTIONARY, sizeof(DICTIONARY) - 1, Settings::ZSTD_LEVEL);
+        return dictionary;
+    }
+
+    static ZSTD_DDict* SharedDecompressionDictionary() {
+        static ZSTD_DDict* dictionary = ZSTD_createDDict(DICTIONARY, sizeof(DICTIONARY) - 1);
+        return dictionary;
+    }
+#endif
+
+    Compressor::Compressor() = default;
+
+    Compressor::~Compressor() {
+#ifdef DRAWING_ROOM_COMPRESSION
+        ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(zstdCompression));
+        ZSTD_freeDCtx(static_cast<ZSTD_DCtx*>(zstdDecompression));
+#endif
+    }
+
+    std::vector<std::string> Compressor::SupportedCodecs() {
+#ifdef DRAWING_ROOM_COMPRESSION
+        return { "lz4", "zstd" };
+#else
+        return {};
+#endif
+    }
+
+    int Compressor::DictionaryID() { return DICTIONARY_ID; }
+
+    std::vector<std::string> Compressor::Negotiate(const std::vector<std::string> &offered) {
+        std::vector<std::string> enabled;
+        for (const auto& codec : SupportedCodecs()) {
+            if (std::find(offered.begin(), offered.end(), codec) != offered.end())
+                enabled.push_back(codec);
+        }
+
+        lz4 = std::find(enabled.begin(), enabled.end(), "lz4") != enabled.end();
+        zstd = std::find(enabled.begin(), enabled.end(), "zstd") != enabled.end();
+
+#ifdef DRAWING_ROOM_COMPRESSION
+        // Negotiated again after a reconnect, the contexts stay
+        if (zstd && !zstdCompression) {
+            zstdCompression = ZSTD_createCCtx();
+            zstdDecompression = ZSTD_createDCtx();
+        }
+#endif
+
+        return enabled;
+    }
+
+    bool Compressor::IsEnabled() const { return lz4 || zstd; }
+
+    std::size_t Compressor::PackBound(std::size_t size) {
+        std::size_t bound = size;
+#ifdef DRAWING_ROOM_COMPRESSION
+        bound = std::max({ bound, ZSTD_compressBound(size), static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(size))) });
+#endif
+        return FRAME_HEADER_SIZE + bound;
+    }
+
+    std::size_t Compressor::Pack(const std::string &package, char *frame) {
+        Codec codec = Codec::None;
+        if (zstd && package.size() >= Settings::ZSTD_MIN_SIZE)
+            codec = Codec::Zstd;
+        else if (lz4 && package.size() >= Settings::COMPRESSION_MIN_SIZE)
+            codec = Codec::LZ4;
+
+        return this->Pack(package, frame, codec);
+    }
+
+    std::size_t Compressor::Pack(const std::string &package, char *frame, [[maybe_unused]] Codec requested) {
+        char* stored = frame + FRAME_HEADER_SIZE;
+        std::size_t storedSize = 0;
+        Codec codec = Codec::None;
+
+#ifdef DRAWING_ROOM_COMPRESSION
+        const std::size_t capacity = PackBound(package.size()) - FRAME_HEADER_SIZE;
+        if (requested == Codec::Zstd && zstd) {
+            std::size_t size = ZSTD_compress_usingCDict(
+                static_cast<ZSTD_CCtx*>(zstdCompression),
+                stored, capacity,
+                package.data(), package.size(),
+                SharedCompressionDictionary()
+            );
+            if (!ZSTD_isError(size) && size < package.size()) {
+                storedSize = size;
+                codec = Codec::Zstd;
+            }
+        }
+        else if (requested == Codec::LZ4 && lz4) {
+            LZ4_stream_t stream;
+            LZ4_initStream(&stream, sizeof(stream));
+            LZ4_loadDict(&stream, DICTIONARY, sizeof(DICTIONARY) - 1);
+
+            int size = LZ4_compress_fast_continue(
+                &stream,
+                package.data(), stored,
+                static_cast<int>(package.size()), static_cast<int>(capacity),
+                Settings::LZ4_ACCELERATION
+            );
+            if (size > 0 && static_cast<std::size_t>(size) < package.size()) {
+                storedSize = size;
+                codec = Codec::LZ4;
+            }
+        }
+#endif
+
+        // Too small or incompressible, stored as is
+        if (codec == Codec::None) {
+            std::memcpy(stored, package.data(), package.size());
+            storedSize = package.size();
+        }
+
+        frame[0] = static_cast<char>(codec);
+        PutLE<std::uint32_t>(frame + 1, package.size());
+        PutLE<std::uint32_t>(frame + 5, storedSize);
+
+        return FRAME_HEADER_SIZE + storedSize;
+    }
+
+    FrameHeader Compressor::ParseHeader(const char *data) {
+        return FrameHeader {
+            static_cast<Codec>(data[0]),
+            GetLE<std::uint32_t>(data + 1),
+            GetLE<std::uint32_t>(data + 5)
+        };
+    }
+
+    bool Compressor::Unpack(const FrameHeader &header, const char *stored, std::string &package) {
+        if (header.rawSize > Settings::UNPACKED_MAX_SIZE)
+            return false;
+
+        switch (header.codec) {
+            case Codec::None:
+                package.assign(stored, header.storedSize);
+                return header.rawSize == header.storedSize;
+#ifdef DRAWING_ROOM_COMPRESSION
+            case Codec::LZ4: {
+                if (!lz4) return false;
+                package.resize(header.rawSize);
+                int size = LZ4_decompress_safe_usingDict(
+                    stored, package.data(),
+                    static_cast<int>(header.storedSize), static_cast<int>(header.rawSize),
+                    DICTIONARY, sizeof(DICTIONARY) - 1
+                );
+                return size == static_cast<int>(header.rawSize);
+            }
+            case Codec::Zstd: {
+                if (!zstd) return false;
+                package.resize(header.rawSize);
+                std::size_t size = ZSTD_decompress_usingDDict(
+                    static_cast<ZSTD_DCtx*>(zstdDecompression),
+                    package.data(), header.rawSize,
+                    stored, header.storedSize,
+                    SharedDecompressionDictionary()
+                );
+                return !ZSTD_isError(size) && size == header.rawSize;
+            }
+#endif
+            default:
+                return false;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#include "networking/Datagram.h"
+
+namespace Core::Networking {
+    static void PutU32(std::string& out, std::uint32_t value) {
+        for (int i = 0; i < 4; i++)
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+
+    static std::uint32_t GetU32(const char* in) {
+        std::uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+            value |= static_cast<std::uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+        return value;
+    }
+
+    std::string PackDatagram(IDType connection, std::uint32_t token, const std::string &payload) {
+        std::string datagram;
+        datagram.reserve(DATAGRAM_HEADER_SIZE + payload.size());
+
+        PutU32(datagram, static_cast<std::uint32_t>(connection));
+        PutU32(datagram, token);
+        datagram += payload;
+
+        return datagram;
+    }
+
+    bool UnpackDatagram(const char *data, std::size_t size, Datagram &datagram) {
+        if (size < DATAGRAM_HEADER_SIZE)
+            return false;
+
+        datagram.connection = static_cast<IDType>(GetU32(data));
+        datagram.token = GetU32(data + 4);
+        datagram.payload.assign(data + DATAGRAM_HEADER_SIZE, size - DATAGRAM_HEADER_SIZE);
+
+        return true;
+    }
+
+    bool IsTransient(Package::Type type) {
+        return type == Package::Type::CursorUpdate || type == Package::Type::StrokePreview;
+    }
+}
@@ -0,0 +1,117 @@
+#include "networking/Federation.h"
+
+#include <sstream>
+
+#include "utils/log.h"
+
+namespace Core::Networking {
+    // FNV-1a. Has to give the same result on every node, std::hash doesn't promise that.
+    static std::uint64_t StableHash(const std::string& value) {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : value) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool Federation::Configure(const std::string &list, std::size_t self, const std::string &secret) {
+        nodes.clear();
+        if (secret.empty()) {
+            LOG_LINE("Nodes of a federation need a shared secret");
+            return false;
+        }
+
+        std::stringstream stream(list);
+        std::string node;
+        while (std::getline(stream, node, ',')) {
+            auto colon = node.rfind(':');
+            if (colon == std::string::npos || colon == 0 || colon + 1 == node.size()) {
+                LOG_LINE("Bad node address " << node << ", expected host:port");
+                nodes.clear();
+                return false;
+            }
+            nodes.push_back({ node.substr(0, colon), node.substr(colon + 1) });
+        }
+
+        if (self >= nodes.size()) {
+            LOG_LINE("Node " << self << " is not in the list of " << nodes.size() << " nodes");
+            nodes.clear();
+            return false;
+        }
+
+        this->self = self;
+        this->secret = secret;
+        return true;
+    }
+
+    bool Federation::IsEnabled() const { return nodes.size() > 1; }
+
+    const std::string &Federation::Secret() const { return secret; }
+
+    bool Federation::IsPeer(std::size_t node, const std::string &offered) const {
+        if (!this->IsEnabled() || node >= nodes.size() || node == self)
+            return false;
+
+        // Compared in full whatever the first difference, so the time taken doesn't give the secret away
+        unsigned char difference = offered.size() != secret.size();
+        for (std::size_t i = 0; i < offered.size(); i++)
+            difference |= static_cast<unsigned char>(offered[i] ^ secret[i % secret.size()]);
+        return difference == 0;
+    }
+
+    std::size_t Federation::Owner(const std::string &room) const {
+        // Highest (room, node) score wins. Adding or removing a node only moves
+        // the rooms that node wins or owned.
+        std::size_t owner = 0;
+        std::uint64_t best = 0;
+        for (std::size_t i = 0; i < nodes.size(); i++) {
+            std::uint64_t score = StableHash(room + "@" + this->Address(i));
+            if (i == 0 || score > best) {
+                best = score;
+                owner = i;
+            }
+        }
+        return owner;
+    }
+
+    bool Federation::Owns(const std::string &room) const { return !this->IsEnabled() || this->Owner(room) == self; }
+
+    std::size_t Federation::Self() const { return self; }
+    const std::string &Federation::Host(std::size_t node) const { return nodes.at(node).host; }
+    const std::string &Federation::Port(std::size_t node) const { return nodes.at(node).port; }
+    std::string Federation::Address(std::size_t node) const { return nodes.at(node).host + ":" + nodes.at(node).port; }
+
+    RelayLink::RelayLink(TCPConnection::pointer connection) : connection(std::move(connection)) { }
+
+    void RelayLink::Queue(IDType client, const Package &package) {
+        frames.push_back({ client, Package::CompressToJSON(package) });
+        if (frames.size() >= Settings::RELAY_BATCH_MAX)
+            this->Flush();
+    }
+
+    void RelayLink::QueueLeave(IDType client) {
+        frames.push_back({ client, nullptr });
+        if (frames.size() >= Settings::RELAY_BATCH_MAX)
+            this->Flush();
+    }
+
+    void RelayLink::Flush() {
+        if (!linked || frames.empty() || !connection->getSocket().is_open())
+            return;
+
+        nlohmann::json data;
+        data["frames"] = std::move(frames);
+        frames = nlohmann::json::array();
+
+        connection->Post(Package {
+            Package::Header{ data.dump().size(), Package::Type::Relay, Settings::SERVER_ID },
+            Package::Body{ std::move(data) }
+        });
+    }
+
+    const TCPConnection::pointer &RelayLink::GetConnection() const { return connection; }
+
+    void RelayLink::SetLinked(bool linked) { this->linked = linked; }
+    bool RelayLink::IsLinked() const { return linked; }
+}
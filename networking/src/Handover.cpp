@@ -0,0 +1,150 @@
+#include "networking/Handover.h"
+
+#include <cstring>
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "utils/log.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace Core::Networking {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    Handover::Handover(io_context &context) : listener(context) { }
+
+    Handover::~Handover() { this->Close(); }
+
+    std::optional<Handover::Inherited> Handover::Request(const std::string &path) {
+        io_context context;
+        local::stream_protocol::socket socket(context);
+        boost::system::error_code ec;
+        socket.connect(local::stream_protocol::endpoint(path), ec);
+        if (ec)
+            return std::nullopt; // Nobody to take over from
+
+        LOG_LINE("Taking over from the server at " << path);
+
+        std::uint64_t size = 0;
+        iovec part{ &size, sizeof size };
+        alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))]{};
+        msghdr message{};
+        message.msg_iov = &part;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof control;
+
+        Inherited inherited;
+        const bool sized = ::recvmsg(socket.native_handle(), &message, 0) == sizeof size;
+        const cmsghdr* handles = CMSG_FIRSTHDR(&message);
+        if (handles && handles->cmsg_level == SOL_SOCKET && handles->cmsg_type == SCM_RIGHTS
+            && handles->cmsg_len == CMSG_LEN(2 * sizeof(int))) {
+            int received[2];
+            std::memcpy(received, CMSG_DATA(handles), sizeof received);
+            inherited.acceptor = received[0];
+            inherited.datagrams = received[1];
+        }
+
+        if (sized && inherited.acceptor >= 0) {
+            std::string state(size, '\0');
+            read(socket, buffer(state), ec);
+            if (!ec) {
+                inherited.state = nlohmann::json::parse(state, nullptr, false);
+                if (inherited.state.is_object())
+                    return inherited;
+            }
+        }
+
+        LOG_LINE("The server at " << path << " didn't hand over");
+        if (inherited.acceptor >= 0) {
+            ::close(inherited.acceptor);
+            ::close(inherited.datagrams);
+        }
+        return std::nullopt;
+    }
+
+    bool Handover::Listen(const std::string &path, std::function<void()> requested) {
+        // Left behind by a server that didn't get to clean up
+        ::unlink(path.c_str());
+
+        boost::system::error_code ec;
+        listener.open(local::stream_protocol(), ec);
+        if (!ec)
+            listener.bind(local::stream_protocol::endpoint(path), ec);
+        if (!ec)
+            listener.listen(1, ec);
+        if (ec) {
+            LOG_LINE("Can't wait for a handover at " << path << ": " << ec.message());
+            listener.close(ec);
+            return false;
+        }
+
+        this->path = path;
+        successor.emplace(listener.get_executor());
+        listener.async_accept(*successor, [requested = std::move(requested)](const boost::system::error_code& ec) {
+            if (!ec)
+                requested();
+        });
+        return true;
+    }
+
+    bool Handover::Send(int acceptor, int datagrams, const nlohmann::json &state) {
+        if (!successor || !successor->is_open())
+            return false;
+
+        const std::string payload = state.dump();
+        std::uint64_t size = payload.size();
+        iovec part{ &size, sizeof size };
+        alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))]{};
+        msghdr message{};
+        message.msg_iov = &part;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof control;
+
+        cmsghdr* handles = CMSG_FIRSTHDR(&message);
+        handles->cmsg_level = SOL_SOCKET;
+        handles->cmsg_type = SCM_RIGHTS;
+        handles->cmsg_len = CMSG_LEN(2 * sizeof(int));
+        const int sent[2] = { acceptor, datagrams };
+        std::memcpy(CMSG_DATA(handles), sent, sizeof sent);
+
+        boost::system::error_code ec;
+        bool done = ::sendmsg(successor->native_handle(), &message, MSG_NOSIGNAL) == sizeof size;
+        if (done) {
+            write(*successor, buffer(payload), ec);
+            done = !ec;
+        }
+        successor->close(ec);
+        return done;
+    }
+
+    void Handover::Close() {
+        if (!listener.is_open())
+            return;
+
+        boost::system::error_code ec;
+        listener.close(ec);
+        ::unlink(path.c_str());
+    }
+#else
+    Handover::Handover(io_context &) { }
+
+    Handover::~Handover() = default;
+
+    std::optional<Handover::Inherited> Handover::Request(const std::string &) { return std::nullopt; }
+
+    bool Handover::Listen(const std::string &, std::function<void()>) {
+        LOG_LINE("Handover needs Unix sockets, this platform has none");
+        return false;
+    }
+
+    bool Handover::Send(int, int, const nlohmann::json &) { return false; }
+
+    void Handover::Close() { }
+#endif
+}
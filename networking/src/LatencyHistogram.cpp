@@ -0,0 +1,73 @@
+#include "networking/LatencyHistogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+
+namespace Core::Networking {
+    std::uint64_t MonotonicMicroseconds() {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    void LatencyHistogram::Record(std::uint64_t microseconds) {
+        buckets[BucketOf(microseconds)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(microseconds, std::memory_order_relaxed);
+
+        std::uint64_t previous = max.load(std::memory_order_relaxed);
+        while (previous < microseconds && !max.compare_exchange_weak(previous, microseconds, std::memory_order_relaxed)) { }
+    }
+
+    std::uint64_t LatencyHistogram::Count() const { return count.load(std::memory_order_relaxed); }
+    std::uint64_t LatencyHistogram::Max() const { return max.load(std::memory_order_relaxed); }
+
+    double LatencyHistogram::Mean() const {
+        const std::uint64_t n = this->Count();
+        return n ? static_cast<double>(sum.load(std::memory_order_relaxed)) / n : 0.0;
+    }
+
+    std::uint64_t LatencyHistogram::Percentile(double p) const {
+        const std::uint64_t n = this->Count();
+        if (n == 0)
+            return 0;
+
+        // Rank of the sample, counting from 1
+        const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::clamp(p, 0.0, 1.0) * n + 0.5));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKETS; i++) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return std::min(UpperBound(i), this->Max());
+        }
+        return this->Max();
+    }
+
+    std::string LatencyHistogram::Summary() const {
+        char text[128];
+        std::snprintf(text, sizeof(text), "%llu samples, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms",
+                      static_cast<unsigned long long>(this->Count()), this->Percentile(0.5) / 1000.0,
+                      this->Percentile(0.95) / 1000.0, this->Percentile(0.99) / 1000.0, this->Max() / 1000.0);
+        return text;
+    }
+
+    std::size_t LatencyHistogram::BucketOf(std::uint64_t microseconds) {
+        // 0..3 get a bucket each, from there on four per power of two
+        if (microseconds < 4)
+            return static_cast<std::size_t>(microseconds);
+
+        const int exponent = static_cast<int>(std::bit_width(microseconds)) - 1;
+        const std::size_t quarter = (microseconds >> (exponent - 2)) & 3;
+        return std::min<std::size_t>(4 * (exponent - 1) + quarter, BUCKETS - 1);
+    }
+
+    std::uint64_t LatencyHistogram::UpperBound(std::size_t bucket) {
+        if (bucket < 3)
+            return bucket;
+        // Just below where the next bucket starts
+        const std::size_t next = bucket + 1;
+        const int exponent = static_cast<int>(next / 4) + 1;
+        return ((4 + next % 4) << (exponent - 2)) - 1;
+    }
+}
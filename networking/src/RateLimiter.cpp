@@ -0,0 +1,67 @@
+#include "networking/RateLimiter.h"
+
+#include <algorithm>
+
+#include "utils/settings.h"
+
+namespace Core::Networking {
+    RateLimiter::Limit RateLimiter::LimitOf(Package::Type type) {
+        switch (type) {
+            case Package::Type::BoardUpdate:
+            case Package::Type::BoardOperation:
+            case Package::Type::TileRequest:
+                return { Settings::BOARD_RATE, Settings::BOARD_BURST };
+            case Package::Type::TextMessage:
+                return { Settings::CHAT_RATE, Settings::CHAT_BURST };
+            case Package::Type::CursorUpdate:
+            case Package::Type::StrokePreview:
+            case Package::Type::Ping:
+            case Package::Type::Pong:
+            case Package::Type::Viewport:
+                return { Settings::TRANSIENT_RATE, Settings::TRANSIENT_BURST };
+            default:
+                return { 0.0, 0.0 };
+        }
+    }
+
+    bool RateLimiter::Take(Package::Type type, bool borrow, Clock::time_point now) {
+        const auto index = static_cast<std::size_t>(type);
+        if (index >= buckets.size())
+            return false;
+
+        Bucket& bucket = buckets[index];
+        const Limit limit = LimitOf(type);
+        bucket.tokens = TokensAt(bucket, limit, now);
+        bucket.updated = now;
+        bucket.started = true;
+
+        if (bucket.tokens < 1.0 && !borrow)
+            return false;
+
+        const bool had = bucket.tokens >= 1.0;
+        bucket.tokens -= 1.0;
+        return had;
+    }
+
+    RateLimiter::Clock::duration RateLimiter::Wait(Package::Type type, Clock::time_point now) const {
+        const auto index = static_cast<std::size_t>(type);
+        const Limit limit = LimitOf(type);
+        if (index >= buckets.size() || limit.rate <= 0.0)
+            return Clock::duration::zero();
+
+        const double tokens = TokensAt(buckets[index], limit, now);
+        if (tokens >= 0.0)
+            return Clock::duration::zero();
+
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(-tokens / limit.rate));
+    }
+
+    double RateLimiter::TokensAt(const Bucket &bucket, Limit limit, Clock::time_point now) {
+        // A new bucket starts full
+        if (!bucket.started)
+            return limit.burst;
+
+        const double elapsed = std::chrono::duration<double>(now - bucket.updated).count();
+        return std::min(limit.burst, bucket.tokens + std::max(elapsed, 0.0) * limit.rate);
+    }
+}
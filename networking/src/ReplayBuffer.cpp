@@ -0,0 +1,49 @@
+#include "networking/ReplayBuffer.h"
+
+#include <algorithm>
+
+namespace Core::Networking {
+    ReplayBuffer::ReplayBuffer(std::size_t capacity) : capacity(std::max<std::size_t>(capacity, 1)) { }
+
+    const Package &ReplayBuffer::Push(const Package &package) {
+        if (packages.size() == capacity)
+            packages.pop_front();
+
+        nlohmann::json data = package.getBody().data;
+        data["seq"] = ++last;
+        packages.emplace_back(package.getHeader(), Package::Body{ std::move(data) });
+        return packages.back();
+    }
+
+    std::uint64_t ReplayBuffer::Last() const { return last; }
+
+    bool ReplayBuffer::Since(std::uint64_t sequence, IDType except, std::vector<Package> &out) const {
+        if (sequence > last || last - sequence > packages.size())
+            return false;
+
+        for (auto it = packages.end() - static_cast<std::ptrdiff_t>(last - sequence); it != packages.end(); ++it) {
+            if (it->getHeader().senderID != except)
+                out.push_back(*it);
+        }
+        return true;
+    }
+
+    nlohmann::json ReplayBuffer::Export() const {
+        nlohmann::json state;
+        state["last"] = last;
+        state["packages"] = nlohmann::json::array();
+        for (const auto& package : packages)
+            state["packages"].push_back(Package::CompressToJSON(package));
+        return state;
+    }
+
+    void ReplayBuffer::Import(const nlohmann::json &state) {
+        packages.clear();
+        for (const auto& package : state.at("packages")) {
+            if (packages.size() == capacity)
+                packages.pop_front();
+            packages.push_back(Package::FromJSON(package));
+        }
+        last = state.at("last").get<std::uint64_t>();
+    }
+}
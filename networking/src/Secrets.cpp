@@ -0,0 +1,25 @@
+#include "networking/Secrets.h"
+
+#include <random>
+
+#if defined(__linux__)
+#include <sys/random.h>
+#endif
+
+namespace Core::Networking {
+    std::uint64_t RandomSecret() {
+        std::uint64_t secret = 0;
+#if defined(__linux__)
+        if (getrandom(&secret, sizeof secret, 0) == sizeof secret)
+            return secret;
+#endif
+        // Backed by the OS elsewhere as well, a fresh one per secret so nothing is left to predict from
+        std::random_device device;
+        return (static_cast<std::uint64_t>(device()) << 32) | device();
+    }
+
+    bool SecretsEqual(std::uint64_t a, std::uint64_t b) {
+        volatile std::uint64_t difference = a ^ b;
+        return difference == 0;
+    }
+}
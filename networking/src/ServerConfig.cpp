@@ -0,0 +1,134 @@
+#include "networking/ServerConfig.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "utils/log.h"
+
+namespace Core::Networking {
+    // Values from the file are JSON already, those from the command line are text
+    template<typename T>
+    static T Read(const nlohmann::json& value) {
+        if constexpr (std::is_same_v<T, std::string>)
+            return value.get<std::string>();
+        else if constexpr (std::is_same_v<T, bool>) {
+            if (!value.is_string())
+                return value.get<bool>();
+            if (value == "on" || value == "true")
+                return true;
+            if (value == "off" || value == "false")
+                return false;
+            throw std::invalid_argument("expected on or off");
+        }
+        else {
+            const nlohmann::json number = value.is_string() ? nlohmann::json::parse(value.get<std::string>()) : value;
+            if (!number.is_number_integer() || (std::is_unsigned_v<T> && !number.is_number_unsigned()))
+                throw std::invalid_argument("expected a whole number");
+            return number.get<T>();
+        }
+    }
+
+    bool ServerConfig::FromArguments(int argc, char **argv, nlohmann::json &values, std::string &path) {
+        for (int i = 1; i < argc; i += 2) {
+            if (std::strncmp(argv[i], "--", 2) != 0 || i + 1 == argc) {
+                LOG_LINE("Unexpected argument " << argv[i] << ", expected --<setting> <value>");
+                return false;
+            }
+
+            if (std::strcmp(argv[i], "--config") == 0)
+                path = argv[i + 1];
+            else
+                values[argv[i] + 2] = argv[i + 1];
+        }
+        return true;
+    }
+
+    bool ServerConfig::Load(const std::string &path, const nlohmann::json &overrides) {
+        nlohmann::json values = nlohmann::json::object();
+        if (!path.empty()) {
+            std::ifstream file(path);
+            if (!file) {
+                LOG_LINE("Can't open configuration file " << path);
+                return false;
+            }
+
+            try {
+                values = nlohmann::json::parse(file, nullptr, true, true);
+            }
+            catch (const nlohmann::json::exception& e) {
+                LOG_LINE("Bad configuration file " << path << ": " << e.what());
+                return false;
+            }
+            if (!values.is_object()) {
+                LOG_LINE("Configuration file " << path << " is not a JSON object");
+                return false;
+            }
+        }
+        values.update(overrides);
+
+        for (const auto& [key, value] : values.items()) {
+            try {
+                if (key == "port") port = Read<int>(value);
+                else if (key == "workers") workers = Read<std::size_t>(value);
+                else if (key == "snapshots") snapshots = Read<std::string>(value);
+                else if (key == "record") record = Read<std::string>(value);
+                else if (key == "nodes") nodes = Read<std::string>(value);
+                else if (key == "node") node = Read<std::size_t>(value);
+                else if (key == "secret") secret = Read<std::string>(value);
+                else if (key == "handover") handover = Read<std::string>(value);
+                else if (key == "compression") compression = Read<bool>(value);
+                else if (key == "max-frame") maxFrame = Read<std::size_t>(value);
+                else if (key == "tick") tick = Read<int>(value);
+                else if (key == "queue-high") queueHigh = Read<std::size_t>(value);
+                else if (key == "queue-low") queueLow = Read<std::size_t>(value);
+                else {
+                    LOG_LINE("Unknown setting " << key);
+                    return false;
+                }
+            }
+            catch (const std::exception& e) {
+                LOG_LINE("Bad value " << value.dump() << " for " << key << ": " << e.what());
+                return false;
+            }
+        }
+
+        if (port <= 0 || port > 65535) {
+            LOG_LINE("Port " << port << " is out of range");
+            return false;
+        }
+        if (tick <= 0) {
+            LOG_LINE("Tick has to be at least a millisecond");
+            return false;
+        }
+        if (maxFrame < static_cast<std::size_t>(Settings::BUFFER_MIN_SIZE)) {
+            LOG_LINE("Max frame has to be at least " << Settings::BUFFER_MIN_SIZE << " bytes");
+            return false;
+        }
+        if (queueLow >= queueHigh) {
+            LOG_LINE("Queue low watermark has to be below the high one");
+            return false;
+        }
+        if (!nodes.empty() && secret.empty()) {
+            LOG_LINE("Nodes of a federation need a shared secret");
+            return false;
+        }
+        if (!handover.empty() && snapshots.empty()) {
+            LOG_LINE("Handover needs snapshots, boards go over to the new process through them");
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<std::string> ServerConfig::RestartNeeded(const ServerConfig &running) const {
+        std::vector<std::string> names;
+        if (port != running.port) names.emplace_back("port");
+        if (workers != running.workers) names.emplace_back("workers");
+        if (snapshots != running.snapshots) names.emplace_back("snapshots");
+        if (record != running.record) names.emplace_back("record");
+        if (nodes != running.nodes || node != running.node || secret != running.secret) names.emplace_back("nodes");
+        if (handover != running.handover) names.emplace_back("handover");
+        return names;
+    }
+}
@@ -0,0 +1,110 @@
+#include "networking/SessionCapture.h"
+
+#include <type_traits>
+
+#include "utils/log.h"
+
+namespace Core::Networking {
+    static constexpr char CAPTURE_MAGIC[4] = { 'D', 'R', 'C', 'P' };
+    static constexpr std::uint32_t CAPTURE_VERSION = 1;
+
+    template<typename T>
+    static void WriteLE(std::ofstream& file, T value) {
+        char bytes[sizeof(T)];
+        auto bits = static_cast<std::make_unsigned_t<T>>(value);
+        for (std::size_t i = 0; i < sizeof(T); i++)
+            bytes[i] = static_cast<char>((bits >> (8 * i)) & 0xFF);
+        file.write(bytes, sizeof(bytes));
+    }
+
+    template<typename T>
+    static bool ReadLE(std::ifstream& file, T& value) {
+        unsigned char bytes[sizeof(T)];
+        if (!file.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+            return false;
+
+        std::make_unsigned_t<T> bits = 0;
+        for (std::size_t i = 0; i < sizeof(T); i++)
+            bits |= static_cast<std::make_unsigned_t<T>>(bytes[i]) << (8 * i);
+        value = static_cast<T>(bits);
+        return true;
+    }
+
+    SessionRecorder::~SessionRecorder() {
+        if (file.is_open())
+            file.flush();
+    }
+
+    bool SessionRecorder::Open(const std::string &path) {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            LOG_LINE("Can't open capture file " << path);
+            return false;
+        }
+
+        file.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        WriteLE(file, CAPTURE_VERSION);
+        start = std::chrono::steady_clock::now();
+
+        return true;
+    }
+
+    bool SessionRecorder::IsOpen() const { return file.is_open(); }
+
+    void SessionRecorder::Record(IDType connection, CaptureRecord::Event event, const std::string &payload) {
+        if (!file.is_open())
+            return;
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start
+        );
+
+        WriteLE<std::uint64_t>(file, elapsed.count());
+        WriteLE<std::int32_t>(file, connection);
+        WriteLE<std::uint8_t>(file, static_cast<std::uint8_t>(event));
+        WriteLE<std::uint32_t>(file, payload.size());
+        file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+
+        // Keep the file usable if the server gets killed
+        if (elapsed - lastFlush >= std::chrono::seconds(1) || event == CaptureRecord::Event::Disconnect) {
+            file.flush();
+            lastFlush = elapsed;
+        }
+    }
+
+    bool SessionReader::Open(const std::string &path) {
+        file.open(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        char magic[sizeof(CAPTURE_MAGIC)];
+        std::uint32_t version;
+        if (!file.read(magic, sizeof(magic)) || !ReadLE(file, version))
+            return false;
+
+        if (std::string_view(magic, sizeof(magic)) != std::string_view(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) ||
+            version != CAPTURE_VERSION) {
+            LOG_LINE("Unsupported capture file " << path);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool SessionReader::Next(CaptureRecord &record) {
+        std::uint64_t timestamp;
+        std::int32_t connection;
+        std::uint8_t event;
+        std::uint32_t size;
+
+        if (!ReadLE(file, timestamp) || !ReadLE(file, connection) || !ReadLE(file, event) || !ReadLE(file, size))
+            return false;
+
+        record.timestamp = timestamp;
+        record.connection = connection;
+        record.event = static_cast<CaptureRecord::Event>(event);
+        record.payload.resize(size);
+
+        return static_cast<bool>(file.read(record.payload.data(), size));
+    }
+}
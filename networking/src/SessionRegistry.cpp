@@ -0,0 +1,104 @@
+#include "networking/SessionRegistry.h"
+
+#include <algorithm>
+
+namespace Core::Networking {
+    SessionRegistry::SessionRegistry()
+        : generations(SLOT_MASK + 1, 0), snapshot(std::make_shared<const Snapshot>())
+    { }
+
+    std::optional<IDType> SessionRegistry::Allocate() {
+        IDType slot;
+        {
+            // Reusing a slot takes the lock, fresh slots don't
+            std::lock_guard lock(freeSlotsMutex);
+            if (!freeSlots.empty()) {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+                return slot | (generations[slot] << Settings::SESSION_SLOT_BITS);
+            }
+        }
+
+        slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+        if (slot > SLOT_MASK) {
+            // Kept from counting on while the server is full
+            nextSlot.store(SLOT_MASK + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        return slot;
+    }
+
+    void SessionRegistry::Release(IDType id) {
+        const IDType slot = id & SLOT_MASK;
+        if (slot == 0)
+            return;
+
+        std::lock_guard lock(freeSlotsMutex);
+        if (generations[slot] != (id >> Settings::SESSION_SLOT_BITS))
+            return; // Released already
+
+        generations[slot] = (generations[slot] + 1) & GENERATION_MASK;
+        freeSlots.push_back(slot);
+    }
+
+    void SessionRegistry::Register(const TCPConnection::pointer &connection) {
+        std::lock_guard lock(writeMutex);
+
+        auto next = std::make_shared<Snapshot>(*snapshot.load());
+        next->sessions.push_back(connection);
+        next->byID[connection->GetID()] = connection;
+
+        snapshot.store(std::move(next));
+    }
+
+    bool SessionRegistry::Unregister(IDType id, bool release) {
+        {
+            std::lock_guard lock(writeMutex);
+
+            auto current = snapshot.load();
+            if (!current->byID.contains(id))
+                return false;
+
+            auto next = std::make_shared<Snapshot>(*current);
+            next->byID.erase(id);
+            std::erase_if(next->sessions, [id](const TCPConnection::pointer& c) { return c->GetID() == id; });
+
+            snapshot.store(std::move(next));
+        }
+
+        if (release)
+            this->Release(id);
+        return true;
+    }
+
+    std::shared_ptr<const SessionRegistry::Snapshot> SessionRegistry::Sessions() const {
+        return snapshot.load();
+    }
+
+    TCPConnection::pointer SessionRegistry::Find(IDType id) const {
+        auto current = snapshot.load();
+        auto it = current->byID.find(id);
+        return it != current->byID.end() ? it->second : nullptr;
+    }
+
+    nlohmann::json SessionRegistry::Export() {
+        std::lock_guard lock(freeSlotsMutex);
+        const IDType next = std::min<IDType>(nextSlot.load(std::memory_order_relaxed), SLOT_MASK + 1);
+
+        nlohmann::json state;
+        state["next"] = next;
+        state["free"] = freeSlots;
+        state["generations"] = std::vector<IDType>(generations.begin(), generations.begin() + next);
+        return state;
+    }
+
+    void SessionRegistry::Import(const nlohmann::json &state) {
+        std::lock_guard lock(freeSlotsMutex);
+        nextSlot = state.at("next").get<IDType>();
+        freeSlots = state.at("free").get<std::vector<IDType>>();
+
+        const auto imported = state.at("generations").get<std::vector<IDType>>();
+        std::copy_n(imported.begin(), std::min(imported.size(), generations.size()), generations.begin());
+    }
+}
@@ -2,6 +2,9 @@
 
 #include <boost/bind/bind.hpp>
 
+#include <algorithm>
+
+#include "networking/Datagram.h"
 #include "utils/log.h"
 
 namespace Core::Networking {
@@ -10,10 +13,12 @@ namespace Core::Networking {
     }
 
     TCPClient::~TCPClient() {
+        boost::system::error_code ec;
         if (this->IsConnected())
-            socket->shutdown(ip::tcp::socket::shutdown_both);
+            socket->shutdown(ip::tcp::socket::shutdown_both, ec);
         if (socket->is_open())
-            socket->close();
+            socket->close(ec);
+        datagramSocket.close(ec);
     }
 
     boost::system::error_code TCPClient::ConnectTo(const std::string &address, const std::string &port) {
@@ -34,6 +39,17 @@ namespace Core::Networking {
         // Construct a handshake package
         nlohmann::json data;
         data["username"] = username;
+        data["room"] = room;
+        data["redirect"] = true; // We can reconnect to the node that owns the room
+        data["compression"] = compression ? Compressor::SupportedCodecs() : std::vector<std::string>{};
+        data["dictionary"] = Compressor::DictionaryID();
+        data["loadCanvas"] = loadTheCanvas; // Board follows the response as ordinary board packages
+        loadCanvas = loadTheCanvas;
+        if (session) {
+            data["id"] = id;
+            data["session"] = session;
+            data["lastSequence"] = roomSequence;
+        }
 
         Package handshake {
             Package::Header{ data.dump().length(), Package::Type::Handshake, -1 },
@@ -42,34 +58,76 @@ namespace Core::Networking {
         if (!this->SendPackage(handshake))
             return false;
 
-        if (this->ReadStringUntil(';'))
+        boost::system::error_code ec;
+        auto received = this->ReadPackage(ec);
+        if (!received)
             return false;
 
-        if (loadTheCanvas) {
-            // TODO: start accepting packages with lines
-            // NOTE: number of packages will be in the response
+        // Received an ID. Only the response is consumed, packages
+        // that came right after it stay in the buffer for StartReading.
+        const Package& response = *received;
+
+        // Room lives on another server node, start over there
+        if (auto redirect = response.getBody().data.find("redirect"); redirect != response.getBody().data.end()) {
+            const std::string address = *redirect;
+            const auto colon = address.rfind(':');
+            if (++redirects > Settings::MAX_REDIRECTS || colon == std::string::npos) {
+                LOG_LINE("Giving up on redirect to " << address);
+                return false;
+            }
+
+            LOG_LINE("Redirected to " << address);
+            socket->close(ec);
+            this->DiscardReceived();
+            connected = false;
+
+            if (this->ConnectTo(address.substr(0, colon), address.substr(colon + 1)))
+                return false;
+            return this->Handshake(loadTheCanvas);
         }
 
-        // Received an ID.
-        std::istream is(&streamBuffer);
-        std::string handshakeResponse;
-        std::getline(is, handshakeResponse);
-        id = Package::Parse(handshakeResponse.substr(0, handshakeResponse.size() - 1)).getBody().data.at("id");
+        id = response.getBody().data.at("id");
+        firstSequence = response.getBody().data.value("sequence", 0u);
+        session = response.getBody().data.value("session", std::uint64_t{0});
+        resumed = response.getBody().data.value("resumed", false);
+        if (!resumed)
+            roomSequence = response.getBody().data.value("roomSequence", std::uint64_t{0});
 
         LOG_LINE("Received an ID from the server: " << id);
 
+        // Server lists the codecs it agreed to, everything after the handshake is framed then
+        auto codecs = response.getBody().data.value("compression", std::vector<std::string>{});
+        if (!codecs.empty())
+            this->EnableCompression(codecs);
+
+        if (resumed)
+            this->Resend(response.getBody().data.value("received", std::uint64_t{0}));
+        else {
+            // Anything from an earlier session would carry the wrong ID
+            sent.clear();
+            sentBefore = 0;
+            // Might be another server, with another clock
+            clockSamples.clear();
+            clockKnown = false;
+        }
+
+        if (response.getBody().data.contains("udpToken"))
+            this->OpenDatagramChannel(response.getBody().data.at("udpToken"));
+
         return true;
     }
 
+    bool TCPClient::SendPackage(const Package &package) {
+        Package stamped = package;
+        this->Stamp(stamped);
+        return TCPCommunicative::SendPackage(stamped);
+    }
+
     void TCPClient::StartReading() {
-        // Once again, ';' indicates the end of the package
-        async_read_until(
-            *socket,
-            streamBuffer, ";",
-            [this] (boost::system::error_code ec, size_t bytes_transferred) {
-                this->OnPackageReceived(ec, bytes_transferred);
-            }
-        );
+        this->StartPing();
+        this->ReadNext();
+        if (datagrams)
+            this->ReceiveDatagram();
         context.run();
     }
 
@@ -78,23 +136,282 @@ namespace Core::Networking {
     }
 
     bool TCPClient::IsConnected() const { return connected; }
+    bool TCPClient::IsReconnecting() const { return reconnecting; }
 
     void TCPClient::SetUsername(const std::string &username) { this->username = username; }
+    void TCPClient::SetRoom(const std::string &room) { this->room = room; }
+    void TCPClient::SetCompression(bool enabled) { this->compression = enabled; }
 
     std::size_t TCPClient::GetID() const { return id; }
+    std::uint32_t TCPClient::GetFirstSequence() const { return firstSequence; }
+
+    void TCPClient::Send(const Package &package) {
+        Package stamped = package;
+        this->Stamp(stamped);
+
+        // The socket and 'sent' belong to the reading thread
+        post(context, [this, package = std::move(stamped)]() {
+            sent.push_back(package);
+            if (sent.size() > Settings::RESEND_BUFFER_PACKAGES) {
+                sent.pop_front();
+                sentBefore++;
+            }
+
+            if (connected)
+                this->AsyncSendPackage(package);
+        });
+    }
+
+    bool TCPClient::SendDatagram(const Package &package) {
+        if (!datagrams)
+            return false;
 
-    void TCPClient::OnPackageReceived(const boost::system::error_code& ec, std::size_t bytesTransferred) {
+        Package stamped = package;
+        this->Stamp(stamped);
+        auto datagram = std::make_shared<std::string>(
+            PackDatagram(id, datagramToken, Package::CompressToJSON(stamped).dump())
+        );
+        if (datagram->size() > Settings::DATAGRAM_MAX_SIZE)
+            return false;
+
+        // The socket belongs to the reading thread
+        post(context, [this, datagram]() {
+            datagramSocket.async_send(
+                buffer(*datagram),
+                [datagram](const boost::system::error_code&, std::size_t) { }
+            );
+        });
+
+        return true;
+    }
+
+    const LatencyHistogram &TCPClient::GetRoundTrip() const { return roundTrip; }
+    const LatencyHistogram &TCPClient::GetStrokeLatency() const { return strokeLatency; }
+    std::uint64_t TCPClient::GetDatagramsLost() const { return datagramsLost; }
+
+    void TCPClient::ReadNext() {
+        this->AsyncReadPackage(
+            [this] (const boost::system::error_code &ec, std::optional<Package> package) {
+                this->OnPackageReceived(ec, std::move(package));
+            }
+        );
+    }
+
+    void TCPClient::OnPackageReceived(const boost::system::error_code& ec, std::optional<Package> package) {
         if (!ec) {
-            auto package = Package::Parse(streamBuffer, bytesTransferred);
-            pkgRecCallback(package);
+            const auto type = package->getHeader().type;
+            if (type == Package::Type::Ping)
+                this->OnPing(*package);
+            else if (type == Package::Type::Pong)
+                this->OnPong(*package);
+            else {
+                // Board packages are numbered by the server, see ReplayBuffer
+                if (type == Package::Type::BoardUpdate || type == Package::Type::BoardOperation) {
+                    const auto& data = package->getBody().data;
+                    if (auto seq = data.find("seq"); seq != data.end() && seq->is_number_unsigned())
+                        roomSequence = *seq;
+
+                    const std::uint64_t sentAt = package->getHeader().timestamp, now = this->ServerTime();
+                    if (sentAt && now)
+                        strokeLatency.Record(now > sentAt ? now - sentAt : 0);
+                }
+
+                pkgRecCallback(*package);
+            }
 
             if (this->IsConnected()) {
-                this->StartReading();
+                this->ReadNext();
             }
+            return;
         }
-        else {
-            LOG_LINE("Error receiving message. " << ec.what());
+
+        if (!this->IsConnected())
+            return;
+
+        LOG_LINE("Connection lost. " << ec.message());
+        if (connectionLostCallback)
+            connectionLostCallback();
+        this->Reconnect();
+    }
+
+    void TCPClient::Reconnect() {
+        connected = false;
+        reconnecting = true;
+
+        boost::system::error_code ec;
+        socket->close(ec);
+        this->DiscardReceived();
+        this->EnableCompression({}); // Handshake is never compressed
+
+        reconnectTimer.expires_after(reconnectDelay);
+        reconnectTimer.async_wait([this](const boost::system::error_code& ec) {
+            if (ec)
+                return;
+
+            // Same node as before, it's the one that owns the room
+            socket->async_connect(endpoint, [this](const boost::system::error_code& ec) {
+                this->OnReconnected(ec);
+            });
+        });
+    }
+
+    void TCPClient::OnReconnected(const boost::system::error_code &ec) {
+        redirects = 0;
+        if (!ec)
+            connected = true;
+
+        // Same as the first time if the server can't resume the session
+        if (ec || !this->Handshake(loadCanvas)) {
+            reconnectDelay = std::min(reconnectDelay * 2, std::chrono::milliseconds(Settings::RECONNECT_MAX_MS));
+            LOG_LINE("Reconnecting failed, next attempt in " << reconnectDelay.count() << " ms");
+            this->Reconnect();
+            return;
+        }
+
+        LOG_LINE((resumed ? "Session resumed" : "Reconnected with a new session"));
+        reconnectDelay = std::chrono::milliseconds(Settings::RECONNECT_MIN_MS);
+        reconnecting = false;
+        if (reconnectCallback)
+            reconnectCallback(resumed);
+
+        this->ReadNext();
+        if (datagrams && !receivingDatagrams)
+            this->ReceiveDatagram();
+    }
+
+    void TCPClient::Resend(std::uint64_t received) {
+        if (received < sentBefore) {
+            LOG_LINE((sentBefore - received) << " packages never reached the server and can't be sent again");
+            sentBefore = received;
+        }
+
+        while (!sent.empty() && sentBefore < received) {
+            sent.pop_front();
+            sentBefore++;
+        }
+
+        for (const auto& package : sent)
+            this->AsyncSendPackage(package);
+    }
+
+    void TCPClient::Stamp(Package &package) {
+        const auto type = static_cast<std::size_t>(package.getHeader().type);
+        if (type < sequences.size())
+            package.Stamp(sequences[type].fetch_add(1, std::memory_order_relaxed) + 1, this->ServerTime());
+    }
+
+    std::uint64_t TCPClient::ServerTime() const {
+        if (!clockKnown)
+            return 0;
+        return static_cast<std::uint64_t>(static_cast<std::int64_t>(MonotonicMicroseconds()) + clockOffset.load());
+    }
+
+    void TCPClient::StartPing() {
+        pingTimer.expires_after(std::chrono::milliseconds(Settings::PING_INTERVAL_MS));
+        pingTimer.async_wait([this](const boost::system::error_code& ec) {
+            if (ec)
+                return;
+
+            if (this->IsConnected()) {
+                nlohmann::json data;
+                data["sent"] = MonotonicMicroseconds(); // Our clock, we're the one reading it back
+                Package ping { Package::Header{ data.dump().size(), Package::Type::Ping, id }, Package::Body{ data } };
+                this->Stamp(ping);
+                this->AsyncSendPackage(ping);
+            }
+            this->StartPing();
+        });
+    }
+
+    void TCPClient::OnPing(const Package &ping) {
+        nlohmann::json data = ping.getBody().data;
+        data["time"] = this->ServerTime();
+        Package pong { Package::Header{ data.dump().size(), Package::Type::Pong, id }, Package::Body{ data } };
+        this->Stamp(pong);
+        this->AsyncSendPackage(pong);
+    }
+
+    void TCPClient::OnPong(const Package &pong) {
+        const auto& data = pong.getBody().data;
+        const std::uint64_t now = MonotonicMicroseconds();
+        const std::uint64_t sent = data.value("sent", std::uint64_t{0});
+        if (sent == 0 || sent > now)
+            return;
+
+        const std::uint64_t rtt = now - sent;
+        roundTrip.Record(rtt);
+
+        // Server read its clock about halfway through the round trip
+        const auto time = data.find("time");
+        if (time == data.end() || !time->is_number_unsigned())
+            return;
+
+        clockSamples.push_back({ rtt, static_cast<std::int64_t>(time->get<std::uint64_t>()) - static_cast<std::int64_t>(sent + rtt / 2) });
+        if (clockSamples.size() > Settings::CLOCK_SYNC_SAMPLES)
+            clockSamples.pop_front();
+
+        auto best = std::min_element(clockSamples.begin(), clockSamples.end(),
+                                     [](const ClockSample& a, const ClockSample& b) { return a.roundTrip < b.roundTrip; });
+        clockOffset = best->offset;
+        clockKnown = true;
+    }
+
+    void TCPClient::OpenDatagramChannel(std::uint32_t token) {
+        // Same address and port number as the TCP connection
+        boost::system::error_code ec;
+        datagramSocket.connect(ip::udp::endpoint(endpoint.address(), endpoint.port()), ec);
+        if (ec) {
+            LOG_LINE("Datagram channel unavailable, everything goes over TCP. " << ec.message());
+            return;
         }
+
+        datagramToken = token;
+        datagrams = true;
+
+        // Lets the server learn our endpoint before we have anything to send
+        datagramSocket.send(buffer(PackDatagram(id, datagramToken, {})), 0, ec);
     }
 
-}
+    void TCPClient::ReceiveDatagram() {
+        receivingDatagrams = true;
+        datagramSocket.async_receive(
+            buffer(datagramBuffer),
+            boost::bind(
+                &TCPClient::OnDatagramReceived,
+                this,
+                placeholders::error,
+                placeholders::bytes_transferred
+            )
+        );
+    }
+
+    void TCPClient::OnDatagramReceived(const boost::system::error_code &ec, std::size_t size) {
+        receivingDatagrams = false;
+        if (ec == error::operation_aborted)
+            return;
+
+        // Other errors (e.g. ICMP port unreachable) only cost us this datagram
+        Datagram datagram;
+        if (!ec && UnpackDatagram(datagramBuffer.data(), size, datagram) && datagram.connection == Settings::SERVER_ID) {
+            try {
+                Package package = Package::Parse(datagram.payload);
+                const auto& header = package.getHeader();
+
+                // Previews are relayed one by one, a gap in a sender's numbers is a lost one
+                if (header.type == Package::Type::StrokePreview && header.sequence) {
+                    auto& last = lastPreview[header.senderID];
+                    if (last && header.sequence > last + 1)
+                        datagramsLost += header.sequence - last - 1;
+                    last = std::max(last, header.sequence);
+                }
+
+                if (IsTransient(header.type))
+                    pkgRecCallback(package);
+            }
+            catch (const nlohmann::json::exception&) { }
+        }
+
+        if (this->IsConnected())
+            this->ReceiveDatagram();
+    }
+}
\ No newline at end of file
@@ -3,22 +3,48 @@
 #include <utils/log.h>
 #include <boost/bind/bind.hpp>
 
+#include <atomic>
+
+#include "networking/Secrets.h"
+
 namespace Core::Networking {
-    TCPConnection::TCPConnection(io_context& context) {
+    static std::atomic<std::size_t> queueHigh{ Settings::QUEUE_HIGH_PACKAGES }, queueLow{ Settings::QUEUE_LOW_PACKAGES };
+
+    TCPConnection::TCPConnection(io_context& context) : readTimer(context) {
         this->socket = new tcp::socket(context);
+
+        this->datagramToken = static_cast<std::uint32_t>(RandomSecret());
     }
 
     TCPConnection::~TCPConnection() {
         LOG_LINE("TCPConnection destructor");
-        socket->shutdown(tcp::socket::shutdown_both);
-        socket->close();
+        // Peer might be gone already, nothing to report then
+        boost::system::error_code ec;
+        socket->shutdown(tcp::socket::shutdown_both, ec);
+        socket->close(ec);
     }
 
-    void TCPConnection::SetID(std::size_t id) { this->id = id; }
+    void TCPConnection::SetID(IDType id) { this->id = id; }
     void TCPConnection::SetUsername(const std::string &username) { this->username = username; }
+    void TCPConnection::SetRoom(const std::string &room) { this->room = room; }
+    void TCPConnection::SetDatagramEndpoint(const ip::udp::endpoint &endpoint) { this->datagramEndpoint = endpoint; }
+    void TCPConnection::SetReceived(std::uint64_t received) { this->received = received; }
 
-    std::size_t TCPConnection::GetID() const { return this->id; }
+    IDType TCPConnection::GetID() const { return this->id; }
     const std::string &TCPConnection::GetUsername() const { return this->username; }
+    const std::string &TCPConnection::GetRoom() const { return this->room; }
+    std::uint32_t TCPConnection::GetDatagramToken() const { return this->datagramToken; }
+    const std::optional<ip::udp::endpoint> &TCPConnection::GetDatagramEndpoint() const { return this->datagramEndpoint; }
+    std::uint64_t TCPConnection::GetReceived() const { return this->received; }
+    bool TCPConnection::IsClosedByPeer() const { return this->closedByPeer; }
+    bool TCPConnection::IsMalformed() const { return this->malformed; }
+
+    std::uint32_t TCPConnection::Gap(Package::Type type, std::uint32_t sequence) {
+        auto& last = lastSequence.at(static_cast<std::size_t>(type));
+        const std::uint32_t gap = last && sequence > last + 1 ? sequence - last - 1 : 0;
+        last = std::max(last, sequence);
+        return gap;
+    }
 
     void TCPConnection::Start(PackageCallback &&pckgCallback, ErrorCallback &&errorHandler) {
         packageCallback = std::move(pckgCallback);
@@ -27,31 +53,64 @@ namespace Core::Networking {
     }
 
     void TCPConnection::Post(const Package &package) {
-        bool queueIdle = pendingPackages.empty();
-        pendingPackages.push(package);
+        bool queueIdle = pendingPackages.empty() && !greeting;
+        pendingPackages.push_back(package);
 
         if (queueIdle) this->StartWrite();
     }
 
+    void TCPConnection::Greet(const std::string &frame, std::function<void(const boost::system::error_code&)> &&sent) {
+        greeting = true;
+        PooledBuffer message(frame.size());
+        std::memcpy(message.data(), frame.data(), frame.size());
+        message.SetSize(frame.size());
+
+        this->AsyncSendBuffer(
+            std::move(message),
+            [self = shared_from_this(), sent = std::move(sent)](boost::system::error_code ec, std::size_t) {
+                self->greeting = false;
+                if (!ec && !self->pendingPackages.empty())
+                    self->StartWrite();
+                sent(ec);
+            }
+        );
+    }
+
     tcp::socket& TCPConnection::getSocket() { return *socket; }
 
+    RateLimiter &TCPConnection::GetLimiter() { return limiter; }
+
+    void TCPConnection::PauseReading(RateLimiter::Clock::duration duration) {
+        resumeReading = std::max(resumeReading, RateLimiter::Clock::now() + duration);
+    }
+
+    void TCPConnection::SetQueueWatermarks(std::size_t high, std::size_t low) {
+        queueHigh = high;
+        queueLow = low;
+    }
+
+    void TCPConnection::DropIncoming() { this->dropping = true; }
+
+    bool TCPConnection::IsFlushed() const { return pendingPackages.empty() && !greeting; }
+
     void TCPConnection::StartRead() {
-        // Reading until first ';' character, which indicates the end of the package.
-        async_read_until(
-            *socket,
-            streamBuffer, ";",
-            boost::bind(
-                &TCPConnection::HandleRead,
-                shared_from_this(),
-                placeholders::error,
-                placeholders::bytes_transferred
-            )
+        this->AsyncReadPackage(
+            [self = shared_from_this()](const boost::system::error_code &ec, std::optional<Package> package) {
+                self->HandleRead(ec, std::move(package));
+            }
         );
     }
 
     void TCPConnection::StartWrite() {
-        this->AsyncSendPackage(
-            pendingPackages.top(),
+        // Whatever queued up meanwhile goes out with one write
+        writing = std::min<std::size_t>(pendingPackages.size(), Settings::WRITE_BATCH_MAX);
+        std::vector<PooledBuffer> messages;
+        messages.reserve(writing);
+        for (std::size_t i = 0; i < writing; i++)
+            messages.push_back(this->Serialize(pendingPackages[i]));
+
+        this->AsyncSendBuffers(
+            std::move(messages),
             boost::bind(
                 &TCPConnection::HandleWrite,
                 shared_from_this(),
@@ -61,48 +120,79 @@ namespace Core::Networking {
         );
     }
 
-    void TCPConnection::HandleRead(const boost::system::error_code &ec, std::size_t bytesTransferred) {
+    void TCPConnection::HandleRead(const boost::system::error_code &ec, std::optional<Package> package) {
+        if (dropping) {
+            // Read on so that closing doesn't reset the connection with our last packages unsent
+            if (ec)
+                socket->close();
+            else
+                this->ContinueReading();
+            return;
+        }
+
         if (!ec) {
-            auto package = Package::Parse(streamBuffer, bytesTransferred);
-            packageCallback(package);
-
-            switch (package.getHeader().type) {
-                case Package::Type::TextMessage:
-                    LOG_LINE("Message from id " << package.getHeader().senderID << ": " << package.getBody().data);
-                    break;
-                case Package::Type::BoardUpdate:
-                    LOG_LINE("Board update from id " << package.getHeader().senderID << ": " << package.getBody().data);
-                    break;
-                default:
-                    break;
-            }
+            // Whatever the peer wrote there, the package comes from this connection
+            package->SetSenderID(id);
+            // Counted like the client counts what it would send again, pings and pongs it never does
+            const auto type = package->getHeader().type;
+            if (type != Package::Type::Ping && type != Package::Type::Pong)
+                received++;
+            packageCallback(*package);
         }
         else if (ec == error::eof) {
             // Disconnected correctly
+            closedByPeer = true;
             socket->close();
             errorCallback();
             return;
         }
         else {
-            // Connection lost
+            // Connection lost, or the peer sent garbage
+            malformed = ec == error::invalid_argument;
             LOG_LINE(ec.what());
             socket->close();
             errorCallback();
             return;
         }
 
+        this->ContinueReading();
+    }
+
+    void TCPConnection::ContinueReading() {
+        // HandleWrite reads on once the queue drained
+        if (pendingPackages.size() >= queueHigh)
+            backedUp = true;
+        if (backedUp)
+            return;
+
+        if (resumeReading > RateLimiter::Clock::now()) {
+            readTimer.expires_at(resumeReading);
+            readTimer.async_wait([self = shared_from_this()](const boost::system::error_code& ec) {
+                if (!ec && self->socket->is_open())
+                    self->StartRead();
+            });
+            return;
+        }
+
         this->StartRead();
     }
 
     void TCPConnection::HandleWrite(const boost::system::error_code &ec, std::size_t bytesTransferred) {
         if (!ec) {
-            pendingPackages.pop();
+            pendingPackages.erase(pendingPackages.begin(), pendingPackages.begin() + static_cast<std::ptrdiff_t>(writing));
+            writing = 0;
             if (!pendingPackages.empty()) this->StartWrite();
+
+            if (backedUp && pendingPackages.size() <= queueLow && socket->is_open()) {
+                backedUp = false;
+                this->ContinueReading();
+            }
         }
         else {
             LOG_LINE("HandleWrite " << ec.what());
             socket->close();
-            errorCallback();
+            if (!dropping)
+                errorCallback();
         }
     }
 }
@@ -2,32 +2,165 @@
 
 #include <boost/bind/bind.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "networking/Datagram.h"
+#include "networking/Secrets.h"
 #include "utils/log.h"
 
 namespace Core::Networking {
-    TCPServer::TCPServer(int port)
-        : port(port), acceptor(IOContext, tcp::endpoint(ip::tcp::v4(), port))
-    { }
+    TCPServer::TCPServer(int port, std::optional<Handover::Inherited> inherited)
+        : port(port), acceptor(IOContext),
+        datagramSocket(IOContext),
+        presenceTimer(IOContext),
+        relayTimer(IOContext),
+        signals(IOContext, SIGINT, SIGTERM),
+        reloadSignals(IOContext),
+        handover(IOContext),
+        drainTimer(IOContext)
+    {
+#ifdef SIGHUP
+        reloadSignals.add(SIGHUP);
+#endif
+
+        if (inherited) {
+            // Listening on the port already, connections that came meanwhile wait in its backlog
+            acceptor.assign(ip::tcp::v4(), inherited->acceptor);
+            datagramSocket.assign(ip::udp::v4(), inherited->datagrams);
+            this->Import(inherited->state);
+            return;
+        }
+
+        acceptor.open(ip::tcp::v4());
+        acceptor.set_option(tcp::acceptor::reuse_address(true));
+        acceptor.bind(tcp::endpoint(ip::tcp::v4(), port));
+        acceptor.listen();
+        datagramSocket.open(ip::udp::v4());
+        datagramSocket.bind(ip::udp::endpoint(ip::udp::v4(), port));
+    }
 
     TCPServer::~TCPServer() {
         // Close all connections
         LOG_LINE("Server shutdown");
-        for (auto& c : connections) {
-            c->getSocket().shutdown(tcp::socket::shutdown_both);
-            c->getSocket().close();
+        boost::system::error_code ec;
+        for (auto& c : sessions.Sessions()->sessions) {
+            c->getSocket().shutdown(tcp::socket::shutdown_both, ec);
+            c->getSocket().close(ec);
         }
-        connections.clear();
+        for (auto& [id, relayed] : relayedClients)
+            relayed.connection->getSocket().close(ec);
+        for (auto& [node, link] : outgoingLinks)
+            link->GetConnection()->getSocket().close(ec);
+        for (auto& link : incomingLinks)
+            link->GetConnection()->getSocket().close(ec);
     }
 
     void TCPServer::Run() {
         this->StartAccept();
-        LOG_LINE("Server is UP");
+        this->StartReceiveDatagram();
+        this->StartPresenceTick();
+        if (federation.IsEnabled())
+            this->StartRelayFlush();
+        this->StartSignalWait();
+        this->StartReloadWait();
+        LOG_LINE("Server is UP, " << GetBackend() << " backend");
         IOContext.run();
     }
 
+    const char* TCPServer::GetBackend() {
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+        return "io_uring";
+#elif defined(BOOST_ASIO_HAS_EPOLL)
+        return "epoll";
+#else
+        return "default";
+#endif
+    }
+
+    void TCPServer::SetCompression(bool enabled) { this->compression = enabled; }
+
+    void TCPServer::Configure(const ServerConfig &config) {
+        this->compression = config.compression;
+        this->tick = std::chrono::milliseconds(config.tick);
+        BufferPool::SetMaxFrameSize(config.maxFrame);
+        TCPConnection::SetQueueWatermarks(config.queueHigh, config.queueLow);
+
+        LOG_LINE("Compression " << (config.compression ? "on" : "off") << ", max frame " << config.maxFrame
+                 << " bytes, tick " << config.tick << " ms, queue watermarks " << config.queueHigh << "/" << config.queueLow);
+    }
+
+    void TCPServer::SetReloadCallback(std::function<void()> callback) { this->reloadCallback = std::move(callback); }
+
+    void TCPServer::StartSignalWait() {
+        signals.async_wait([this](const boost::system::error_code& ec, int) {
+            if (ec)
+                return;
+            if (draining) {
+                this->Stop();
+                return;
+            }
+            this->Drain();
+            this->StartSignalWait();
+        });
+    }
+
+    void TCPServer::StartReloadWait() {
+        reloadSignals.async_wait([this](const boost::system::error_code& ec, int) {
+            if (ec)
+                return;
+            if (reloadCallback)
+                reloadCallback();
+            this->StartReloadWait();
+        });
+    }
+
+    void TCPServer::Stop() {
+        IOContext.stop();
+    }
+
+    void TCPServer::Drain() {
+        if (draining)
+            return;
+
+        LOG_LINE("Draining, " << sessions.Sessions()->sessions.size() << " clients connected");
+        this->Quiesce();
+        handover.Close();
+
+        boost::system::error_code ec;
+        acceptor.close(ec);
+        datagramSocket.close(ec);
+        this->Flush(std::chrono::steady_clock::now() + std::chrono::milliseconds(Settings::DRAIN_TIMEOUT_MS));
+    }
+
+    bool TCPServer::AwaitSuccessor(const std::string &path) {
+        const bool waiting = handover.Listen(path, [this] {
+            if (draining)
+                return;
+
+            LOG_LINE("Handing over to a new process, " << sessions.Sessions()->sessions.size() << " clients connected");
+            this->Quiesce();
+            // The new process waits at the same path in turn
+            handover.Close();
+            if (!handover.Send(acceptor.native_handle(), datagramSocket.native_handle(), this->Export()))
+                LOG_LINE("The new process went away before it took over");
+
+            boost::system::error_code ec;
+            acceptor.close(ec);
+            datagramSocket.close(ec);
+            this->Flush(std::chrono::steady_clock::now() + std::chrono::milliseconds(Settings::DRAIN_TIMEOUT_MS));
+        });
+        if (!waiting)
+            return false;
+
+        LOG_LINE("A new process can take over at " << path);
+        return true;
+    }
+
     void TCPServer::StartAccept() {
+        // Gets an ID and becomes visible to broadcasts only once its handshake is done
         TCPConnection::pointer newConnection = TCPConnection::Create(IOContext);
-        newConnection->SetID(GetNextConnectionID());
 
         acceptor.async_accept(
             newConnection->getSocket(),
@@ -37,104 +170,1283 @@ namespace Core::Networking {
                 placeholders::error
             )
         );
+    }
 
-        connections.push_back(newConnection);
+    bool TCPServer::StartRecording(const std::string &path) {
+        if (!recorder.Open(path))
+            return false;
+
+        LOG_LINE("Recording session to " << path);
+        return true;
+    }
+
+    bool TCPServer::Federate(const std::string &nodes, std::size_t self, const std::string &secret) {
+        if (!federation.Configure(nodes, self, secret))
+            return false;
+
+        LOG_LINE("Node " << self << " (" << federation.Address(self) << ") of a federation");
+        return true;
     }
 
-    void TCPServer::BroadcastMessage(const std::string &message, IDType sender) const {
+    void TCPServer::SetRoomState(RoomState *state) { this->roomState = state; }
+
+    void TCPServer::BroadcastMessage(const std::string &message, IDType sender, const std::string &room) {
         std::string senderUsername = sender == 0 ? "Server" : "unknown";
         // Getting a username based on sender's ID.
-        for (auto& c : connections) {
-            if (c->GetID() == sender)
-                senderUsername = c->GetUsername();
-        }
+        if (auto c = sessions.Find(sender))
+            senderUsername = c->GetUsername();
+        if (auto member = remoteMembers.find(sender); member != remoteMembers.end())
+            senderUsername = member->second.username;
 
         nlohmann::json data;
         data["message"] = senderUsername + ": " + message;
+
+        auto history = chatHistory.try_emplace(room, Settings::CHAT_HISTORY_MESSAGES, Settings::CHAT_HISTORY_BYTES).first;
+        history->second.Add(data["message"].get_ref<const std::string&>());
+
         this->BroadcastToEach(Package {
             Package::Header { message.size() + senderUsername.size() + 2, Package::Type::TextMessage, sender },
             Package::Body { data }
-        });
+        }, room);
     }
 
-    void TCPServer::BroadcastToEach(const Package &package) const {
-        for (auto& c : connections) {
-            if (c->getSocket().is_open())
+    void TCPServer::BroadcastToEach(const Package &package, const std::string &room) const {
+        for (auto& c : sessions.Sessions()->sessions) {
+            if (c->GetRoom() == room && c->getSocket().is_open())
                 c->Post(package);
         }
+        for (auto& [id, member] : remoteMembers) {
+            if (member.room == room)
+                member.link->Queue(member.client, package);
+        }
     }
 
-    void TCPServer::BroadcastToEachExcept(const Package &package, IDType except) const {
-        for (auto& c : connections) {
-            if (c->GetID() != except && c->getSocket().is_open())
+    void TCPServer::BroadcastToEachExcept(const Package &package, IDType except, const std::string &room) const {
+        for (auto& c : sessions.Sessions()->sessions) {
+            if (c->GetID() != except && c->GetRoom() == room && c->getSocket().is_open())
                 c->Post(package);
         }
+        for (auto& [id, member] : remoteMembers) {
+            if (id != except && member.room == room)
+                member.link->Queue(member.client, package);
+        }
+    }
+
+    void TCPServer::BroadcastToAudience(const Package &package, IDType except, const std::string &room, const std::vector<IDType> &audience) const {
+        // Those that never said where they look get everything
+        for (auto& c : sessions.Sessions()->sessions) {
+            if (c->GetID() != except && c->GetRoom() == room && c->getSocket().is_open() && !viewing.contains(c->GetID()))
+                c->Post(package);
+        }
+        for (auto& [id, member] : remoteMembers) {
+            if (id != except && member.room == room && !viewing.contains(id))
+                member.link->Queue(member.client, package);
+        }
+
+        for (IDType id : audience) {
+            if (id != except && viewing.contains(id))
+                this->SendTo(id, package);
+        }
     }
 
     void TCPServer::HandleAccept(TCPConnection::pointer& connection, const boost::system::error_code& ec) {
-        if (!ec) {
-            // Reading handshake package
-            std::string handshakeBuff;
-            boost::system::error_code e;
-            read_until(connection->getSocket(), dynamic_buffer(handshakeBuff), ";", e);
-
-            if (e) {
-                LOG_LINE("Reading handshake request failed.");
+        // Turned away, the client tries again with whoever listens next
+        if (draining)
+            return;
+
+        if (!ec)
+            this->ReadHandshake(connection);
+        else
+            LOG_LINE(ec.what());
+
+        this->StartAccept();
+    }
+
+    void TCPServer::ReadHandshake(const TCPConnection::pointer &connection) {
+        auto attempt = std::make_shared<HandshakeAttempt>(IOContext);
+        attempt->deadline.expires_after(std::chrono::milliseconds(Settings::HANDSHAKE_TIMEOUT_MS));
+        attempt->deadline.async_wait([attempt, connection](const boost::system::error_code& ec) {
+            if (ec == error::operation_aborted || attempt->read)
+                return;
+
+            LOG_LINE("Handshake request timed out.");
+            boost::system::error_code ignored;
+            connection->getSocket().close(ignored);
+        });
+
+        async_read_until(connection->getSocket(), dynamic_buffer(attempt->request, BufferPool::MaxFrameSize()), ";",
+            [this, attempt, connection = connection](const boost::system::error_code& ec, std::size_t length) mutable {
+                attempt->read = true;
+                attempt->deadline.cancel();
+                if (ec) {
+                    LOG_LINE("Reading handshake request failed.");
+                    return;
+                }
+                // Whoever takes over from us gets it
+                if (draining) {
+                    boost::system::error_code closed;
+                    connection->getSocket().close(closed);
+                    return;
+                }
+
+                // Whatever a client gets past the checks costs it the connection, not everybody theirs
+                attempt->request.resize(length);
+                try {
+                    this->HandleHandshake(connection, std::move(attempt->request));
+                }
+                catch (const nlohmann::json::exception& e) {
+                    LOG_LINE("Handshake failed: " << e.what());
+                    boost::system::error_code closed;
+                    connection->getSocket().close(closed);
+                }
+            });
+    }
+
+    void TCPServer::HandleHandshake(TCPConnection::pointer &connection, std::string handshakeBuff) {
+        // Parsing trimmed handshake buffer (removed ';')
+        handshakeBuff.pop_back();
+        std::optional<Package> parsed;
+        try {
+            parsed = Package::Parse(handshakeBuff);
+        }
+        catch (const nlohmann::json::exception&) { }
+        if (!parsed || !IsValidHandshake(parsed->getBody().data)) {
+            LOG_LINE("Malformed handshake request refused.");
+            violations.invalid[static_cast<std::size_t>(Package::Type::Handshake)]++;
+            return;
+        }
+        const Package& handshakePkg = *parsed;
+        const auto& request = handshakePkg.getBody().data;
+
+        // Another node opening a relay link
+        if (request.contains("peer")) {
+            this->AcceptPeer(connection, request);
+            return;
+        }
+
+        connection->SetUsername(request.at("username"));
+        connection->SetRoom(request.value("room", std::string(Settings::DEFAULT_ROOM)));
+
+        if (!federation.Owns(connection->GetRoom())) {
+            const std::size_t owner = federation.Owner(connection->GetRoom());
+            if (request.value("redirect", false))
+                this->Redirect(connection, owner);
+            else
+                this->RelayClient(connection, owner, handshakePkg);
+            return;
+        }
+
+        // A client back after losing its connection keeps its ID and only gets what it missed
+        std::vector<Package> missed;
+        bool resumed = false;
+        auto secret = request.find("session");
+        auto previous = request.find("id");
+        if (secret != request.end() && secret->is_number_unsigned() && previous != request.end() && previous->is_number_integer())
+            resumed = this->Resume(connection, *previous, *secret, request.value("lastSequence", std::uint64_t{0}), missed);
+
+        if (!resumed) {
+            const auto allocated = sessions.Allocate();
+            if (!allocated) {
+                LOG_LINE("Out of connection IDs, refused user '" << connection->GetUsername() << "'");
+                boost::system::error_code ec;
+                connection->getSocket().close(ec);
                 return;
             }
+            connection->SetID(*allocated);
+            resumable[connection->GetID()] = Session{ RandomSecret(), connection, std::nullopt };
+        }
+        recorder.Record(connection->GetID(), CaptureRecord::Event::Package, handshakeBuff);
 
-            // Parsing trimmed handshake buffer (removed ';')
-            Package handshakePkg = Package::Parse(handshakeBuff.substr(0, handshakeBuff.size() - 1));
-            connection->SetUsername(handshakePkg.getBody().data.at("username"));
+        const IDType id = connection->GetID();
+        nlohmann::json data;
+        data["id"] = id;
+        data["udpToken"] = connection->GetDatagramToken();
+        data["session"] = resumable.at(id).secret;
+        data["roomSequence"] = this->ReplayOf(connection->GetRoom()).Last();
+        if (resumed) {
+            data["resumed"] = true;
+            data["received"] = connection->GetReceived(); // The client sends again what came after
+        }
+        if (roomState)
+            roomState->Describe(connection->GetRoom(), connection->GetID(), data);
 
-            nlohmann::json data;
-            data["id"] = connection->GetID();
-            Package handshakeResponse {
-                Package::Header{ data.dump().length(), Package::Type::Handshake, Settings::SERVER_ID },
-                Package::Body{ data }
-            };
+        // Agreeing on compression. Both sides need the same dictionary for it.
+        if (compression && request.value("dictionary", 0) == Compressor::DictionaryID())
+            data["compression"] = connection->EnableCompression(request.value("compression", std::vector<std::string>{}));
+
+        Package handshakeResponse {
+            Package::Header{ data.dump().length(), Package::Type::Handshake, Settings::SERVER_ID },
+            Package::Body{ data }
+        };
 
-            // Sending back user's ID.
-            write(connection->getSocket(), buffer(Package::CompressToJSON(handshakeResponse).dump() + ";"), e);
+        // Registered before the response is out, so nothing broadcast meanwhile passes the client by
+        sessions.Register(connection);
+
+        // Sending back user's ID.
+        connection->Greet(Package::CompressToJSON(handshakeResponse).dump() + ";",
+            [this, connection, id, resumed](const boost::system::error_code& ec) {
+                if (!ec)
+                    return this->StartSession(connection, resumed);
 
-            if (e) {
                 LOG_LINE("Sending handshake response failed.");
+                // Unless the session went on over another connection meanwhile
+                if (this->sessions.Find(id) != connection)
+                    return;
+                this->Suspend(connection);
+                if (!resumed) {
+                    this->resumable.erase(id);
+                    this->sessions.Release(id);
+                }
+            }
+        );
+
+        // Queued ahead of anything broadcast from now on, sent once the response is
+        if (resumed) {
+            LOG_LINE("User '" << connection->GetUsername() << "' resumed the session, id: " << id << ", " << missed.size() << " packages missed");
+            for (const auto& package : missed)
+                connection->Post(package);
+        }
+        else {
+            LOG_LINE("Connection established with user " << "\'" << connection->GetUsername() << "\', id: " << id);
+            if (roomState && request.value("loadCanvas", false)) {
+                for (const auto& package : roomState->Snapshot(connection->GetRoom()))
+                    connection->Post(package);
+            }
+            for (const auto& package : this->ChatHistory(connection->GetRoom()))
+                connection->Post(package);
+        }
+    }
+
+    void TCPServer::StartSession(const TCPConnection::pointer &connection, bool resumed) {
+        connection->Start(
+            [this, connection](const Package &package) {
+                if (this->Admit(*connection, package))
+                    this->HandlePackage(connection->GetID(), connection->GetRoom(), package);
+            },
+            [this, connection]() {
+                // Both a failed read and a failed write report it, only the first one counts.
+                // Neither does once the session went on over another connection.
+                if (this->sessions.Find(connection->GetID()) != connection)
+                    return;
+
+                this->Suspend(connection);
+                // A client that sends garbage doesn't get to resume
+                if (connection->IsMalformed())
+                    violations.invalid.back()++;
+                if (connection->IsClosedByPeer() || connection->IsMalformed())
+                    this->EndSession(connection->GetID());
+                else
+                    LOG_LINE("User '" << connection->GetUsername() << "' lost the connection, the session is kept for resuming");
+            }
+        );
+
+        // Broadcasting new connection
+        if (!resumed)
+            this->BroadcastMessage("User " + connection->GetUsername() + " has joined.\n", 0, connection->GetRoom());
+    }
+
+    void TCPServer::HandlePackage(IDType sender, const std::string &room, const Package &package) {
+        // Measurements, not part of what happens in the room
+        if (package.getHeader().type == Package::Type::Ping || package.getHeader().type == Package::Type::Pong) {
+            if (this->IsValid(package))
+                this->HandlePing(sender, package);
+            else
+                violations.invalid[static_cast<std::size_t>(package.getHeader().type)]++;
+            return;
+        }
+        // Read the board and say where to send what, don't change it
+        if (package.getHeader().type == Package::Type::TileRequest || package.getHeader().type == Package::Type::Viewport) {
+            if (!this->IsValid(package))
+                violations.invalid[static_cast<std::size_t>(package.getHeader().type)]++;
+            else if (package.getHeader().type == Package::Type::TileRequest)
+                this->SendTiles(sender, room, package);
+            else if (roomState) {
+                viewing.insert(sender);
+                roomState->View(room, sender, package.getBody().data);
+            }
+            return;
+        }
+
+        if (recorder.IsOpen())
+            recorder.Record(sender, CaptureRecord::Event::Package, Package::CompressToJSON(package).dump());
+
+        const auto type = static_cast<std::size_t>(package.getHeader().type);
+        std::vector<IDType> audience;
+        if (!this->IsValid(package) || (roomState && !roomState->Apply(room, package, audience))) {
+            violations.invalid[std::min(type, Package::TYPE_COUNT - 1)]++;
+            return;
+        }
+
+        if (const std::uint64_t sentAt = package.getHeader().timestamp; sentAt && (
+                package.getHeader().type == Package::Type::BoardUpdate || package.getHeader().type == Package::Type::BoardOperation)) {
+            const std::uint64_t now = MonotonicMicroseconds();
+            strokeLatency.Record(now > sentAt ? now - sentAt : 0);
+        }
+
+        if (package.getHeader().type == Package::Type::TextMessage) {
+            // Transforming the message. Adding sender username then broadcasting.
+            this->BroadcastMessage(package.getBody().data.at("message"), sender, room);
+        }
+        else if (package.getHeader().type == Package::Type::CursorUpdate)
+            this->UpdateCursor(sender, room, package);
+        else if (package.getHeader().type == Package::Type::StrokePreview)
+            this->BroadcastToEachExcept(package, sender, room);
+        else
+            this->BroadcastToAudience(this->ReplayOf(room).Push(package), sender, room, audience);
+    }
+
+    bool TCPServer::Admit(TCPConnection &connection, const Package &package) {
+        const auto type = package.getHeader().type;
+        const auto index = static_cast<std::size_t>(type);
+        if (index >= Package::TYPE_COUNT) {
+            violations.invalid.back()++;
+            return false;
+        }
+
+        RateLimiter& limiter = connection.GetLimiter();
+        if (type == Package::Type::BoardUpdate || type == Package::Type::BoardOperation || type == Package::Type::TileRequest) {
+            if (!limiter.Take(type, true)) {
+                connection.PauseReading(limiter.Wait(type));
+                violations.deferred[index]++;
+            }
+            return true;
+        }
+
+        if (limiter.Take(type))
+            return true;
+
+        violations.dropped[index]++;
+        return false;
+    }
+
+    bool TCPServer::Admit(RemoteMember &member, const Package &package) {
+        const auto type = package.getHeader().type;
+        const auto index = static_cast<std::size_t>(type);
+        if (index >= Package::TYPE_COUNT) {
+            violations.invalid.back()++;
+            return false;
+        }
+
+        if (member.limiter.Take(type))
+            return true;
+
+        violations.dropped[index]++;
+        return false;
+    }
+
+    bool TCPServer::IsValidHandshake(const nlohmann::json &request) {
+        if (!request.is_object())
+            return false;
+
+        auto optional = [&request](const char* key, auto&& check) {
+            auto field = request.find(key);
+            return field == request.end() || check(*field);
+        };
+        auto isString = [](const nlohmann::json& v) { return v.is_string(); };
+        auto isBool = [](const nlohmann::json& v) { return v.is_boolean(); };
+        auto isUnsigned = [](const nlohmann::json& v) { return v.is_number_unsigned(); };
+        auto isInteger = [](const nlohmann::json& v) { return v.is_number_integer(); };
+        auto isCodecs = [](const nlohmann::json& v) {
+            return v.is_array() && std::all_of(v.begin(), v.end(), [](const auto& codec) { return codec.is_string(); });
+        };
+
+        if (!optional("dictionary", isInteger) || !optional("compression", isCodecs))
+            return false;
+        if (request.contains("peer"))
+            return request.at("peer").is_number_unsigned() && optional("secret", isString);
+
+        // The session and the ID it is for are only looked at if they are numbers
+        return request.contains("username") && request.at("username").is_string() &&
+               optional("room", isString) && optional("redirect", isBool) && optional("loadCanvas", isBool) &&
+               optional("lastSequence", isUnsigned);
+    }
+
+    bool TCPServer::IsValid(const Package &package) const {
+        const auto& data = package.getBody().data;
+        try {
+            switch (package.getHeader().type) {
+                case Package::Type::TextMessage: {
+                    const auto& message = data.at("message");
+                    return message.is_string() && message.get_ref<const std::string&>().size() <= Settings::CHAT_MESSAGE_MAX_SIZE;
+                }
+                case Package::Type::CursorUpdate: {
+                    const auto& position = data.at("position");
+                    return position.is_array() && position.size() == 2 && position[0].is_number() && position[1].is_number();
+                }
+                case Package::Type::BoardUpdate: {
+                    // Everything else of a stroke is read by the room state, points are relayed to clients as they are
+                    const auto& points = data.at("points");
+                    return points.is_array() && points.size() == data.at("numberOfPoints") &&
+                           std::all_of(points.begin(), points.end(), [](const auto& p) {
+                               return p.is_array() && p.size() == 2 && p[0].is_number() && p[1].is_number();
+                           });
+                }
+                case Package::Type::BoardOperation:
+                case Package::Type::StrokePreview:
+                    return data.is_object();
+                case Package::Type::Ping:
+                case Package::Type::Pong:
+                    return data.at("sent").is_number_unsigned();
+                case Package::Type::Viewport: {
+                    const auto& view = data.at("view");
+                    return view.is_array() && view.size() == 4 &&
+                           std::all_of(view.begin(), view.end(), [](const auto& v) { return v.is_number(); });
+                }
+                case Package::Type::TileRequest: {
+                    // Tiles themselves are read by the room state
+                    const auto& tiles = data.at("tiles");
+                    const auto& resident = data.at("resident");
+                    return tiles.is_array() && tiles.size() <= Settings::TILE_REQUEST_MAX &&
+                           resident.is_array() && resident.size() <= Settings::TILE_REQUEST_MAX;
+                }
+                default:
+                    // Handshakes, relays and the rest never come from a client once it's in
+                    return false;
+            }
+        }
+        catch (const nlohmann::json::exception&) {
+            return false;
+        }
+    }
+
+    void TCPServer::HandlePing(IDType sender, const Package &package) {
+        const std::uint64_t now = MonotonicMicroseconds();
+        const auto& data = package.getBody().data;
+
+        if (package.getHeader().type == Package::Type::Ping) {
+            nlohmann::json pong = data;
+            pong["time"] = now; // Lets the client estimate our clock
+            this->SendTo(sender, Package {
+                Package::Header{ pong.dump().size(), Package::Type::Pong, Settings::SERVER_ID, 0, now },
+                Package::Body{ pong }
+            });
+            return;
+        }
+
+        // Answer to one of ours, 'sent' is our clock
+        const std::uint64_t sent = data.at("sent");
+        if (sent <= now)
+            roundTrip.Record(now - sent);
+    }
+
+    void TCPServer::SendTiles(IDType sender, const std::string &room, const Package &request) const {
+        if (roomState) {
+            for (const auto& package : roomState->Page(room, sender, request.getBody().data))
+                this->SendTo(sender, package);
+        }
+
+        // Everything of these tiles is with the client once this arrives
+        nlohmann::json data;
+        data["tiles"] = request.getBody().data.at("tiles");
+        this->SendTo(sender, Package {
+            Package::Header{ data.dump().size(), Package::Type::TileLoaded, Settings::SERVER_ID },
+            Package::Body{ data }
+        });
+    }
+
+    void TCPServer::SendTo(IDType id, const Package &package) const {
+        if (auto connection = sessions.Find(id)) {
+            connection->Post(package);
+            return;
+        }
+        if (auto member = remoteMembers.find(id); member != remoteMembers.end())
+            member->second.link->Queue(member->second.client, package);
+    }
+
+    void TCPServer::SendNotices() {
+        if (!roomState)
+            return;
+
+        std::vector<std::pair<IDType, Package>> notices;
+        roomState->Notices(notices);
+        for (const auto& [member, package] : notices)
+            this->SendTo(member, package);
+    }
+
+    void TCPServer::LeaveRoomState(IDType id, const std::string &room) {
+        viewing.erase(id);
+        if (roomState)
+            roomState->Leave(room, id);
+    }
+
+    void TCPServer::PingClients() {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastPing < std::chrono::milliseconds(Settings::PING_INTERVAL_MS))
+            return;
+        lastPing = now;
+
+        nlohmann::json data;
+        data["sent"] = MonotonicMicroseconds();
+        const Package ping {
+            Package::Header{ data.dump().size(), Package::Type::Ping, Settings::SERVER_ID, 0, data["sent"] },
+            Package::Body{ data }
+        };
+        for (auto& c : sessions.Sessions()->sessions)
+            c->Post(ping);
+    }
+
+    const LatencyHistogram &TCPServer::GetRoundTrip() const { return roundTrip; }
+    const LatencyHistogram &TCPServer::GetStrokeLatency() const { return strokeLatency; }
+
+    void TCPServer::LogLatency() {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastLatencyLog < std::chrono::milliseconds(Settings::LATENCY_LOG_MS))
+            return;
+        lastLatencyLog = now;
+
+        const std::uint64_t samples = roundTrip.Count() + strokeLatency.Count() + datagramsReceived;
+        if (samples == latencyLogged)
+            return;
+        latencyLogged = samples;
+
+        LOG_LINE("Round trips: " << roundTrip.Summary());
+        LOG_LINE("Strokes, sender to server: " << strokeLatency.Summary());
+        LOG_LINE("Datagrams: " << datagramsReceived << " received, " << datagramsLost << " lost");
+    }
+
+    bool TCPServer::Resume(TCPConnection::pointer &connection, IDType id, std::uint64_t secret, std::uint64_t lastSequence, std::vector<Package> &missed) {
+        auto session = resumable.find(id);
+        if (session == resumable.end() || !SecretsEqual(session->second.secret, secret))
+            return false;
+
+        // Too far behind to catch up, the client starts over with a new session
+        TCPConnection::pointer previous = session->second.connection;
+        if (previous->GetRoom() != connection->GetRoom() || !this->ReplayOf(previous->GetRoom()).Since(lastSequence, id, missed))
+            return false;
+
+        // The old connection may still look fine from here, the client knows better
+        if (sessions.Find(id) == previous) {
+            this->Suspend(previous);
+            boost::system::error_code ec;
+            previous->getSocket().close(ec);
+        }
+
+        connection->SetID(id);
+        connection->SetUsername(previous->GetUsername());
+        connection->SetReceived(previous->GetReceived());
+        session->second.connection = connection;
+        session->second.expires.reset();
+        return true;
+    }
+
+    void TCPServer::Suspend(const TCPConnection::pointer &connection) {
+        const IDType id = connection->GetID();
+        sessions.Unregister(id, false);
+        recorder.Record(id, CaptureRecord::Event::Disconnect);
+
+        if (cursors.erase(id))
+            cursorsLeft.emplace_back(id, connection->GetRoom());
+
+        resumable.at(id).expires = std::chrono::steady_clock::now() + std::chrono::milliseconds(Settings::SESSION_RESUME_MS);
+    }
+
+    void TCPServer::EndSession(IDType id) {
+        auto session = resumable.find(id);
+        if (session == resumable.end())
+            return;
+
+        const TCPConnection::pointer connection = session->second.connection;
+        resumable.erase(session);
+        sessions.Release(id);
+        this->LeaveRoomState(id, connection->GetRoom());
+
+        this->BroadcastMessage("User " + connection->GetUsername() + " has left.\n", 0, connection->GetRoom());
+        LOG_LINE("User " + connection->GetUsername() + " has left.\n");
+    }
+
+    void TCPServer::ExpireSessions() {
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<IDType> expired;
+        for (const auto& [id, session] : resumable) {
+            if (session.expires && *session.expires <= now)
+                expired.push_back(id);
+        }
+
+        for (IDType id : expired)
+            this->EndSession(id);
+    }
+
+    ReplayBuffer &TCPServer::ReplayOf(const std::string &room) {
+        return replays.try_emplace(room, Settings::REPLAY_BUFFER_PACKAGES).first->second;
+    }
+
+    std::uint64_t TCPServer::Violations::Total() const {
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < Package::TYPE_COUNT; i++)
+            total += invalid[i] + dropped[i] + deferred[i];
+        return total;
+    }
+
+    const TCPServer::Violations &TCPServer::GetViolations() const { return violations; }
+
+    void TCPServer::LogViolations() {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastViolationsLog < std::chrono::milliseconds(Settings::VIOLATIONS_LOG_MS))
+            return;
+        lastViolationsLog = now;
+
+        const std::uint64_t total = violations.Total();
+        if (total == violationsLogged)
+            return;
+        violationsLogged = total;
+
+        std::ostringstream line;
+        for (std::size_t i = 0; i < Package::TYPE_COUNT; i++) {
+            if (violations.invalid[i] + violations.dropped[i] + violations.deferred[i] == 0)
+                continue;
+            line << " type " << i << ": " << violations.invalid[i] << " invalid, "
+                 << violations.dropped[i] << " dropped, " << violations.deferred[i] << " deferred;";
+        }
+        LOG_LINE("Refused packages since the start:" << line.str());
+    }
+
+    void TCPServer::StartReceiveDatagram() {
+        datagramSocket.async_receive_from(
+            buffer(datagramBuffer), datagramSender,
+            boost::bind(
+                &TCPServer::HandleDatagram,
+                this,
+                placeholders::error,
+                placeholders::bytes_transferred
+            )
+        );
+    }
+
+    void TCPServer::HandleDatagram(const boost::system::error_code &ec, std::size_t size) {
+        if (ec == error::operation_aborted)
+            return;
+
+        Datagram datagram;
+        if (!ec && UnpackDatagram(datagramBuffer.data(), size, datagram)) {
+            auto connection = sessions.Find(datagram.connection);
+
+            // Unknown or spoofed senders are dropped silently, there is nobody to report to
+            if (connection && connection->GetDatagramToken() == datagram.token) {
+                connection->SetDatagramEndpoint(datagramSender);
+
+                // Empty payload only registers the endpoint
+                if (!datagram.payload.empty()) {
+                    try {
+                        Package package = Package::Parse(datagram.payload);
+                        const auto type = package.getHeader().type;
+                        const auto index = static_cast<std::size_t>(type);
+                        if (IsTransient(type)) {
+                            datagramsReceived++;
+                            datagramsLost += connection->Gap(type, package.getHeader().sequence);
+                        }
+
+                        if (!IsTransient(type))
+                            violations.invalid[std::min(index, Package::TYPE_COUNT - 1)]++;
+                        else if (!connection->GetLimiter().Take(type))
+                            violations.dropped[index]++;
+                        else if (!this->IsValid(package))
+                            violations.invalid[index]++;
+                        else {
+                            if (recorder.IsOpen())
+                                recorder.Record(connection->GetID(), CaptureRecord::Event::Package, datagram.payload);
+
+                            if (type == Package::Type::CursorUpdate)
+                                this->UpdateCursor(connection->GetID(), connection->GetRoom(), package);
+                            else
+                                this->RelayDatagram(package, connection->GetID(), connection->GetRoom());
+                        }
+                    }
+                    catch (const nlohmann::json::exception&) { }
+                }
+            }
+        }
+
+        this->StartReceiveDatagram();
+    }
+
+    void TCPServer::RelayDatagram(const Package &package, IDType sender, const std::string &room) {
+        // Sender comes from the token check, not from what the client wrote in the header.
+        // Its sequence number and timestamp stay, receivers measure loss and latency with them.
+        Package relayed = package;
+        relayed.SetSenderID(sender);
+        auto datagram = std::make_shared<std::string>(
+            PackDatagram(Settings::SERVER_ID, 0, Package::CompressToJSON(relayed).dump())
+        );
+        if (datagram->size() > Settings::DATAGRAM_MAX_SIZE)
+            return;
+
+        for (auto& c : sessions.Sessions()->sessions) {
+            if (c->GetID() == sender || c->GetRoom() != room || !c->GetDatagramEndpoint())
+                continue;
+
+            datagramSocket.async_send_to(
+                buffer(*datagram), *c->GetDatagramEndpoint(),
+                [datagram](const boost::system::error_code&, std::size_t) { }
+            );
+        }
+    }
+
+    void TCPServer::UpdateCursor(IDType connection, const std::string &room, const Package &package) {
+        const auto& position = package.getBody().data.at("position");
+        cursors[connection] = Cursor{ position.at(0).get<float>(), position.at(1).get<float>(), true, room };
+    }
+
+    void TCPServer::StartPresenceTick() {
+        presenceTimer.expires_after(tick);
+        presenceTimer.async_wait([this](const boost::system::error_code& ec) {
+            if (ec == error::operation_aborted || draining)
                 return;
+
+            this->BroadcastPresence();
+            this->SendNotices();
+            this->PingClients();
+            this->LogViolations();
+            this->LogLatency();
+            this->ExpireSessions();
+            this->StartPresenceTick();
+        });
+    }
+
+    void TCPServer::BroadcastPresence() {
+        // Cursors that didn't move aren't sent, except for a periodic refresh
+        // so that newcomers and clients that lost a datagram catch up
+        const auto now = std::chrono::steady_clock::now();
+        const bool refresh = now - lastPresenceRefresh >= std::chrono::milliseconds(Settings::PRESENCE_REFRESH_MS);
+        if (refresh)
+            lastPresenceRefresh = now;
+
+        // One decimal is plenty for a cursor and keeps the frame short
+        auto rounded = [](float v) { return std::round(v * 10.0) / 10.0; };
+
+        // Frames are built per room, every room only sees its own cursors
+        struct RoomFrames {
+            nlohmann::json data = { { "cursors", nlohmann::json::array() } };
+            std::vector<std::shared_ptr<std::string>> frames;
+
+            void Flush() {
+                if (data["cursors"].empty() && !data.contains("left"))
+                    return;
+
+                Package frame {
+                    Package::Header{ data.dump().size(), Package::Type::CursorUpdate, Settings::SERVER_ID },
+                    Package::Body{ data }
+                };
+                frames.push_back(std::make_shared<std::string>(
+                    PackDatagram(Settings::SERVER_ID, 0, Package::CompressToJSON(frame).dump())
+                ));
+
+                data = { { "cursors", nlohmann::json::array() } };
+            }
+        };
+        std::unordered_map<std::string, RoomFrames> rooms;
+
+        for (const auto& [id, room] : cursorsLeft)
+            rooms[room].data["left"].push_back(id);
+        cursorsLeft.clear();
+
+        for (auto& [id, cursor] : cursors) {
+            if (!cursor.changed && !refresh)
+                continue;
+
+            auto& room = rooms[cursor.room];
+            room.data["cursors"].push_back({ id, rounded(cursor.x), rounded(cursor.y) });
+            cursor.changed = false;
+
+            if (room.data["cursors"].size() == Settings::CURSORS_PER_DATAGRAM)
+                room.Flush();
+        }
+        for (auto& [name, room] : rooms)
+            room.Flush();
+
+        for (auto& c : sessions.Sessions()->sessions) {
+            auto room = rooms.find(c->GetRoom());
+            if (room == rooms.end() || !c->GetDatagramEndpoint())
+                continue;
+
+            for (const auto& frame : room->second.frames) {
+                datagramSocket.async_send_to(
+                    buffer(*frame), *c->GetDatagramEndpoint(),
+                    [frame](const boost::system::error_code&, std::size_t) { }
+                );
+            }
+        }
+    }
+
+    void TCPServer::Redirect(TCPConnection::pointer &connection, std::size_t node) {
+        nlohmann::json data;
+        data["redirect"] = federation.Address(node);
+
+        Package response {
+            Package::Header{ data.dump().length(), Package::Type::Handshake, Settings::SERVER_ID },
+            Package::Body{ data }
+        };
+
+        connection->Greet(Package::CompressToJSON(response).dump() + ";", [connection](const boost::system::error_code&) {
+            boost::system::error_code ec;
+            connection->getSocket().shutdown(tcp::socket::shutdown_both, ec);
+            connection->getSocket().close(ec);
+        });
+
+        LOG_LINE("Redirected user '" << connection->GetUsername() << "' to " << federation.Address(node));
+    }
+
+    void TCPServer::RelayClient(TCPConnection::pointer &connection, std::size_t node, const Package &handshake) {
+        // The owner answers the handshake itself, its response comes back over the link.
+        // Our ID only names the client on the link.
+        const auto allocated = sessions.Allocate();
+        if (!allocated) {
+            LOG_LINE("Out of connection IDs, refused to relay user '" << connection->GetUsername() << "'");
+            boost::system::error_code ec;
+            connection->getSocket().close(ec);
+            return;
+        }
+        connection->SetID(*allocated);
+        const IDType client = connection->GetID();
+        auto link = this->LinkTo(node);
+        relayedClients[client] = RelayedClient{ connection, node };
+        link->Queue(client, handshake);
+
+        // Limited here already, so a flood doesn't reach the link shared with other clients
+        connection->Start(
+            [this, link, client, connection = connection.get()](const Package &package) {
+                if (this->Admit(*connection, package))
+                    link->Queue(client, package);
+            },
+            [this, link, client]() {
+                if (this->relayedClients.erase(client)) {
+                    link->QueueLeave(client);
+                    this->sessions.Release(client);
+                }
+            }
+        );
+
+        LOG_LINE("Relaying user '" << connection->GetUsername() << "' to " << federation.Address(node));
+    }
+
+    std::shared_ptr<RelayLink> TCPServer::LinkTo(std::size_t node) {
+        if (auto it = outgoingLinks.find(node); it != outgoingLinks.end())
+            return it->second;
+
+        // Opened in the background, the clients' packages queue up on the link meanwhile
+        auto link = std::make_shared<RelayLink>(TCPConnection::Create(IOContext));
+        link->SetLinked(false);
+        outgoingLinks[node] = link;
+
+        // Same handshake as clients do, marked as coming from a peer
+        nlohmann::json data;
+        data["peer"] = federation.Self();
+        data["secret"] = federation.Secret();
+        data["compression"] = compression ? Compressor::SupportedCodecs() : std::vector<std::string>{};
+        data["dictionary"] = Compressor::DictionaryID();
+        Package handshake {
+            Package::Header{ data.dump().length(), Package::Type::Handshake, Settings::SERVER_ID },
+            Package::Body{ data }
+        };
+
+        auto attempt = std::make_shared<LinkAttempt>(IOContext);
+        attempt->request = Package::CompressToJSON(handshake).dump() + ";";
+        attempt->deadline.expires_after(std::chrono::milliseconds(Settings::RELAY_LINK_TIMEOUT_MS));
+        attempt->deadline.async_wait([attempt, link](const boost::system::error_code& ec) {
+            if (ec == error::operation_aborted || link->IsLinked())
+                return;
+
+            boost::system::error_code ignored;
+            attempt->resolver.cancel();
+            link->GetConnection()->getSocket().close(ignored);
+        });
+
+        attempt->resolver.async_resolve(federation.Host(node), federation.Port(node),
+            [this, node, link, attempt](const boost::system::error_code& ec, const tcp::resolver::results_type& endpoints) {
+                if (ec)
+                    return this->FailLink(node, link, ec);
+
+                async_connect(link->GetConnection()->getSocket(), endpoints,
+                    [this, node, link, attempt](const boost::system::error_code& ec, const tcp::endpoint&) {
+                        if (ec)
+                            return this->FailLink(node, link, ec);
+
+                        async_write(link->GetConnection()->getSocket(), buffer(attempt->request),
+                            [this, node, link, attempt](const boost::system::error_code& ec, std::size_t) {
+                                if (ec)
+                                    return this->FailLink(node, link, ec);
+
+                                async_read_until(link->GetConnection()->getSocket(), dynamic_buffer(attempt->response, BufferPool::MaxFrameSize()), ";",
+                                    [this, node, link, attempt](const boost::system::error_code& ec, std::size_t) {
+                                        attempt->deadline.cancel();
+                                        if (ec)
+                                            return this->FailLink(node, link, ec);
+                                        this->CompleteLink(node, link, attempt->response);
+                                    });
+                            });
+                    });
+            });
+
+        return link;
+    }
+
+    void TCPServer::CompleteLink(std::size_t node, const std::shared_ptr<RelayLink> &link, std::string response) {
+        response.pop_back();
+        std::optional<Package> parsed;
+        try {
+            parsed = Package::Parse(response);
+        }
+        catch (const nlohmann::json::exception&) { }
+        if (!parsed)
+            return this->FailLink(node, link, error::invalid_argument);
+
+        const auto& connection = link->GetConnection();
+        auto codecs = parsed->getBody().data.value("compression", nlohmann::json::array());
+        if (codecs.is_array() && !codecs.empty())
+            connection->EnableCompression(codecs.get<std::vector<std::string>>());
+
+        connection->Start(
+            [this, node](const Package &package) {
+                this->HandleRelayFromOwner(node, package);
+            },
+            [this, node]() {
+                this->DropOutgoingLink(node);
+            }
+        );
+
+        link->SetLinked(true);
+        link->Flush();
+        LOG_LINE("Linked to node " << federation.Address(node));
+    }
+
+    void TCPServer::FailLink(std::size_t node, const std::shared_ptr<RelayLink> &link, const boost::system::error_code &ec) {
+        LOG_LINE("Can't link to node " << federation.Address(node) << ": " << ec.message());
+        boost::system::error_code ignored;
+        link->GetConnection()->getSocket().close(ignored);
+
+        // A link given up on already may have been replaced meanwhile
+        if (auto it = outgoingLinks.find(node); it != outgoingLinks.end() && it->second == link)
+            this->DropOutgoingLink(node);
+    }
+
+    void TCPServer::HandleRelayFromOwner(std::size_t node, const Package &package) {
+        if (package.getHeader().type != Package::Type::Relay)
+            return;
+
+        try {
+            for (const auto& frame : package.getBody().data.at("frames")) {
+                auto relayed = relayedClients.find(frame.at(0).get<IDType>());
+                if (relayed == relayedClients.end())
+                    continue;
+
+                // The owner refused the client
+                if (frame.at(1).is_null()) {
+                    boost::system::error_code ec;
+                    relayed->second.connection->getSocket().close(ec);
+                    continue;
+                }
+
+                relayed->second.connection->Post(Package::FromJSON(frame.at(1)));
             }
+        }
+        catch (const nlohmann::json::exception&) {
+            LOG_LINE("Malformed relay from node " << federation.Address(node) << ", dropping the link");
+            violations.invalid[static_cast<std::size_t>(Package::Type::Relay)]++;
+            if (auto link = outgoingLinks.find(node); link != outgoingLinks.end()) {
+                boost::system::error_code ec;
+                link->second->GetConnection()->getSocket().close(ec);
+            }
+        }
+    }
+
+    void TCPServer::DropOutgoingLink(std::size_t node) {
+        if (!outgoingLinks.erase(node))
+            return;
+
+        LOG_LINE("Lost the link to node " << federation.Address(node));
 
-            LOG_LINE("Connection established with user " << "\'" << connection->GetUsername() << "\', id: " << connection->GetID());
+        // Clients reconnect and get linked again
+        boost::system::error_code ec;
+        for (auto& [id, relayed] : relayedClients) {
+            if (relayed.node == node)
+                relayed.connection->getSocket().close(ec);
+        }
+    }
+
+    void TCPServer::AcceptPeer(TCPConnection::pointer &connection, const nlohmann::json &request) {
+        // Anyone can claim to be a node, only ours know the secret
+        const std::size_t peer = request.at("peer");
+        if (!federation.IsPeer(peer, request.value("secret", std::string()))) {
+            boost::system::error_code ec;
+            const auto remote = connection->getSocket().remote_endpoint(ec);
+            LOG_LINE("Refused a link from " << remote << " claiming to be node " << peer);
+            violations.invalid[static_cast<std::size_t>(Package::Type::Handshake)]++;
+            connection->getSocket().close(ec);
+            return;
+        }
+
+        nlohmann::json data;
+        data["id"] = Settings::SERVER_ID;
+        if (compression && request.value("dictionary", 0) == Compressor::DictionaryID())
+            data["compression"] = connection->EnableCompression(request.value("compression", std::vector<std::string>{}));
 
-            connection->Start(
-                [this](const Package &package) {
-                    if (package.getHeader().type == Package::Type::TextMessage) {
-                        // Transforming the message. Adding sender username then broadcasting.
-                        this->BroadcastMessage(package.getBody().data.at("message"), package.getHeader().senderID);
+        Package response {
+            Package::Header{ data.dump().length(), Package::Type::Handshake, Settings::SERVER_ID },
+            Package::Body{ data }
+        };
+
+        connection->Greet(Package::CompressToJSON(response).dump() + ";",
+            [this, connection, peer](const boost::system::error_code& ec) {
+                if (ec) {
+                    LOG_LINE("Sending peer handshake response failed.");
+                    return;
+                }
+
+                auto link = std::make_shared<RelayLink>(connection);
+                this->incomingLinks.push_back(link);
+
+                connection->Start(
+                    [this, link](const Package &package) {
+                        this->HandleRelayFromPeer(link, package);
+                    },
+                    [this, link]() {
+                        this->DropIncomingLink(link);
                     }
-                    else
-                        this->BroadcastToEachExcept(package, package.getHeader().senderID);
-                },
-                [this, connection]() {
-                    if (this->connections.erase(
-                        std::find_if(
-                            connections.begin(), connections.end(),
-                            [this, connection](const TCPConnection::pointer& c) {
-                                return c->GetID() == connection->GetID();
-                            }
-                        )
-                    ) != connections.end()) {
-                        this->BroadcastMessage("User " + connection->GetUsername() + " has left.\n", 0);
-                        LOG_LINE("User " + connection->GetUsername() + " has left.\n");
+                );
+
+                LOG_LINE("Node " << this->federation.Address(peer) << " linked");
+            }
+        );
+    }
+
+    void TCPServer::HandleRelayFromPeer(const std::shared_ptr<RelayLink> &link, const Package &package) {
+        if (package.getHeader().type != Package::Type::Relay)
+            return;
+
+        try {
+            for (const auto& frame : package.getBody().data.at("frames")) {
+                const IDType client = frame.at(0);
+                auto member = link->members.find(client);
+
+                if (frame.at(1).is_null()) {
+                    if (member != link->members.end()) {
+                        this->RemoveRemoteMember(member->second);
+                        link->members.erase(member);
                     }
+                    continue;
+                }
+
+                Package relayed = Package::FromJSON(frame.at(1));
+                if (relayed.getHeader().type == Package::Type::Handshake) {
+                    if (member == link->members.end())
+                        this->JoinRemoteMember(link, client, relayed);
+                    continue;
+                }
+
+                // Charged to the client it comes from, not to the link it shares with others
+                if (member != link->members.end() && this->Admit(remoteMembers.at(member->second), relayed)) {
+                    relayed.SetSenderID(member->second);
+                    this->HandlePackage(member->second, remoteMembers.at(member->second).room, relayed);
                 }
+            }
+        }
+        catch (const nlohmann::json::exception&) {
+            LOG_LINE("Malformed relay from a node, dropping the link");
+            violations.invalid[static_cast<std::size_t>(Package::Type::Relay)]++;
+            boost::system::error_code ec;
+            link->GetConnection()->getSocket().close(ec);
+        }
+    }
+
+    void TCPServer::JoinRemoteMember(const std::shared_ptr<RelayLink> &link, IDType client, const Package &handshake) {
+        const auto& request = handshake.getBody().data;
+        if (!IsValidHandshake(request) || request.contains("peer")) {
+            LOG_LINE("Malformed relayed handshake refused.");
+            violations.invalid[static_cast<std::size_t>(Package::Type::Handshake)]++;
+            link->QueueLeave(client);
+            return;
+        }
+
+        const auto allocated = sessions.Allocate();
+        if (!allocated) {
+            LOG_LINE("Out of connection IDs, refused relayed user '" << request.at("username").get<std::string>() << "'");
+            link->QueueLeave(client);
+            return;
+        }
+
+        const IDType id = *allocated;
+        const std::string room = request.value("room", std::string(Settings::DEFAULT_ROOM));
+
+        recorder.Record(id, CaptureRecord::Event::Package, Package::CompressToJSON(handshake).dump());
+        remoteMembers[id] = RemoteMember{ link, client, request.at("username"), room, RateLimiter{} };
+        link->members[client] = id;
+
+        // Relayed clients stay on plain TCP: no compression, no datagrams
+        nlohmann::json data;
+        data["id"] = id;
+        if (roomState)
+            roomState->Describe(room, id, data);
+        link->Queue(client, Package {
+            Package::Header{ data.dump().length(), Package::Type::Handshake, Settings::SERVER_ID },
+            Package::Body{ data }
+        });
+
+        if (roomState && request.value("loadCanvas", false)) {
+            for (const auto& package : roomState->Snapshot(room))
+                link->Queue(client, package);
+        }
+        for (const auto& package : this->ChatHistory(room))
+            link->Queue(client, package);
+
+        LOG_LINE("Relayed user '" << remoteMembers[id].username << "' joined, id: " << id);
+        this->BroadcastMessage("User " + remoteMembers[id].username + " has joined.\n", 0, room);
+    }
+
+    void TCPServer::RemoveRemoteMember(IDType id) {
+        auto member = remoteMembers.find(id);
+        if (member == remoteMembers.end())
+            return;
+
+        recorder.Record(id, CaptureRecord::Event::Disconnect);
+        if (cursors.erase(id))
+            cursorsLeft.emplace_back(id, member->second.room);
+
+        const std::string username = member->second.username;
+        const std::string room = member->second.room;
+        remoteMembers.erase(member);
+        sessions.Release(id);
+        this->LeaveRoomState(id, room);
+
+        this->BroadcastMessage("User " + username + " has left.\n", 0, room);
+        LOG_LINE("User " + username + " has left.\n");
+    }
+
+    void TCPServer::DropIncomingLink(const std::shared_ptr<RelayLink> &link) {
+        auto it = std::find(incomingLinks.begin(), incomingLinks.end(), link);
+        if (it == incomingLinks.end())
+            return;
+        incomingLinks.erase(it);
+
+        for (const auto& [client, id] : link->members)
+            this->RemoveRemoteMember(id);
+        link->members.clear();
+    }
+
+    void TCPServer::StartRelayFlush() {
+        relayTimer.expires_after(std::chrono::milliseconds(Settings::RELAY_FLUSH_MS));
+        relayTimer.async_wait([this](const boost::system::error_code& ec) {
+            if (ec == error::operation_aborted)
+                return;
+
+            for (auto& [node, link] : outgoingLinks)
+                link->Flush();
+            for (auto& link : incomingLinks)
+                link->Flush();
+
+            this->StartRelayFlush();
+        });
+    }
+
+    std::vector<Package> TCPServer::ChatHistory(const std::string &room) const {
+        std::vector<Package> packages;
+        auto history = chatHistory.find(room);
+        if (history == chatHistory.end())
+            return packages;
+
+        packages.reserve(history->second.Size());
+        for (std::size_t i = 0; i < history->second.Size(); i++) {
+            nlohmann::json data;
+            data["message"] = history->second[i];
+            packages.emplace_back(
+                Package::Header{ data.dump().size(), Package::Type::TextMessage, Settings::SERVER_ID },
+                Package::Body{ data }
             );
+        }
+        return packages;
+    }
+
+    void TCPServer::Quiesce() {
+        draining = true;
+        presenceTimer.cancel();
+
+        boost::system::error_code ec;
+        acceptor.cancel(ec);
+        datagramSocket.cancel(ec);
+        for (auto& c : sessions.Sessions()->sessions)
+            c->DropIncoming();
 
-            // Broadcasting new connection
-            this->BroadcastMessage("User " + connection->GetUsername() + " has joined.\n", 0);
+        if (roomState)
+            roomState->Persist();
+    }
+
+    void TCPServer::Flush(std::chrono::steady_clock::time_point deadline) {
+        std::size_t open = 0;
+        boost::system::error_code ec;
+        for (auto& c : sessions.Sessions()->sessions) {
+            if (!c->getSocket().is_open())
+                continue;
+
+            // The client closes its end once it read everything up to our FIN
+            open++;
+            if (c->IsFlushed())
+                c->getSocket().shutdown(tcp::socket::shutdown_send, ec);
         }
-        else
-            LOG_LINE(ec.what());
 
-        this->StartAccept();
+        if (open == 0 || std::chrono::steady_clock::now() >= deadline) {
+            if (open > 0)
+                LOG_LINE("Drain timed out, " << open << " clients still connected");
+            this->Stop();
+            return;
+        }
+
+        drainTimer.expires_after(tick);
+        drainTimer.async_wait([this, deadline](const boost::system::error_code& ec) {
+            if (!ec)
+                this->Flush(deadline);
+        });
     }
 
-}
\ No newline at end of file
+    nlohmann::json TCPServer::Export() {
+        nlohmann::json state;
+        state["registry"] = sessions.Export();
+
+        state["sessions"] = nlohmann::json::array();
+        for (const auto& [id, session] : resumable) {
+            const TCPConnection::pointer& connection = session.connection;
+            nlohmann::json entry;
+            entry["id"] = id;
+            entry["secret"] = session.secret;
+            entry["username"] = connection->GetUsername();
+            entry["room"] = connection->GetRoom();
+            entry["received"] = connection->GetReceived();
+            state["sessions"].push_back(std::move(entry));
+        }
+
+        state["replays"] = nlohmann::json::object();
+        for (const auto& [room, replay] : replays)
+            state["replays"][room] = replay.Export();
+
+        state["chat"] = nlohmann::json::object();
+        for (const auto& [room, history] : chatHistory) {
+            auto& messages = state["chat"][room] = nlohmann::json::array();
+            for (std::size_t i = 0; i < history.Size(); i++)
+                messages.push_back(std::string(history[i]));
+        }
+        return state;
+    }
+
+    void TCPServer::Import(const nlohmann::json &state) {
+        sessions.Import(state.at("registry"));
+
+        // Stand-ins for the connections left behind, Resume takes what it needs from them
+        const auto expires = std::chrono::steady_clock::now() + std::chrono::milliseconds(Settings::SESSION_RESUME_MS);
+        for (const auto& entry : state.at("sessions")) {
+            TCPConnection::pointer connection = TCPConnection::Create(IOContext);
+            connection->SetID(entry.at("id").get<IDType>());
+            connection->SetUsername(entry.at("username"));
+            connection->SetRoom(entry.at("room"));
+            connection->SetReceived(entry.at("received"));
+            resumable[entry.at("id").get<IDType>()] = Session{ entry.at("secret"), connection, expires };
+        }
+
+        for (const auto& [room, replay] : state.at("replays").items())
+            this->ReplayOf(room).Import(replay);
+
+        for (const auto& [room, messages] : state.at("chat").items()) {
+            auto& history = chatHistory.try_emplace(room, Settings::CHAT_HISTORY_MESSAGES, Settings::CHAT_HISTORY_BYTES).first->second;
+            for (const auto& message : messages)
+                history.Add(message.get_ref<const std::string&>());
+        }
+
+        LOG_LINE("Took over " << resumable.size() << " sessions in " << replays.size() << " rooms");
+    }
+}
@@ -0,0 +1,111 @@
+#include "ReplaySession.h"
+
+#include "utils/log.h"
+
+namespace Replay {
+    ReplaySession::ReplaySession(std::string address, std::string port, double speed)
+        : address(std::move(address)), port(std::move(port)), speed(speed)
+    { }
+
+    ReplaySession::~ReplaySession() {
+        while (!bots.empty())
+            this->Disconnect(bots.begin()->first);
+    }
+
+    bool ReplaySession::Run(const std::string &capturePath) {
+        SessionReader reader;
+        if (!reader.Open(capturePath)) {
+            LOG_LINE("Can't read capture " << capturePath);
+            return false;
+        }
+
+        using clock = std::chrono::steady_clock;
+        const auto start = clock::now();
+
+        CaptureRecord record;
+        while (reader.Next(record)) {
+            if (speed > 0.0) {
+                auto due = std::chrono::microseconds(static_cast<std::int64_t>(record.timestamp / speed));
+                std::this_thread::sleep_until(start + due);
+            }
+
+            if (record.event == CaptureRecord::Event::Disconnect) {
+                this->Disconnect(record.connection);
+                continue;
+            }
+
+            Package package = Package::Parse(record.payload);
+            if (package.getHeader().type == Package::Type::Handshake)
+                this->Connect(record.connection, package);
+            else
+                this->Send(record.connection, package);
+        }
+
+        const auto elapsed = std::chrono::duration<double>(clock::now() - start);
+
+        // Let the broadcasts still in flight reach the bots
+        std::size_t inFlight, settled = 0;
+        do {
+            inFlight = settled;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            settled = 0;
+            for (const auto& [id, bot] : bots)
+                settled += bot->received;
+        } while (settled != inFlight);
+        received += settled;
+
+        LOG_LINE("Replayed " << sent << " packages in " << elapsed.count() << "s, bots received " << received);
+        return true;
+    }
+
+    void ReplaySession::Connect(IDType recordedID, const Package &handshake) {
+        auto bot = std::make_unique<Bot>();
+        bot->client.SetUsername(handshake.getBody().data.value("username", "bot"));
+        bot->client.SetRoom(handshake.getBody().data.value("room", std::string(Settings::DEFAULT_ROOM)));
+
+        if (auto ec = bot->client.ConnectTo(address, port)) {
+            LOG_LINE("Bot " << recordedID << " can't connect: " << ec.message());
+            return;
+        }
+        if (!bot->client.Handshake()) {
+            LOG_LINE("Bot " << recordedID << " handshake failed");
+            return;
+        }
+
+        Bot* raw = bot.get();
+        raw->client.pkgRecCallback = [raw](const Package&) { raw->received++; };
+        raw->receiveThread = std::thread([raw] { raw->client.StartReading(); });
+
+        bots[recordedID] = std::move(bot);
+    }
+
+    void ReplaySession::Disconnect(IDType recordedID) {
+        auto it = bots.find(recordedID);
+        if (it == bots.end())
+            return;
+
+        Bot& bot = *it->second;
+        bot.client.Stop();
+        if (bot.receiveThread.joinable())
+            bot.receiveThread.join();
+
+        received += bot.received;
+        bots.erase(it);
+    }
+
+    void ReplaySession::Send(IDType recordedID, const Package &package) {
+        auto it = bots.find(recordedID);
+        if (it == bots.end())
+            return;
+
+        // The server knows the bot by the ID it issued, not the recorded one
+        const auto& header = package.getHeader();
+        Package rewritten {
+            Package::Header{ header.bodySize, header.type, (IDType)it->second->client.GetID() },
+            package.getBody()
+        };
+
+        if (it->second->client.SendPackage(rewritten))
+            sent++;
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef REPLAYSESSION_H
+#define REPLAYSESSION_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "networking/SessionCapture.h"
+#include "networking/TCPClient.h"
+
+namespace Replay {
+    using namespace Core::Networking;
+
+    // Loopback client standing in for one of the recorded connections.
+    struct Bot {
+        TCPClient client;
+        std::thread receiveThread;
+        std::atomic<std::size_t> received = 0;
+    };
+
+    // Feeds a capture to a server through loopback bots,
+    // preserving the recorded gaps between packages.
+    class ReplaySession {
+    public:
+        // speed: 1 is real time, 2 twice as fast, 0 as fast as possible.
+        ReplaySession(std::string address, std::string port, double speed);
+        ~ReplaySession();
+
+        bool Run(const std::string& capturePath);
+
+    private:
+        void Connect(IDType recordedID, const Package& handshake);
+        void Disconnect(IDType recordedID);
+        void Send(IDType recordedID, const Package& package);
+
+        std::string address, port;
+        double speed;
+
+        std::map<IDType, std::unique_ptr<Bot>> bots; // By connection ID from the capture
+
+        std::size_t sent = 0;
+        std::size_t received = 0; // Of the bots that are gone already
+    };
+}
+
+#endif //REPLAYSESSION_H
@@ -0,0 +1,46 @@
+#include "ReplaySession.h"
+#include "networking/TCPServer.h"
+#include "utils/log.h"
+
+#include <cstring>
+
+// Usage: DrawingRoomReplay <capture> [--speed <factor>] [--address <host>] [--port <port>]
+// Speed 1 replays in real time, 0 as fast as possible.
+// Without --address an in-process server is started on loopback.
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        LOG_LINE("Usage: " << argv[0] << " <capture> [--speed <factor>] [--address <host>] [--port <port>]");
+        return 1;
+    }
+
+    std::string capture = argv[1];
+    std::string address, port = "1499";
+    double speed = 1.0;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--speed") == 0) speed = std::stod(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--address") == 0) address = argv[i + 1];
+        else if (std::strcmp(argv[i], "--port") == 0) port = argv[i + 1];
+    }
+
+    std::unique_ptr<Core::Networking::TCPServer> server;
+    std::thread serverThread;
+    if (address.empty()) {
+        address = "127.0.0.1";
+        server = std::make_unique<Core::Networking::TCPServer>(std::stoi(port));
+        serverThread = std::thread([&server] { server->Run(); });
+    }
+
+    bool ok;
+    {
+        Replay::ReplaySession session(address, port, speed);
+        ok = session.Run(capture);
+    }
+
+    if (server) {
+        server->Stop();
+        serverThread.join();
+    }
+
+    return ok ? 0 : 1;
+}
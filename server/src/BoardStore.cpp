@@ -0,0 +1,478 @@
+#include "BoardStore.h"
+
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <unordered_set>
+
+#include "canvas/CanvasFile.h"
+#include "utils/log.h"
+#include "utils/settings.h"
+
+namespace Server {
+    using Core::Canvas::Operation;
+    using Core::Canvas::OperationLog;
+
+    BoardStore::BoardStore(std::string directory, std::size_t workers) : directory(std::move(directory)) {
+        std::error_code ec;
+        if (!this->directory.empty() && !std::filesystem::create_directories(this->directory, ec) && ec)
+            LOG_LINE("Can't create snapshot directory " << this->directory << ": " << ec.message());
+
+        if (workers > 0 && !this->directory.empty())
+            this->workers = std::make_unique<boost::asio::thread_pool>(workers);
+    }
+
+    BoardStore::~BoardStore() {
+        this->SaveAll();
+        if (workers)
+            workers->join();
+    }
+
+    static bool IsFinite(Core::Rendering::Point p) { return std::isfinite(p.x) && std::isfinite(p.y); }
+
+    bool BoardStore::Apply(const std::string &room, const Package &package, std::vector<IDType> &audience) {
+        const auto type = package.getHeader().type;
+        if (type != Package::Type::BoardUpdate && type != Package::Type::BoardOperation)
+            return true;
+
+        Operation op;
+        try {
+            // Decode takes the smaller of the two, a mismatch means a broken client.
+            // It throws on a point that isn't two numbers.
+            if (type == Package::Type::BoardUpdate) {
+                const auto& data = package.getBody().data;
+                const std::size_t numberOfPoints = data.at("numberOfPoints");
+                if (numberOfPoints != data.at("points").size() || numberOfPoints > Settings::POINTS_PER_PACKAGE)
+                    return false;
+            }
+            op = OperationLog::Decode(package);
+        }
+        catch (const nlohmann::json::exception&) {
+            return false;
+        }
+
+        Room& state = this->GetRoom(room);
+        if (!this->IsValid(state, op))
+            return false;
+
+        if (op.type == Operation::Type::Add) {
+            auto& next = state.nextSequence[op.stroke.client];
+            next = std::max(next, op.stroke.sequence + 1);
+        }
+
+        // Both grow or move the stroke
+        const bool moves = op.type == Operation::Type::Add || op.type == Operation::Type::Transform;
+        const auto stroke = op.stroke;
+        std::optional<TileRange> before;
+        if (const auto* line = state.board.Find(stroke))
+            before = Core::Canvas::TilesOf(*line);
+
+        // Whatever can't apply is refused above, false here only means nothing visible changed
+        state.board.Apply(std::move(op));
+        if (moves)
+            this->Reindex(state, stroke);
+        if (const auto* line = state.board.Find(stroke))
+            this->Route(state, package.getHeader().senderID, before, Core::Canvas::TilesOf(*line), audience);
+        state.board.CompactTombstones();
+
+        if (++state.unsaved >= Settings::SNAPSHOT_EVERY_OPS)
+            this->Save(room, state);
+        return true;
+    }
+
+    void BoardStore::Describe(const std::string &room, IDType client, nlohmann::json &response) {
+        const Room& state = this->GetRoom(room);
+        if (auto next = state.nextSequence.find(client); next != state.nextSequence.end())
+            response["sequence"] = next->second;
+    }
+
+    std::vector<Package> BoardStore::Snapshot(const std::string &room) {
+        std::vector<Package> packages;
+        for (const auto& op : this->GetRoom(room).board.Snapshot()) {
+            auto encoded = OperationLog::Encode(op);
+            packages.insert(packages.end(), std::make_move_iterator(encoded.begin()), std::make_move_iterator(encoded.end()));
+        }
+        return packages;
+    }
+
+    void BoardStore::View(const std::string &room, IDType member, const nlohmann::json &view) {
+        const auto& rect = view.at("view");
+        const TileRange range = Core::Canvas::ViewTiles({ rect.at(0), rect.at(1) }, { rect.at(2), rect.at(3) });
+
+        Room& state = this->GetRoom(room);
+        auto [it, added] = state.viewers.try_emplace(member);
+        Viewer& viewer = it->second;
+        if (!added && !viewer.everywhere && viewer.view == range)
+            return;
+
+        auto eachTile = [](const TileRange& r, auto&& f) {
+            for (std::int32_t y = r.min.y; y <= r.max.y; y++) {
+                for (std::int32_t x = r.min.x; x <= r.max.x; x++)
+                    f(Tile{ x, y });
+            }
+        };
+
+        if (viewer.everywhere)
+            state.everywhere.erase(member);
+        else if (!added)
+            eachTile(viewer.view, [&](Tile tile) { std::erase(state.seeing[tile], member); });
+
+        viewer.view = range;
+        viewer.everywhere = range.Count() > Settings::TILE_REQUEST_MAX;
+        if (viewer.everywhere)
+            state.everywhere.insert(member);
+        else
+            eachTile(range, [&](Tile tile) { state.seeing[tile].push_back(member); });
+    }
+
+    void BoardStore::Leave(const std::string &room, IDType member) {
+        auto state = rooms.find(room);
+        if (state == rooms.end())
+            return;
+
+        auto viewer = state->second.viewers.find(member);
+        if (viewer == state->second.viewers.end())
+            return;
+
+        this->Hold(state->second, member, {});
+        if (!viewer->second.everywhere) {
+            const TileRange& view = viewer->second.view;
+            for (std::int32_t y = view.min.y; y <= view.max.y; y++) {
+                for (std::int32_t x = view.min.x; x <= view.max.x; x++)
+                    std::erase(state->second.seeing[{ x, y }], member);
+            }
+        }
+        state->second.everywhere.erase(member);
+        state->second.viewers.erase(viewer);
+    }
+
+    void BoardStore::Notices(std::vector<std::pair<IDType, Package>> &out) {
+        for (auto& [name, room] : rooms) {
+            for (auto& [id, viewer] : room.viewers) {
+                if (viewer.dirty.empty())
+                    continue;
+
+                nlohmann::json data;
+                data["tiles"] = nlohmann::json::array();
+                for (const Tile& tile : viewer.dirty)
+                    data["tiles"].push_back(Core::Canvas::ToJSON(tile));
+                viewer.dirty.clear();
+
+                out.emplace_back(id, Package {
+                    Package::Header{ data.dump().size(), Package::Type::TileDirty, Settings::SERVER_ID },
+                    Package::Body{ data }
+                });
+            }
+        }
+    }
+
+    std::vector<Package> BoardStore::Page(const std::string &room, IDType member, const nlohmann::json &request) {
+        using Core::Rendering::StrokeID;
+
+        std::unordered_set<Tile> wanted, resident;
+        try {
+            for (const auto& tile : request.at("tiles"))
+                wanted.insert(Core::Canvas::TileFromJSON(tile));
+            for (const auto& tile : request.at("resident"))
+                resident.insert(Core::Canvas::TileFromJSON(tile));
+        }
+        catch (const nlohmann::json::exception&) {
+            return {};
+        }
+
+        Room& state = this->GetRoom(room);
+
+        // Dirty tiles are about to go, whatever the client says. Those asked for are up to date after this.
+        if (auto viewer = state.viewers.find(member); viewer != state.viewers.end()) {
+            for (const Tile& tile : viewer->second.dirty)
+                resident.erase(tile);
+            for (const Tile& tile : wanted)
+                viewer->second.dirty.erase(tile);
+
+            std::unordered_set<Tile> held = resident;
+            held.insert(wanted.begin(), wanted.end());
+            this->Hold(state, member, std::move(held));
+        }
+
+        std::unordered_set<StrokeID> seen;
+        std::vector<Operation> ops;
+
+        // Strokes of a resident tile are with the client already
+        auto collect = [&](std::vector<StrokeID>& strokes) {
+            std::erase_if(strokes, [&state](StrokeID id) {
+                if (state.board.Find(id))
+                    return false;
+                state.indexed.erase(id); // Compacted since
+                return true;
+            });
+
+            for (StrokeID id : strokes) {
+                if (!seen.insert(id).second)
+                    continue;
+                const auto range = state.indexed.find(id);
+                if (range == state.indexed.end() ||
+                    !Core::Canvas::Touches(range->second, wanted) || Core::Canvas::Touches(range->second, resident))
+                    continue;
+                OperationLog::RebuildStroke(Core::Rendering::Line(*state.board.Find(id)), state.board.GetStamps(id), ops);
+            }
+        };
+
+        for (const Tile& tile : wanted) {
+            if (auto it = state.tiles.find(tile); it != state.tiles.end())
+                collect(it->second);
+        }
+        collect(state.huge);
+
+        // Marked so the client can tell them from live changes
+        std::vector<Package> packages;
+        for (const auto& op : ops) {
+            for (const auto& encoded : OperationLog::Encode(op)) {
+                nlohmann::json data = encoded.getBody().data;
+                data["paged"] = true;
+                packages.emplace_back(
+                    Package::Header{ data.dump().size(), encoded.getHeader().type, encoded.getHeader().senderID },
+                    Package::Body{ std::move(data) }
+                );
+            }
+        }
+        return packages;
+    }
+
+    void BoardStore::SaveAll() {
+        for (auto& [name, room] : rooms) {
+            if (room.unsaved > 0)
+                this->Save(name, room);
+        }
+    }
+
+    void BoardStore::Persist() {
+        if (directory.empty())
+            return;
+
+        for (auto& [name, room] : rooms) {
+            std::lock_guard lock(room.snapshots->mutex);
+            if (room.unsaved == 0 && room.snapshots->written == room.snapshots->made)
+                continue;
+
+            // Workers that come late find it written already
+            const std::uint64_t made = ++room.snapshots->made;
+            if (Core::Canvas::SaveCanvas(this->PathOf(name), room.board)) {
+                room.snapshots->written = made;
+                room.unsaved = 0;
+            }
+        }
+    }
+
+    bool BoardStore::IsValid(const Room &room, const Operation &op) {
+        switch (op.type) {
+            // Only strokes the room has, or had until recently. We see every stroke before anyone
+            // can erase or move it, others would only pile up waiting for it on every client.
+            case Operation::Type::Remove:
+            case Operation::Type::Restore:
+                return room.board.Find(op.stroke) || room.board.IsCompacted(op.stroke);
+            case Operation::Type::Transform:
+                return (room.board.Find(op.stroke) || room.board.IsCompacted(op.stroke)) && IsFinite(op.translation);
+            case Operation::Type::Add:
+                break;
+            default:
+                return false;
+        }
+
+        // Strokes are only ever drawn by their author, others just erase or move them
+        if (op.stroke.client != op.author)
+            return false;
+
+        const auto& c = op.color;
+        if (!std::isfinite(c.r) || !std::isfinite(c.g) || !std::isfinite(c.b) || !std::isfinite(c.a))
+            return false;
+        if (!(op.thickness >= 0.f && op.thickness <= Settings::STROKE_MAX_THICKNESS))
+            return false;
+
+        // Only the first chunk starts a stroke. Its author sends each stroke once, in order, so one we don't have
+        // below its next sequence number was erased and compacted meanwhile. Sent again after a reconnect,
+        // it doesn't come back, however long ago it was forgotten.
+        const Core::Rendering::Line* line = room.board.Find(op.stroke);
+        if (!line) {
+            auto next = room.nextSequence.find(op.stroke.client);
+            if (op.firstPoint != 0 || (next != room.nextSequence.end() && op.stroke.sequence < next->second))
+                return false;
+        }
+
+        // Chunks of a stroke add up, not one of them may take it over the limit
+        const std::size_t existing = line ? line->points.size() : 0;
+        if (op.totalPoints > Settings::STROKE_MAX_POINTS || existing + op.points.size() > Settings::STROKE_MAX_POINTS)
+            return false;
+
+        return std::all_of(op.points.begin(), op.points.end(), IsFinite);
+    }
+
+    void BoardStore::Reindex(Room &room, Core::Rendering::StrokeID id) {
+        using Core::Canvas::TileRange;
+
+        auto spans = [](const TileRange& range) {
+            return static_cast<std::int64_t>(range.max.x) - range.min.x >= Settings::TILE_INDEX_MAX_SPAN ||
+                   static_cast<std::int64_t>(range.max.y) - range.min.y >= Settings::TILE_INDEX_MAX_SPAN;
+        };
+        auto eachTile = [&room, &spans](const TileRange& range, auto&& f) {
+            if (spans(range)) {
+                f(room.huge);
+                return;
+            }
+            for (std::int32_t y = range.min.y; y <= range.max.y; y++) {
+                for (std::int32_t x = range.min.x; x <= range.max.x; x++)
+                    f(room.tiles[{ x, y }]);
+            }
+        };
+
+        const Core::Rendering::Line* line = room.board.Find(id);
+        auto old = room.indexed.find(id);
+        if (line && old != room.indexed.end() && old->second == Core::Canvas::TilesOf(*line))
+            return;
+
+        if (old != room.indexed.end()) {
+            eachTile(old->second, [id](auto& strokes) { std::erase(strokes, id); });
+            room.indexed.erase(old);
+        }
+        if (!line)
+            return;
+
+        const TileRange range = Core::Canvas::TilesOf(*line);
+        eachTile(range, [id](auto& strokes) { strokes.push_back(id); });
+        room.indexed.emplace(id, range);
+    }
+
+    void BoardStore::Route(Room &room, IDType sender, const std::optional<TileRange> &before, const TileRange &after, std::vector<IDType> &audience) {
+        if (room.viewers.empty())
+            return;
+
+        std::unordered_set<IDType> candidates(room.everywhere.begin(), room.everywhere.end());
+        auto gather = [&room, &candidates](const TileRange& range) {
+            if (range.Count() > Settings::TILE_REQUEST_MAX) {
+                for (const auto& [id, viewer] : room.viewers)
+                    candidates.insert(id);
+                return;
+            }
+            for (std::int32_t y = range.min.y; y <= range.max.y; y++) {
+                for (std::int32_t x = range.min.x; x <= range.max.x; x++) {
+                    for (const auto* index : { &room.seeing, &room.holding }) {
+                        if (auto it = index->find({ x, y }); it != index->end())
+                            candidates.insert(it->second.begin(), it->second.end());
+                    }
+                }
+            }
+        };
+        gather(after);
+        if (before && *before != after)
+            gather(*before);
+
+        for (IDType id : candidates) {
+            if (id == sender)
+                continue;
+
+            Viewer& viewer = room.viewers.at(id);
+            const bool sees = viewer.everywhere || viewer.view.Intersects(after) || (before && viewer.view.Intersects(*before));
+
+            // Tiles on its screen are never evicted, so only those surely have the stroke. A change
+            // to a stroke it doesn't have is no use, it has to fetch the whole stroke instead.
+            bool has = !before;
+            if (before && viewer.everywhere)
+                has = Core::Canvas::Touches(*before, viewer.held);
+            else if (before && viewer.view.Intersects(*before)) {
+                const TileRange shown{
+                    { std::max(before->min.x, viewer.view.min.x), std::max(before->min.y, viewer.view.min.y) },
+                    { std::min(before->max.x, viewer.view.max.x), std::min(before->max.y, viewer.view.max.y) }
+                };
+                has = Core::Canvas::Touches(shown, viewer.held);
+            }
+
+            if (sees && has) {
+                audience.push_back(id);
+                continue;
+            }
+
+            std::vector<Tile> stale;
+            for (const Tile& tile : viewer.held) {
+                if (after.Contains(tile) || (before && before->Contains(tile)))
+                    stale.push_back(tile);
+            }
+            for (const Tile& tile : stale) {
+                viewer.held.erase(tile);
+                viewer.dirty.insert(tile);
+                std::erase(room.holding[tile], id);
+            }
+        }
+    }
+
+    void BoardStore::Hold(Room &room, IDType member, std::unordered_set<Tile> &&tiles) {
+        Viewer& viewer = room.viewers.at(member);
+        for (const Tile& tile : viewer.held)
+            std::erase(room.holding[tile], member);
+
+        viewer.held = std::move(tiles);
+        for (const Tile& tile : viewer.held)
+            room.holding[tile].push_back(member);
+    }
+
+    BoardStore::Room &BoardStore::GetRoom(const std::string &name) {
+        auto [it, created] = rooms.try_emplace(name);
+        Room& room = it->second;
+        if (!created || directory.empty())
+            return room;
+
+        // First time the room is used since the start, pick up its saved board
+        Core::Canvas::MappedCanvas saved;
+        if (!std::filesystem::exists(this->PathOf(name)) || !saved.Open(this->PathOf(name)))
+            return room;
+
+        room.board.ApplyBatch(saved.ToOperations());
+        for (const auto& line : room.board.GetLines()) {
+            auto& next = room.nextSequence[line.id.client];
+            next = std::max(next, line.id.sequence + 1);
+            this->Reindex(room, line.id);
+        }
+
+        LOG_LINE("Loaded board of room '" << name << "', " << room.board.GetLines().size() << " strokes");
+        return room;
+    }
+
+    void BoardStore::Save(const std::string &name, Room &room) {
+        if (directory.empty()) {
+            room.unsaved = 0;
+            return;
+        }
+
+        if (!workers) {
+            if (Core::Canvas::SaveCanvas(this->PathOf(name), room.board))
+                room.unsaved = 0;
+            return;
+        }
+
+        // A failed save is tried again with the next one
+        boost::asio::post(*workers, [path = this->PathOf(name), board = room.board, snapshots = room.snapshots, made = ++room.snapshots->made] {
+            std::lock_guard lock(snapshots->mutex);
+            if (made > snapshots->written && Core::Canvas::SaveCanvas(path, board))
+                snapshots->written = made;
+        });
+        room.unsaved = 0;
+    }
+
+    std::string BoardStore::PathOf(const std::string &name) const {
+        // Room names come from clients, anything but plain characters is escaped
+        static constexpr char HEX[] = "0123456789abcdef";
+        std::string file;
+        for (unsigned char c : name) {
+            if (std::isalnum(c) || c == '-' || c == '_')
+                file += static_cast<char>(c);
+            else {
+                file += '%';
+                file += HEX[c >> 4];
+                file += HEX[c & 0xF];
+            }
+        }
+
+        return (std::filesystem::path(directory) / (file + ".canvas")).string();
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef BOARDSTORE_H
+#define BOARDSTORE_H
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "canvas/OperationLog.h"
+#include "canvas/Tile.h"
+#include "networking/RoomState.h"
+
+namespace Server {
+    using namespace Core::Networking;
+
+    // Boards of the rooms this server owns, kept up to date from the operations going through it.
+    // Newcomers that ask for the canvas get it from here, clients paging the board get its tiles.
+    // Given a directory, boards are saved there as canvas files (see CanvasFile.h) and picked up
+    // again after a restart. With workers, boards are copied and written by those instead of the
+    // thread that applies operations.
+    // Also knows where every paging client looks and which tiles it holds, and sends it live changes
+    // only of what it looks at. Of changes elsewhere it only hears which of its tiles went out of date.
+    class BoardStore : public RoomState {
+    public:
+        explicit BoardStore(std::string directory = {}, std::size_t workers = 0);
+        ~BoardStore() override;
+
+        bool Apply(const std::string& room, const Package& package, std::vector<IDType>& audience) override;
+        void View(const std::string& room, IDType member, const nlohmann::json& view) override;
+        void Leave(const std::string& room, IDType member) override;
+        void Notices(std::vector<std::pair<IDType, Package>>& out) override;
+        void Describe(const std::string& room, IDType client, nlohmann::json& response) override;
+        std::vector<Package> Snapshot(const std::string& room) override;
+        std::vector<Package> Page(const std::string& room, IDType member, const nlohmann::json& request) override;
+        // Writes on this thread, saves still queued for the workers included
+        void Persist() override;
+
+        // Saves every board changed since its last save
+        void SaveAll();
+
+    private:
+        using Tile = Core::Canvas::Tile;
+        using TileRange = Core::Canvas::TileRange;
+
+        struct Viewer {
+            TileRange view{}; // On screen and around it, see ViewTiles
+            bool everywhere = false; // Looks at more tiles than a request may ask for
+            std::unordered_set<Tile> held; // As of its last request
+            std::unordered_set<Tile> dirty; // Held ones that changed since, not told yet
+        };
+
+        // Saves of one room in the order they were made, a worker that comes late writes nothing
+        struct Snapshots {
+            std::mutex mutex;
+            std::uint64_t made = 0; // By the thread that applies operations
+            std::uint64_t written = 0; // By the workers, under the mutex
+        };
+
+        struct Room {
+            Core::Canvas::OperationLog board;
+            // First stroke sequence number nobody used yet, by author.
+            // IDs start over when the server restarts, saved strokes keep theirs.
+            std::unordered_map<IDType, std::uint32_t> nextSequence;
+            std::size_t unsaved = 0; // Operations since the last save
+            std::shared_ptr<Snapshots> snapshots = std::make_shared<Snapshots>();
+
+            // Strokes by the world tiles they touch, for Page. Strokes spanning more than
+            // TILE_INDEX_MAX_SPAN tiles on a side are all in 'huge' instead.
+            std::unordered_map<Core::Canvas::Tile, std::vector<Core::Rendering::StrokeID>> tiles;
+            std::vector<Core::Rendering::StrokeID> huge;
+            std::unordered_map<Core::Rendering::StrokeID, TileRange> indexed; // Where each stroke is in the index
+
+            // Members that reported a view, indexed by the tiles they look at and the tiles they hold
+            std::unordered_map<IDType, Viewer> viewers;
+            std::unordered_map<Tile, std::vector<IDType>> seeing, holding;
+            std::unordered_set<IDType> everywhere;
+        };
+
+        // Limits from settings and rules of who may do what, checked before anything is applied
+        static bool IsValid(const Room& room, const Core::Canvas::Operation& op);
+
+        // Moves the stroke in the tile index to where it is on the board now
+        static void Reindex(Room& room, Core::Rendering::StrokeID id);
+
+        // Who gets a change of a stroke that was on 'before' (none if it's new) and is on 'after' now.
+        // Viewers that look there and have the stroke get it, others that hold tiles there hear they're dirty.
+        static void Route(Room& room, IDType sender, const std::optional<TileRange>& before, const TileRange& after, std::vector<IDType>& audience);
+        static void Hold(Room& room, IDType member, std::unordered_set<Tile>&& tiles);
+
+        Room& GetRoom(const std::string& name);
+        void Save(const std::string& name, Room& room);
+        std::string PathOf(const std::string& name) const;
+
+        std::string directory;
+        std::unordered_map<std::string, Room> rooms;
+        std::unique_ptr<boost::asio::thread_pool> workers;
+    };
+}
+
+#endif //BOARDSTORE_H
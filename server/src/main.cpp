@@ -1,6 +1,54 @@
 #include "networking/TCPServer.h"
+#include "BoardStore.h"
+
+#include <string>
+
+#include "utils/log.h"
+
+int main(int argc, char** argv) {
+    // --config <file> and --<setting> <value> for any setting of it, see ServerConfig.h:
+    // --port <port>, 1499 by default
+    // --snapshots <directory> keeps boards of the rooms there between restarts, --workers <count> writes them
+    // --record <path> saves the session for the replay tool
+    // --nodes <host:port,...> --node <index> --secret <secret> joins a federation of servers
+    // --handover <path> lets the next server started with it take over from this one without downtime
+    // --max-frame <bytes>, --compression on|off, --tick <ms>, --queue-high/--queue-low <packages> can be
+    // changed in the file while the server runs, SIGHUP makes it read the file again
+    nlohmann::json overrides = nlohmann::json::object();
+    std::string path;
+    Core::Networking::ServerConfig config;
+    if (!Core::Networking::ServerConfig::FromArguments(argc, argv, overrides, path) || !config.Load(path, overrides))
+        return 1;
+
+    // A server waiting there hands over its clients, otherwise this one starts from scratch
+    std::optional<Core::Networking::Handover::Inherited> inherited;
+    if (!config.handover.empty())
+        inherited = Core::Networking::Handover::Request(config.handover);
+
+    Server::BoardStore boards(config.snapshots, config.workers);
+    Core::Networking::TCPServer server(config.port, std::move(inherited));
+    server.SetRoomState(&boards);
+    server.Configure(config);
+
+    if (!config.handover.empty() && !server.AwaitSuccessor(config.handover))
+        return 1;
+
+    if (!config.record.empty() && !server.StartRecording(config.record))
+        return 1;
+    if (!config.nodes.empty() && !server.Federate(config.nodes, config.node, config.secret))
+        return 1;
+
+    // The command line still wins over the file
+    server.SetReloadCallback([&server, &config, &path, &overrides] {
+        Core::Networking::ServerConfig reloaded;
+        if (!reloaded.Load(path, overrides)) {
+            LOG_LINE("Configuration not reloaded");
+            return;
+        }
+        for (const auto& name : reloaded.RestartNeeded(config))
+            LOG_LINE("Setting " << name << " changes only with a restart");
+        server.Configure(reloaded);
+    });
 
-int main() {
-    Core::Networking::TCPServer server(1499);
     server.Run();
-}
\ No newline at end of file
+}
@@ -0,0 +1,90 @@
+#include "Tests.h"
+
+#include <optional>
+#include <random>
+
+#include "canvas/OperationLog.h"
+#include "networking/Compression.h"
+
+using namespace Core::Canvas;
+using namespace Core::Networking;
+
+namespace {
+    // Serialized packages as they go into frames
+    std::string Serialized(const Package& package) { return Package::CompressToJSON(package).dump(); }
+
+    std::string Stroke(OperationLog& board, std::size_t points) {
+        std::vector<Point> line;
+        for (std::size_t i = 0; i < points; i++)
+            line.push_back({ 100.f + static_cast<float>(i) * 1.5f, 200.f + static_cast<float>(i % 13) });
+        return Serialized(OperationLog::Encode(board.AddLocal(std::move(line), Color{ 0.f, 1.f, 0.f, 1.f }, 2.f)).front());
+    }
+
+    // Through a frame and back, with the codec asked for or the one picked by size.
+    // 'codec' says what it was stored with.
+    bool RoundTrip(Compressor& sender, Compressor& receiver, const std::string& package, std::optional<Codec> requested, Codec& codec) {
+        std::vector<char> frame(Compressor::PackBound(package.size()));
+        const std::size_t size = requested ? sender.Pack(package, frame.data(), *requested) : sender.Pack(package, frame.data());
+        const FrameHeader header = Compressor::ParseHeader(frame.data());
+        codec = header.codec;
+
+        std::string unpacked;
+        return size == FRAME_HEADER_SIZE + header.storedSize && receiver.Unpack(header, frame.data() + FRAME_HEADER_SIZE, unpacked) && unpacked == package;
+    }
+}
+
+bool TestCodecs() {
+    bool passed = true;
+    const bool compression = !Compressor::SupportedCodecs().empty();
+
+    OperationLog board;
+    board.SetLocalID(1);
+    const std::string small = R"({"body":{"data":{}},"header":{"type":5}})";
+    const std::string stroke = Stroke(board, Settings::POINTS_PER_PACKAGE);
+    std::string snapshot;
+    while (snapshot.size() < Settings::ZSTD_MIN_SIZE)
+        snapshot += Stroke(board, Settings::POINTS_PER_PACKAGE);
+
+    std::mt19937 generator(2024);
+    std::string noise(2 * Settings::ZSTD_MIN_SIZE, '\0');
+    for (auto& c : noise)
+        c = static_cast<char>(generator());
+
+    Compressor sender, receiver;
+    sender.Negotiate({ "lz4", "zstd" });
+    receiver.Negotiate({ "lz4", "zstd" });
+
+    Codec codec{};
+    bool all = true;
+    const std::string* packages[] = { &small, &stroke, &snapshot, &noise };
+    for (const std::string* package : packages) {
+        for (Codec requested : { Codec::LZ4, Codec::Zstd })
+            all &= RoundTrip(sender, receiver, *package, requested, codec);
+    }
+    passed &= Check(all, "packages come back as they were with either codec");
+
+    all = RoundTrip(sender, receiver, stroke, Codec::LZ4, codec) && codec == (compression ? Codec::LZ4 : Codec::None);
+    all &= RoundTrip(sender, receiver, snapshot, Codec::Zstd, codec) && codec == (compression ? Codec::Zstd : Codec::None);
+    passed &= Check(all, "board packages are compressed by the codec asked for");
+
+    all = RoundTrip(sender, receiver, noise, Codec::Zstd, codec) && codec == Codec::None;
+    all &= RoundTrip(sender, receiver, small, std::nullopt, codec) && codec == Codec::None;
+    passed &= Check(all, "incompressible and small packages are stored as they are");
+
+    all = RoundTrip(sender, receiver, stroke, std::nullopt, codec) && codec == (compression ? Codec::LZ4 : Codec::None);
+    all &= RoundTrip(sender, receiver, snapshot, std::nullopt, codec) && codec == (compression ? Codec::Zstd : Codec::None);
+    passed &= Check(all, "codec is picked by the size of the package");
+
+    // A frame in a codec the connection didn't agree on, or claiming another size, doesn't unpack
+    Compressor lz4Only;
+    lz4Only.Negotiate({ "lz4" });
+    std::vector<char> frame(Compressor::PackBound(snapshot.size()));
+    sender.Pack(snapshot, frame.data(), Codec::Zstd);
+    FrameHeader header = Compressor::ParseHeader(frame.data());
+    std::string unpacked;
+    bool refused = !compression || !lz4Only.Unpack(header, frame.data() + FRAME_HEADER_SIZE, unpacked);
+    header.rawSize++;
+    refused &= !receiver.Unpack(header, frame.data() + FRAME_HEADER_SIZE, unpacked);
+    passed &= Check(refused, "frames of a codec not agreed on or of the wrong size are refused");
+    return passed;
+}
@@ -0,0 +1,142 @@
+#include "Tests.h"
+
+#include <thread>
+
+#include "networking/TCPServer.h"
+
+using namespace Core::Networking;
+
+namespace {
+    constexpr int PORT = 1596;
+    constexpr auto WAIT = std::chrono::seconds(5);
+    constexpr int SILENT_PORT = 1595; // The other node, it never answers
+    constexpr const char* NODES = "127.0.0.1:1596,127.0.0.1:1595";
+    constexpr const char* SECRET = "shared";
+    constexpr int FLOOD = 40;
+
+    Package Make(Package::Type type, const nlohmann::json& data) {
+        return Package { Package::Header{ data.dump().size(), type, -1 }, Package::Body{ data } };
+    }
+
+    // Sends the handshake of a node and waits for the answer, false if the server closed instead
+    bool Link(tcp::socket& socket, std::size_t peer, const char* secret) {
+        boost::system::error_code ec;
+        socket.connect(tcp::endpoint(ip::address_v4::loopback(), PORT), ec);
+        if (ec)
+            return false;
+
+        nlohmann::json data;
+        data["peer"] = peer;
+        data["compression"] = std::vector<std::string>{};
+        if (secret)
+            data["secret"] = secret;
+        write(socket, buffer(Frame(Make(Package::Type::Handshake, data))), ec);
+
+        std::string response;
+        read_until(socket, dynamic_buffer(response), ';', ec);
+        return !ec;
+    }
+
+    // Joins 'room' as a client that doesn't follow redirects
+    bool Join(tcp::socket& socket, const std::string& room) {
+        boost::system::error_code ec;
+        socket.connect(tcp::endpoint(ip::address_v4::loopback(), PORT), ec);
+
+        nlohmann::json data;
+        data["username"] = "test";
+        data["room"] = room;
+        if (!ec)
+            write(socket, buffer(Frame(Make(Package::Type::Handshake, data))), ec);
+        return !ec;
+    }
+
+    // Waits for the server's answer or for it to close the connection, whichever comes within 'wait'
+    enum class Reply { Answered, Closed, None };
+    Reply Await(io_context& context, tcp::socket& socket, std::chrono::milliseconds wait) {
+        Reply reply = Reply::None;
+        std::string received;
+        async_read_until(socket, dynamic_buffer(received), ';', [&](const boost::system::error_code& ec, std::size_t) {
+            reply = ec ? Reply::Closed : Reply::Answered;
+        });
+
+        context.restart();
+        context.run_for(wait);
+        if (reply != Reply::None)
+            return reply;
+
+        // Nothing came, the read is called off
+        socket.cancel();
+        context.restart();
+        context.run();
+        return Reply::None;
+    }
+
+    std::string RoomOwnedBy(std::size_t node) {
+        Federation federation;
+        federation.Configure(NODES, 0, SECRET);
+        for (int i = 0;; i++) {
+            const std::string room = "room" + std::to_string(i);
+            if (federation.Owner(room) == node)
+                return room;
+        }
+    }
+}
+
+bool TestFederationPeers() {
+    TCPServer server(PORT);
+    if (!Check(server.Federate(NODES, 0, SECRET), "federated"))
+        return false;
+    std::thread serverThread([&server] { server.Run(); });
+
+    io_context context;
+    bool passed = true;
+
+    tcp::socket anonymous(context), wrongSecret(context), self(context), stranger(context), peer(context);
+    passed &= Check(!Link(anonymous, 1, nullptr), "node without the secret is refused");
+    passed &= Check(!Link(wrongSecret, 1, "guess"), "node with a wrong secret is refused");
+    passed &= Check(!Link(self, 0, SECRET), "node claiming to be the server itself is refused");
+    passed &= Check(!Link(stranger, 7, SECRET), "node not in the list is refused");
+    passed &= Check(Link(peer, 1, SECRET), "node with the secret is linked");
+
+    if (passed) {
+        // A relayed client joining and flooding the chat in one batch
+        nlohmann::json handshake;
+        handshake["username"] = "relayed";
+        nlohmann::json frames = nlohmann::json::array();
+        frames.push_back({ 7, Package::CompressToJSON(Make(Package::Type::Handshake, handshake)) });
+        for (int i = 0; i < FLOOD; i++)
+            frames.push_back({ 7, Package::CompressToJSON(Make(Package::Type::TextMessage, { { "message", "flood" } })) });
+
+        nlohmann::json data;
+        data["frames"] = std::move(frames);
+        boost::system::error_code ec;
+        write(peer, buffer(Frame(Make(Package::Type::Relay, data))), ec);
+
+        // The handshake response comes back over the link once the batch is through
+        std::string response;
+        read_until(peer, dynamic_buffer(response), ';', ec);
+        passed &= Check(!ec, "relayed client joined");
+    }
+
+    // Linking to a node that takes the connection but never answers the handshake
+    tcp::acceptor silentNode(context, tcp::endpoint(ip::address_v4::loopback(), SILENT_PORT));
+    tcp::socket silentLink(context);
+    silentNode.async_accept(silentLink, [](const boost::system::error_code&) { });
+
+    tcp::socket relayed(context), direct(context);
+    if (passed) {
+        passed &= Check(Join(relayed, RoomOwnedBy(1)), "client of the other node's room connected");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        passed &= Check(Join(direct, RoomOwnedBy(0)) && Await(context, direct, std::chrono::milliseconds(1000)) == Reply::Answered,
+                        "other clients are served while the link is being opened");
+        passed &= Check(Await(context, relayed, std::chrono::milliseconds(Settings::RELAY_LINK_TIMEOUT_MS) + WAIT) == Reply::Closed,
+                        "client is dropped when the link can't be opened");
+    }
+
+    server.Stop();
+    serverThread.join();
+    const auto& violations = server.GetViolations();
+    passed &= Check(violations.invalid[static_cast<std::size_t>(Package::Type::Handshake)] == 4, "refused nodes counted as invalid");
+    passed &= Check(violations.dropped[static_cast<std::size_t>(Package::Type::TextMessage)] > 0, "relayed flood is limited");
+    return passed;
+}
@@ -0,0 +1,71 @@
+#include "Tests.h"
+
+#include <thread>
+#include <vector>
+
+#include "networking/LatencyHistogram.h"
+
+using namespace Core::Networking;
+
+namespace {
+    constexpr std::uint64_t FAR = 1ull << 36;
+
+    // What the lowest percentile reports for a sample, a far one keeps Max from capping it
+    std::uint64_t Reported(std::uint64_t microseconds) {
+        LatencyHistogram histogram;
+        histogram.Record(microseconds);
+        histogram.Record(FAR);
+        return histogram.Percentile(0.0);
+    }
+}
+
+bool TestLatencyHistogram() {
+    bool passed = true;
+
+    LatencyHistogram empty;
+    passed &= Check(empty.Count() == 0 && empty.Max() == 0 && empty.Mean() == 0.0 && empty.Percentile(0.5) == 0,
+                    "histogram without samples reports 0");
+
+    // Below 4 every value has a bucket of its own
+    bool exact = true;
+    for (std::uint64_t i = 0; i < 4; i++)
+        exact &= Reported(i) == i;
+    passed &= Check(exact, "values below 4 are reported exactly");
+
+    // A sample is reported as the upper end of its bucket, a quarter of its power of two wide at most,
+    // and that upper end falls into the same bucket while the value after it doesn't
+    bool bounded = true;
+    for (std::uint64_t i = 4; i < FAR / 2; i += i / 7 + 1) {
+        const std::uint64_t upper = Reported(i);
+        bounded &= upper >= i && upper - i < std::max<std::uint64_t>(1, i / 4) && Reported(upper) == upper && Reported(upper + 1) > upper;
+    }
+    passed &= Check(bounded, "samples are reported within a quarter of their power of two");
+
+    LatencyHistogram histogram;
+    for (std::uint64_t i = 1; i <= 100; i++)
+        histogram.Record(i);
+    passed &= Check(histogram.Count() == 100 && histogram.Max() == 100 && histogram.Mean() == 50.5, "count, max and mean are exact");
+
+    bool ranked = true;
+    for (double p : { 0.5, 0.9, 0.95, 0.99 }) {
+        const auto sample = static_cast<std::uint64_t>(p * 100);
+        const std::uint64_t percentile = histogram.Percentile(p);
+        ranked &= percentile >= sample && percentile <= sample + sample / 4;
+    }
+    passed &= Check(ranked && histogram.Percentile(0.0) == 1 && histogram.Percentile(1.0) == 100,
+                    "percentiles land on the bucket of their rank and never past the max");
+
+    // Recorded from several threads at once, no sample gets lost
+    LatencyHistogram shared;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&shared, t] {
+            for (std::uint64_t i = 0; i < 10000; i++)
+                shared.Record(i * (t + 1));
+        });
+    for (auto& thread : threads)
+        thread.join();
+    passed &= Check(shared.Count() == 40000 && shared.Max() == 9999 * 4 && shared.Percentile(1.0) == 9999 * 4,
+                    "samples recorded from several threads all count");
+    return passed;
+}
@@ -0,0 +1,128 @@
+#include "Tests.h"
+
+#include <thread>
+
+#include "canvas/OperationLog.h"
+#include "networking/TCPServer.h"
+
+using namespace Core::Networking;
+
+namespace {
+    constexpr int PORT = 1597;
+    constexpr auto WAIT = std::chrono::seconds(5);
+
+    bool Connect(tcp::socket& socket) {
+        boost::system::error_code ec;
+        socket.connect(tcp::endpoint(ip::address_v4::loopback(), PORT), ec);
+        if (ec)
+            return false;
+
+        nlohmann::json data;
+        data["username"] = "test";
+        data["compression"] = std::vector<std::string>{};
+        write(socket, buffer(Frame(Package { Package::Header{ data.dump().size(), Package::Type::Handshake, -1 }, Package::Body{ data } })), ec);
+        std::string response;
+        read_until(socket, dynamic_buffer(response), ';', ec);
+        return !ec;
+    }
+
+    // Reads until the server closes the connection or WAIT is up
+    bool ClosedByServer(io_context& context, tcp::socket& socket) {
+        bool closed = false;
+        std::array<char, 4096> data{};
+        std::function<void()> read = [&] {
+            socket.async_read_some(buffer(data), [&](const boost::system::error_code& ec, std::size_t) {
+                if (ec)
+                    closed = true;
+                else
+                    read();
+            });
+        };
+        read();
+
+        context.restart();
+        context.run_for(WAIT);
+        return closed;
+    }
+
+    // Pings and reads until the pong comes back or WAIT is up
+    bool Pongs(io_context& context, tcp::socket& socket) {
+        nlohmann::json data;
+        data["sent"] = MonotonicMicroseconds();
+        boost::system::error_code ec;
+        write(socket, buffer(Frame(Package { Package::Header{ data.dump().size(), Package::Type::Ping, -1 }, Package::Body{ data } })), ec);
+        if (ec)
+            return false;
+
+        bool pong = false;
+        std::string received;
+        std::function<void()> read = [&] {
+            async_read_until(socket, dynamic_buffer(received), ';', [&](const boost::system::error_code& ec, std::size_t size) {
+                if (ec)
+                    return;
+                pong = Package::Parse(received.substr(0, size - 1)).getHeader().type == Package::Type::Pong;
+                received.erase(0, size);
+                if (!pong)
+                    read();
+            });
+        };
+        read();
+
+        context.restart();
+        context.run_for(WAIT);
+        return pong;
+    }
+}
+
+bool TestMalformedPackages() {
+    TCPServer server(PORT);
+    std::thread serverThread([&server] { server.Run(); });
+
+    io_context context;
+    bool passed = true;
+
+    // Before the handshake is done as well
+    tcp::socket badHandshake(context), nameless(context);
+    boost::system::error_code ec;
+    badHandshake.connect(tcp::endpoint(ip::address_v4::loopback(), PORT), ec);
+    nameless.connect(tcp::endpoint(ip::address_v4::loopback(), PORT), ec);
+    write(badHandshake, buffer(std::string("x;")), ec);
+    write(nameless, buffer(Frame(Package { Package::Header{ 2, Package::Type::Handshake, -1 }, Package::Body{ nlohmann::json::object() } })), ec);
+    passed &= Check(ClosedByServer(context, badHandshake), "handshake that is no JSON is refused");
+    passed &= Check(ClosedByServer(context, nameless), "handshake without a username is refused");
+
+    tcp::socket garbage(context), headless(context), bystander(context);
+    passed &= Check(Connect(garbage) && Connect(headless) && Connect(bystander), "clients connected");
+
+    if (passed) {
+        write(garbage, buffer(std::string("x;")), ec);
+        write(headless, buffer(std::string(R"({"body":{"data":{}}};)")), ec);
+
+        passed &= Check(ClosedByServer(context, garbage), "client that sent no JSON is dropped");
+        passed &= Check(ClosedByServer(context, headless), "client that sent no header is dropped");
+        passed &= Check(Pongs(context, bystander), "other client is still served");
+
+        // A stroke whose point is no point, whoever decodes it must not read past it
+        const auto emptyPoint = nlohmann::json::parse(R"({"id":[1,0],"clock":1,"options":{"color":[0,0,0,1],"thickness":1},)"
+                                                      R"("points":[[]],"numberOfPoints":1,"totalPoints":1})");
+        const Package stroke { Package::Header{ emptyPoint.dump().size(), Package::Type::BoardUpdate, -1 }, Package::Body{ emptyPoint } };
+        bool thrown = false;
+        try {
+            Core::Canvas::OperationLog::Decode(stroke);
+        }
+        catch (const nlohmann::json::exception&) {
+            thrown = true;
+        }
+        passed &= Check(thrown, "stroke with an empty point doesn't decode");
+
+        write(bystander, buffer(Frame(stroke)), ec);
+        passed &= Check(Pongs(context, bystander), "stroke with an empty point is refused, its sender stays");
+    }
+
+    server.Stop();
+    serverThread.join();
+    passed &= Check(server.GetViolations().invalid[static_cast<std::size_t>(Package::Type::Handshake)] == 2, "handshakes counted as invalid");
+    passed &= Check(server.GetViolations().invalid.back() == 2, "packages counted as invalid");
+    passed &= Check(server.GetViolations().invalid[static_cast<std::size_t>(Package::Type::BoardUpdate)] == 1, "stroke counted as invalid");
+    return passed;
+}
@@ -0,0 +1,91 @@
+#include "Tests.h"
+
+#include "canvas/OperationLog.h"
+
+using namespace Core::Canvas;
+using namespace Core::Networking;
+
+namespace {
+    constexpr std::size_t POINTS = 3 * Settings::POINTS_PER_PACKAGE + 5; // Sent in four chunks
+    constexpr std::size_t ERASED = 2 * Settings::TOMBSTONE_COMPACT_THRESHOLD;
+
+    // Over the wire and back
+    std::vector<Operation> Received(const Operation& op) {
+        std::vector<Operation> ops;
+        for (const auto& package : OperationLog::Encode(op))
+            ops.push_back(OperationLog::Decode(package));
+        return ops;
+    }
+
+    // Another peer's operation that moves the clock 'ticks' ahead
+    Operation Later(const OperationLog& board, std::uint64_t ticks) {
+        return Operation{ Operation::Type::Transform, StrokeID{ 9, 0 }, board.GetClock() + ticks, 9 };
+    }
+}
+
+bool TestOperationLog() {
+    bool passed = true;
+
+    OperationLog author, peer;
+    author.SetLocalID(1);
+    std::vector<Point> points;
+    for (std::size_t i = 0; i < POINTS; i++)
+        points.push_back({ static_cast<float>(i), 0.f });
+    const Operation add = author.AddLocal(std::vector<Point>(points), Color{ 0.f, 0.f, 0.f, 1.f }, 2.f);
+
+    const auto chunks = Received(add);
+    for (const auto& chunk : chunks)
+        peer.Apply(chunk);
+    bool changed = false;
+    for (const auto& chunk : chunks)
+        changed |= peer.Apply(chunk);
+    changed |= peer.Apply(chunks[1]);
+
+    OperationLog late;
+    passed &= Check(!late.Apply(chunks[1]) && !late.Find(add.stroke), "chunk without the start of its stroke doesn't start it");
+
+    const Line* line = peer.Find(add.stroke);
+    passed &= Check(chunks.size() == 4 && line && line->points.size() == POINTS, "stroke sent in chunks arrives whole");
+    passed &= Check(!changed && line && std::equal(points.begin(), points.end(), line->points.begin(),
+                    [](Point a, Point b) { return a.x == b.x && a.y == b.y; }), "chunks that arrive again add no points");
+
+    // Bounds of a smooth stroke grow chunk by chunk to what the whole stroke has
+    std::vector<Point> curve;
+    for (std::size_t i = 0; i < POINTS; i++)
+        curve.push_back({ static_cast<float>(i), static_cast<float>((i * i) % 7) * 4.f });
+    const Operation smooth = author.AddLocal(std::vector<Point>(curve), Color{ 0.f, 0.f, 0.f, 1.f }, 2.f, true);
+    for (const auto& chunk : Received(smooth))
+        peer.Apply(chunk);
+    const Line* whole = author.Find(smooth.stroke);
+    const Line* chunked = peer.Find(smooth.stroke);
+    passed &= Check(whole && chunked && whole->min.x == chunked->min.x && whole->min.y == chunked->min.y &&
+                    whole->max.x == chunked->max.x && whole->max.y == chunked->max.y, "smooth stroke sent in chunks has the bounds of the whole");
+
+    // Strokes of another peer, so they're not in our undo history
+    OperationLog board;
+    board.SetLocalID(2);
+    std::vector<StrokeID> erased;
+    for (std::uint32_t i = 0; i < ERASED; i++) {
+        Operation stroke{ Operation::Type::Add, StrokeID{ 3, i }, board.GetClock() + 1, 3 };
+        stroke.points = { { 0.f, 0.f }, { 1.f, 1.f } };
+        board.Apply(stroke);
+        board.Apply(Operation{ Operation::Type::Remove, stroke.stroke, board.GetClock() + 1, 3 });
+        erased.push_back(stroke.stroke);
+    }
+    board.CompactTombstones();
+    passed &= Check(board.GetTombstoneCount() == ERASED, "young tombstones are kept");
+
+    board.Apply(Later(board, Settings::TOMBSTONE_MIN_AGE));
+    board.CompactTombstones();
+    passed &= Check(board.GetTombstoneCount() == 0 && board.GetCompactedCount() == ERASED, "old tombstones are compacted");
+    passed &= Check(!board.Apply(Operation{ Operation::Type::Restore, erased.front(), board.GetClock() + 1, 3 }) && !board.Find(erased.front()),
+                    "late operations on compacted strokes are ignored");
+
+    // Later keeps writing its stroke, that one stays
+    board.Apply(Operation{ Operation::Type::Remove, StrokeID{ 4, 0 }, board.GetClock() + 1, 4 });
+    board.Apply(Later(board, Settings::TOMBSTONE_MIN_AGE));
+    board.CompactTombstones();
+    passed &= Check(board.GetCompactedCount() == 0, "compacted strokes are forgotten a horizon later");
+    passed &= Check(board.GetPendingCount() == 1, "operations on strokes that never arrived are dropped a horizon later");
+    return passed;
+}
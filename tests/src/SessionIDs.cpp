@@ -0,0 +1,32 @@
+#include "Tests.h"
+
+#include <unordered_set>
+
+#include "networking/SessionRegistry.h"
+
+using namespace Core::Networking;
+
+namespace {
+    constexpr std::size_t SLOTS = (1 << Settings::SESSION_SLOT_BITS) - 1; // Slot 0 is the server's
+}
+
+bool TestSessionIDs() {
+    SessionRegistry sessions;
+    bool passed = true;
+
+    std::unordered_set<IDType> ids;
+    bool allocated = true;
+    for (std::size_t i = 0; i < SLOTS; i++) {
+        const auto id = sessions.Allocate();
+        allocated &= id && ids.insert(*id).second;
+    }
+    passed &= Check(allocated, "every slot gets a distinct ID");
+    passed &= Check(!sessions.Allocate() && !sessions.Allocate(), "no ID once the slots run out");
+
+    const IDType released = *ids.begin();
+    sessions.Release(released);
+    const auto reused = sessions.Allocate();
+    passed &= Check(reused && *reused != released && !ids.contains(*reused), "a released slot is reused under a new ID");
+    passed &= Check(!sessions.Allocate(), "no ID once it's taken again");
+    return passed;
+}
@@ -0,0 +1,153 @@
+#include "Tests.h"
+
+#include <algorithm>
+#include <optional>
+#include <thread>
+
+#include "networking/ReplayBuffer.h"
+#include "networking/TCPServer.h"
+
+using namespace Core::Networking;
+
+namespace {
+    constexpr int PORT = 1598;
+    constexpr std::size_t CAPACITY = 4;
+
+    Package Make(Package::Type type, const nlohmann::json& data, IDType sender = -1) {
+        return Package { Package::Header{ data.dump().size(), type, sender }, Package::Body{ data } };
+    }
+
+    Package Operation(IDType author, std::uint32_t sequence) {
+        nlohmann::json data;
+        data["id"] = { author, sequence };
+        data["clock"] = sequence + 1;
+        data["op"] = 1;
+        return Make(Package::Type::BoardOperation, data, author);
+    }
+
+    // Next package the server sent, 'pending' keeps whatever came after it
+    std::optional<Package> Next(tcp::socket& socket, std::string& pending) {
+        boost::system::error_code ec;
+        const std::size_t size = read_until(socket, dynamic_buffer(pending), ';', ec);
+        if (ec)
+            return std::nullopt;
+
+        Package package = Package::Parse(pending.substr(0, size - 1));
+        pending.erase(0, size);
+        return package;
+    }
+
+    // Connects and returns the server's handshake response, null if there was none
+    nlohmann::json Handshake(tcp::socket& socket, std::string& pending, nlohmann::json data) {
+        boost::system::error_code ec;
+        socket.connect(tcp::endpoint(ip::address_v4::loopback(), PORT), ec);
+        data["username"] = "test";
+        data["compression"] = std::vector<std::string>{};
+        if (!ec)
+            write(socket, buffer(Frame(Make(Package::Type::Handshake, data))), ec);
+
+        auto response = ec ? std::nullopt : Next(socket, pending);
+        return response ? response->getBody().data : nlohmann::json();
+    }
+
+    // Board packages that came before the answer to a ping, the server handled everything sent before it
+    std::vector<Package> BoardUntilPong(tcp::socket& socket, std::string& pending) {
+        nlohmann::json data;
+        data["sent"] = MonotonicMicroseconds();
+        boost::system::error_code ec;
+        write(socket, buffer(Frame(Make(Package::Type::Ping, data))), ec);
+
+        std::vector<Package> board;
+        while (auto package = Next(socket, pending)) {
+            if (package->getHeader().type == Package::Type::Pong)
+                break;
+            if (package->getHeader().type == Package::Type::BoardOperation)
+                board.push_back(*package);
+        }
+        return board;
+    }
+
+    // Reset instead of closed, as if the network went away: the server keeps the session
+    void Lose(tcp::socket& socket) {
+        boost::system::error_code ec;
+        socket.set_option(socket_base::linger(true, 0), ec);
+        socket.close(ec);
+    }
+}
+
+bool TestSessionResume() {
+    bool passed = true;
+
+    // Sequence numbers count on past what the buffer holds
+    ReplayBuffer replay(CAPACITY);
+    for (std::uint32_t i = 0; i < CAPACITY + 2; i++)
+        replay.Push(Operation(i % 2 ? 2 : 1, i));
+
+    std::vector<Package> missed;
+    passed &= Check(replay.Last() == CAPACITY + 2 && replay.Since(replay.Last(), 1, missed) && missed.empty(),
+                    "nothing is missed after the last package");
+    missed.clear();
+    passed &= Check(replay.Since(2, 0, missed) && missed.size() == CAPACITY && missed.front().getBody().data.at("seq") == 3,
+                    "packages after a sequence number come in order");
+    missed.clear();
+    passed &= Check(replay.Since(2, 1, missed) && missed.size() == CAPACITY / 2 &&
+                    std::all_of(missed.begin(), missed.end(), [](const Package& p) { return p.getHeader().senderID == 2; }),
+                    "packages of the one catching up are left out");
+    missed.clear();
+    passed &= Check(!replay.Since(1, 0, missed) && !replay.Since(replay.Last() + 1, 0, missed), "sequence numbers gone or not there yet are refused");
+
+    ReplayBuffer imported(CAPACITY);
+    imported.Import(replay.Export());
+    missed.clear();
+    passed &= Check(imported.Last() == replay.Last() && imported.Since(2, 0, missed) && missed.size() == CAPACITY,
+                    "exported buffer goes on where it was");
+
+    TCPServer server(PORT);
+    std::thread serverThread([&server] { server.Run(); });
+    {
+        io_context context;
+        tcp::socket lost(context), drawing(context), stranger(context), back(context), leaving(context), late(context);
+        std::string lostPending, drawingPending, strangerPending, backPending, leavingPending, latePending;
+
+        const nlohmann::json session = Handshake(lost, lostPending, {});
+        const nlohmann::json other = Handshake(drawing, drawingPending, {});
+        passed &= Check(session.contains("id") && session.contains("session") && other.contains("id"), "clients connected");
+        if (session.contains("id") && session.contains("session") && other.contains("id")) {
+            Lose(lost);
+
+            const IDType author = other.at("id");
+            boost::system::error_code ec;
+            write(drawing, buffer(Frame(Operation(author, 0)) + Frame(Operation(author, 1))), ec);
+            BoardUntilPong(drawing, drawingPending);
+
+            nlohmann::json resume;
+            resume["id"] = session.at("id");
+            resume["session"] = session.at("session").get<std::uint64_t>() + 1;
+            resume["lastSequence"] = session.at("roomSequence");
+            const nlohmann::json guessed = Handshake(stranger, strangerPending, resume);
+            passed &= Check(guessed.contains("id") && !guessed.contains("resumed") && guessed.at("id") != session.at("id"),
+                            "client without the session's secret gets a session of its own");
+
+            resume["session"] = session.at("session");
+            const nlohmann::json resumed = Handshake(back, backPending, resume);
+            passed &= Check(resumed.value("resumed", false) && resumed.at("id") == session.at("id"), "client that knows the secret keeps its ID");
+
+            missed = BoardUntilPong(back, backPending);
+            passed &= Check(missed.size() == 2 && missed[0].getBody().data.at("seq") == 1 && missed[1].getBody().data.at("seq") == 2,
+                            "board packages missed meanwhile follow the response");
+
+            // Closed by the client itself, the session is over
+            const nlohmann::json left = Handshake(leaving, leavingPending, {});
+            leaving.shutdown(tcp::socket::shutdown_both, ec);
+            leaving.close(ec);
+            BoardUntilPong(drawing, drawingPending);
+            resume["id"] = left.at("id");
+            resume["session"] = left.at("session");
+            const nlohmann::json ended = Handshake(late, latePending, resume);
+            passed &= Check(!ended.value("resumed", false), "session closed by its client can't be resumed");
+        }
+    }
+    server.Stop();
+    serverThread.join();
+    return passed;
+}
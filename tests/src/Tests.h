@@ -0,0 +1,56 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <iostream>
+#include <string>
+
+#include "networking/TCPPackage.h"
+
+// Prints one line of a test's outcome, passes 'passed' on
+inline bool Check(bool passed, const char* what) {
+    std::cout << (passed ? "  ok: " : "  FAILED: ") << what << std::endl;
+    return passed;
+}
+
+// Uncompressed and ';' terminated, as a client sends it before compression is agreed on
+inline std::string Frame(const Core::Networking::Package& package) {
+    return Core::Networking::Package::CompressToJSON(package).dump() + ";";
+}
+
+// A client that sends what isn't a package, or a package without its header, loses its
+// connection and its session, as does one whose handshake is either. The server goes on
+// and the other clients don't notice. A stroke with broken points is refused.
+bool TestMalformedPackages();
+
+// Only nodes of the federation that know its secret get a relay link. What they relay
+// is limited per client, as if the clients were connected to this server themselves.
+bool TestFederationPeers();
+
+// Connection IDs run out once every slot is taken, the server refuses connections instead
+// of throwing. A slot given back is taken again under its next generation.
+bool TestSessionIDs();
+
+// Chunks of a stroke that arrive twice don't add their points twice, one that arrives without
+// the first doesn't start the stroke, a smooth stroke ends up with the bounds of the whole.
+// Erased strokes are compacted once old enough and forgotten altogether a while after that,
+// as are operations on strokes that never arrived.
+bool TestOperationLog();
+
+// Packages framed with LZ4 or zstd unpack to what they were, board packages get smaller
+// and the rest is stored as is. Frames of a codec not agreed on don't unpack.
+bool TestCodecs();
+
+// Board packages a client missed while its connection was lost come from the room's replay
+// buffer, unless they are gone from it. The client keeps its ID if it knows the session's
+// secret and the session wasn't ended.
+bool TestSessionResume();
+
+// Latency percentiles come out at most a quarter of a power of two above the sample of their
+// rank and never above the largest one. Samples recorded from several threads all count.
+bool TestLatencyHistogram();
+
+// Changes to a stroke go live to members that look where it is and have it. Those that hold
+// its tiles without looking there hear the tiles went out of date, the rest page it in.
+bool TestViewportRouting();
+
+#endif //TESTS_H
@@ -0,0 +1,98 @@
+#include "Tests.h"
+
+#include <algorithm>
+
+#include "BoardStore.h"
+#include "canvas/OperationLog.h"
+
+using namespace Core::Canvas;
+using namespace Core::Networking;
+
+namespace {
+    const std::string ROOM = "routing";
+    constexpr float FAR = 100 * Settings::TILE_SIZE; // Tiles away from the origin, out of every view there
+
+    enum Member : IDType { AUTHOR = 1, NEAR = 2, ELSEWHERE = 3, EVERYWHERE = 4 };
+
+    nlohmann::json View(float x, float y, float size) {
+        nlohmann::json view;
+        view["view"] = { x, y, x + size, y + size };
+        return view;
+    }
+
+    void Hold(Server::BoardStore& store, IDType member, std::vector<Tile> tiles) {
+        nlohmann::json request;
+        request["tiles"] = nlohmann::json::array();
+        for (Tile tile : tiles)
+            request["tiles"].push_back(ToJSON(tile));
+        request["resident"] = nlohmann::json::array();
+        store.Page(ROOM, member, request);
+    }
+
+    // Members that get the operation live, all of its chunks must go to the same ones
+    std::vector<IDType> Audience(Server::BoardStore& store, const Operation& op) {
+        std::vector<IDType> audience, chunk;
+        bool same = true, first = true;
+        for (const auto& package : OperationLog::Encode(op)) {
+            chunk.clear();
+            same &= store.Apply(ROOM, package, chunk);
+            std::sort(chunk.begin(), chunk.end());
+            same &= first || chunk == audience;
+            audience = chunk;
+            first = false;
+        }
+        return same ? audience : std::vector<IDType>{ -1 };
+    }
+
+    // Tiles members heard went out of date
+    std::vector<std::pair<IDType, std::vector<Tile>>> Dirty(Server::BoardStore& store) {
+        std::vector<std::pair<IDType, Package>> notices;
+        store.Notices(notices);
+
+        std::vector<std::pair<IDType, std::vector<Tile>>> dirty;
+        for (const auto& [member, package] : notices) {
+            std::vector<Tile> tiles;
+            for (const auto& tile : package.getBody().data.at("tiles"))
+                tiles.push_back(TileFromJSON(tile));
+            dirty.emplace_back(member, std::move(tiles));
+        }
+        return dirty;
+    }
+}
+
+bool TestViewportRouting() {
+    bool passed = true;
+
+    Server::BoardStore store;
+    store.View(ROOM, NEAR, View(0.f, 0.f, 100.f));
+    store.View(ROOM, ELSEWHERE, View(FAR, FAR, 100.f));
+    store.View(ROOM, EVERYWHERE, View(-FAR, -FAR, 2 * FAR));
+    Hold(store, NEAR, { Tile{ 0, 0 } });
+    Hold(store, ELSEWHERE, { Tile{ 0, 0 } });
+    Hold(store, EVERYWHERE, { Tile{ 0, 0 } });
+
+    OperationLog author;
+    author.SetLocalID(AUTHOR);
+    const Operation add = author.AddLocal({ { 10.f, 10.f }, { 20.f, 20.f } }, Color{ 0.f, 0.f, 0.f, 1.f }, 2.f);
+    passed &= Check(Audience(store, add) == std::vector<IDType>{ NEAR, EVERYWHERE }, "new stroke goes to those looking where it is");
+    passed &= Check(Dirty(store) == std::vector<std::pair<IDType, std::vector<Tile>>>{ { ELSEWHERE, { Tile{ 0, 0 } } } },
+                    "those that hold its tile without looking there hear it went out of date");
+
+    // Moved into the view of one that doesn't have the stroke, it has to page it in instead
+    const auto moved = author.TransformLocal(add.stroke, { FAR, FAR });
+    passed &= Check(moved && Audience(store, *moved) == std::vector<IDType>{ NEAR, EVERYWHERE },
+                    "moved stroke goes to those that had it, not to those it moved in front of");
+    nlohmann::json request;
+    request["tiles"] = { ToJSON(TileOf({ FAR + 10.f, FAR + 10.f })) };
+    request["resident"] = nlohmann::json::array();
+    const auto paged = store.Page(ROOM, ELSEWHERE, request);
+    passed &= Check(paged.size() == 2 && std::all_of(paged.begin(), paged.end(), [](const Package& p) { return p.getBody().data.value("paged", false); }),
+                    "the stroke and its move are paged in where it moved to");
+
+    // One that looks elsewhere now doesn't get it anymore, one that left never does
+    store.View(ROOM, NEAR, View(-FAR, FAR, 100.f));
+    store.Leave(ROOM, EVERYWHERE);
+    const auto erased = author.EraseLocal(add.stroke);
+    passed &= Check(erased && Audience(store, *erased) == std::vector<IDType>{ ELSEWHERE }, "views are followed as they change");
+    return passed;
+}
@@ -0,0 +1,28 @@
+#include <cstring>
+#include <iostream>
+
+#include "Tests.h"
+
+// Runs the test named on the command line, see CMakeLists.txt:
+//   DrawingRoomTests <test>
+int main(int argc, char** argv) {
+    if (argc == 2 && std::strcmp(argv[1], "malformed-packages") == 0)
+        return TestMalformedPackages() ? 0 : 1;
+    if (argc == 2 && std::strcmp(argv[1], "federation-peers") == 0)
+        return TestFederationPeers() ? 0 : 1;
+    if (argc == 2 && std::strcmp(argv[1], "session-ids") == 0)
+        return TestSessionIDs() ? 0 : 1;
+    if (argc == 2 && std::strcmp(argv[1], "operation-log") == 0)
+        return TestOperationLog() ? 0 : 1;
+    if (argc == 2 && std::strcmp(argv[1], "codecs") == 0)
+        return TestCodecs() ? 0 : 1;
+    if (argc == 2 && std::strcmp(argv[1], "session-resume") == 0)
+        return TestSessionResume() ? 0 : 1;
+    if (argc == 2 && std::strcmp(argv[1], "latency-histogram") == 0)
+        return TestLatencyHistogram() ? 0 : 1;
+    if (argc == 2 && std::strcmp(argv[1], "viewport-routing") == 0)
+        return TestViewportRouting() ? 0 : 1;
+
+    std::cerr << "Usage: DrawingRoomTests malformed-packages|federation-peers|session-ids|operation-log|codecs|session-resume|latency-histogram|viewport-routing" << std::endl;
+    return 2;
+}